@@ -0,0 +1,15 @@
+# Find the LZ4 compression library
+#
+# Once done this will define
+#
+#  LZ4_FOUND - system has liblz4 including the frame API
+#  LZ4_INCLUDE_DIRS - the lz4 include directory
+#  LZ4_LIBRARIES - the libraries needed to use lz4
+
+find_path(LZ4_INCLUDE_DIRS lz4frame.h)
+find_library(LZ4_LIBRARIES NAMES lz4 liblz4)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LZ4 DEFAULT_MSG LZ4_LIBRARIES LZ4_INCLUDE_DIRS)
+
+mark_as_advanced(LZ4_INCLUDE_DIRS LZ4_LIBRARIES)
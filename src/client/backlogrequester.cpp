@@ -58,6 +58,16 @@ bool BacklogRequester::buffer(BufferId bufferId, const MessageList &messages)
 }
 
 
+bool BacklogRequester::buffer(const BufferIdList &bufferIds, const MessageList &messages)
+{
+    _bufferedMessages << messages;
+    foreach(BufferId bufferId, bufferIds) {
+        _buffersWaiting.remove(bufferId);
+    }
+    return !_buffersWaiting.isEmpty();
+}
+
+
 BufferIdList BacklogRequester::allBufferIds() const
 {
     QSet<BufferId> bufferIds = Client::bufferViewOverlay()->bufferIds();
@@ -93,6 +103,15 @@ void FixedBacklogRequester::requestBacklog(const BufferIdList &bufferIds)
 {
     setWaitingBuffers(bufferIds);
     backlogManager->emitMessagesRequested(QObject::tr("Requesting a total of up to %1 backlog messages for %2 buffers").arg(_backlogCount * bufferIds.count()).arg(bufferIds.count()));
+    // the core only answers multi-buffer requests with a limit, "unlimited" is requested per buffer
+    if (_backlogCount > 0 && Client::isCoreFeatureEnabled(Quassel::Feature::BacklogMulti)) {
+        QVariantList buffers;
+        foreach(BufferId bufferId, bufferIds) {
+            buffers << qVariantFromValue(bufferId);
+        }
+        backlogManager->requestBacklogMulti(buffers, QVariantList(), _backlogCount);
+        return;
+    }
     foreach(BufferId bufferId, bufferIds) {
         backlogManager->requestBacklog(bufferId, -1, -1, _backlogCount);
     }
@@ -140,6 +159,17 @@ void PerBufferUnreadBacklogRequester::requestBacklog(const BufferIdList &bufferI
 {
     setWaitingBuffers(bufferIds);
     backlogManager->emitMessagesRequested(QObject::tr("Requesting a total of up to %1 unread backlog messages for %2 buffers").arg((_limit + _additional) * bufferIds.count()).arg(bufferIds.count()));
+    // the core only answers multi-buffer requests with a limit, "unlimited" is requested per buffer
+    if (_limit > 0 && Client::isCoreFeatureEnabled(Quassel::Feature::BacklogMulti)) {
+        QVariantList buffers;
+        QVariantList first;
+        foreach(BufferId bufferId, bufferIds) {
+            buffers << qVariantFromValue(bufferId);
+            first << qVariantFromValue(Client::networkModel()->lastSeenMsgId(bufferId));
+        }
+        backlogManager->requestBacklogMulti(buffers, first, _limit, _additional);
+        return;
+    }
     foreach(BufferId bufferId, bufferIds) {
         backlogManager->requestBacklog(bufferId, Client::networkModel()->lastSeenMsgId(bufferId), -1, _limit, _additional);
     }
@@ -51,6 +51,8 @@ public:
     inline int totalBuffers() const { return _totalBuffers; }
 
     bool buffer(BufferId bufferId, const MessageList &messages); //! returns false if it was the last missing backlogpart
+    bool buffer(const BufferIdList &bufferIds, const MessageList &messages); //! same for a reply covering several buffers
+    inline void bufferPart(const MessageList &messages) { _bufferedMessages << messages; } //! buffers a part of a streamed reply
 
     virtual void requestBacklog(const BufferIdList &bufferIds) = 0;
     virtual inline void requestInitialBacklog() { requestBacklog(allBufferIds()); }
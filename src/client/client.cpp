@@ -141,6 +141,7 @@ void Client::init()
     SignalProxy *p = signalProxy();
 
     p->attachSlot(SIGNAL(displayMsg(const Message &)), this, SLOT(recvMessage(const Message &)));
+    p->attachSlot(SIGNAL(displayMsgs(QVariantList)), this, SLOT(recvMessages(QVariantList)));
     p->attachSlot(SIGNAL(displayStatusMsg(QString, QString)), this, SLOT(recvStatusMsg(QString, QString)));
 
     p->attachSlot(SIGNAL(bufferInfoUpdated(BufferInfo)), _networkModel, SLOT(bufferUpdated(BufferInfo)));
@@ -594,6 +595,13 @@ void Client::recvMessage(const Message &msg)
 }
 
 
+void Client::recvMessages(const QVariantList &messages)
+{
+    MessageList msgs = messagesFromVariantList(messages);
+    messageProcessor()->process(msgs);
+}
+
+
 void Client::setBufferLastSeenMsg(BufferId id, const MsgId &msgId)
 {
     if (bufferSyncer())
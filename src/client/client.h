@@ -230,6 +230,7 @@ private slots:
     void connectionStateChanged(CoreConnection::ConnectionState);
 
     void recvMessage(const Message &message);
+    void recvMessages(const QVariantList &messages);
     void recvStatusMsg(QString network, QString message);
 
     void networkDestroyed();
@@ -199,6 +199,12 @@ void ClientAuthHandler::onSocketConnected()
             magic |= Protocol::Encryption;
 #endif
         magic |= Protocol::Compression;
+        if (Compressor::isMethodSupported(Compressor::Lz4))
+            magic |= Protocol::Lz4Compression;
+        if (Compressor::isMethodSupported(Compressor::Zstd)) {
+            magic |= Protocol::ZstdCompression;
+            magic |= (Compressor::zstdDictionaryId() << Protocol::ZstdDictionaryShift) & Protocol::ZstdDictionaryMask;
+        }
 
         stream << magic;
 
@@ -220,7 +226,7 @@ void ClientAuthHandler::onSocketConnected()
 
     qDebug() << "Legacy core detected, switching to compatibility mode";
 
-    RemotePeer *peer = PeerFactory::createPeer(PeerFactory::ProtoDescriptor(Protocol::LegacyProtocol, 0), this, socket(), Compressor::NoCompression, this);
+    RemotePeer *peer = PeerFactory::createPeer(PeerFactory::ProtoDescriptor(Protocol::LegacyProtocol, 0), this, socket(), Compressor::NoCompression, Compressor::Deflate, this);
     // Only needed for the legacy peer, as all others check the protocol version before instantiation
     connect(peer, SIGNAL(protocolVersionMismatch(int,int)), SLOT(onProtocolVersionMismatch(int,int)));
 
@@ -253,7 +259,14 @@ void ClientAuthHandler::onReadyRead()
     else
         level = Compressor::NoCompression;
 
-    RemotePeer *peer = PeerFactory::createPeer(PeerFactory::ProtoDescriptor(type, protoFeatures), this, socket(), level, this);
+    // the core tells us which of the methods we offered it has picked
+    Compressor::CompressionMethod method = Compressor::Deflate;
+    if (_connectionFeatures & Protocol::ZstdCompression)
+        method = Compressor::Zstd;
+    else if (_connectionFeatures & Protocol::Lz4Compression)
+        method = Compressor::Lz4;
+
+    RemotePeer *peer = PeerFactory::createPeer(PeerFactory::ProtoDescriptor(type, protoFeatures), this, socket(), level, method, this);
     if (!peer) {
         qWarning() << "No valid protocol supported for this core!";
         emit errorPopup(tr("<b>Incompatible Quassel Core!</b><br>"
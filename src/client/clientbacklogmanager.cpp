@@ -49,14 +49,9 @@ void ClientBacklogManager::receiveBacklog(BufferId bufferId, MsgId first, MsgId
 {
     Q_UNUSED(first) Q_UNUSED(last) Q_UNUSED(limit) Q_UNUSED(additional)
 
-    emit messagesReceived(bufferId, msgs.count());
+    MessageList msglist = backlogMessages(msgs);
 
-    MessageList msglist;
-    foreach(QVariant v, msgs) {
-        Message msg = v.value<Message>();
-        msg.setFlags(msg.flags() | Message::Backlog);
-        msglist << msg;
-    }
+    emit messagesReceived(bufferId, msglist.count());
 
     if (isBuffering()) {
         bool lastPart = !_requester->buffer(bufferId, msglist);
@@ -72,18 +67,104 @@ void ClientBacklogManager::receiveBacklog(BufferId bufferId, MsgId first, MsgId
 }
 
 
+void ClientBacklogManager::receiveBacklogPart(BufferId bufferId, MsgId first, MsgId last, int limit, int additional, QVariantList msgs)
+{
+    Q_UNUSED(first) Q_UNUSED(last) Q_UNUSED(limit) Q_UNUSED(additional)
+
+    MessageList msglist = backlogMessages(msgs);
+
+    emit messagesReceived(bufferId, msglist.count());
+
+    // more parts are to come, so the buffer isn't complete yet
+    if (isBuffering())
+        _requester->bufferPart(msglist);
+    else
+        dispatchMessages(msglist);
+}
+
+
 void ClientBacklogManager::receiveBacklogAll(MsgId first, MsgId last, int limit, int additional, QVariantList msgs)
 {
     Q_UNUSED(first) Q_UNUSED(last) Q_UNUSED(limit) Q_UNUSED(additional)
 
-    MessageList msglist;
-    foreach(QVariant v, msgs) {
-        Message msg = v.value<Message>();
-        msg.setFlags(msg.flags() | Message::Backlog);
-        msglist << msg;
+    dispatchMessages(backlogMessages(msgs));
+}
+
+
+void ClientBacklogManager::receiveBacklogAllPart(MsgId first, MsgId last, int limit, int additional, QVariantList msgs)
+{
+    Q_UNUSED(first) Q_UNUSED(last) Q_UNUSED(limit) Q_UNUSED(additional)
+
+    dispatchMessages(backlogMessages(msgs));
+}
+
+
+QVariantList ClientBacklogManager::requestBacklogMulti(QVariantList bufferIds, QVariantList first, int limit, int additional)
+{
+    foreach(const QVariant &bufferId, bufferIds) {
+        _buffersRequested << bufferId.value<BufferId>();
+    }
+    return BacklogManager::requestBacklogMulti(bufferIds, first, limit, additional);
+}
+
+
+void ClientBacklogManager::receiveBacklogMulti(QVariantList bufferIds, QVariantList first, int limit, int additional, QVariantList msgs)
+{
+    Q_UNUSED(first) Q_UNUSED(limit) Q_UNUSED(additional)
+
+    MessageList msglist = backlogMessages(msgs);
+
+    emitMessagesReceived(msglist);
+
+    if (isBuffering()) {
+        BufferIdList buffers;
+        foreach(const QVariant &bufferId, bufferIds) {
+            buffers << bufferId.value<BufferId>();
+        }
+        bool lastPart = !_requester->buffer(buffers, msglist);
+        updateProgress(_requester->totalBuffers() - _requester->buffersWaiting(), _requester->totalBuffers());
+        if (lastPart) {
+            dispatchMessages(_requester->bufferedMessages(), true);
+            _requester->flushBuffer();
+        }
+    }
+    else {
+        dispatchMessages(msglist);
     }
+}
+
+
+void ClientBacklogManager::receiveBacklogMultiPart(QVariantList bufferIds, QVariantList first, int limit, int additional, QVariantList msgs)
+{
+    Q_UNUSED(bufferIds) Q_UNUSED(first) Q_UNUSED(limit) Q_UNUSED(additional)
+
+    MessageList msglist = backlogMessages(msgs);
+
+    emitMessagesReceived(msglist);
+
+    // more parts are to come, so the buffers aren't complete yet
+    if (isBuffering())
+        _requester->bufferPart(msglist);
+    else
+        dispatchMessages(msglist);
+}
+
+
+void ClientBacklogManager::receiveBacklogByTime(BufferId bufferId, QDateTime start, QDateTime end, int types, int limit, QVariantList msgs)
+{
+    Q_UNUSED(limit)
 
-    dispatchMessages(msglist);
+    // like search results, these are handed to whoever asked for them and don't go into the chat views
+    emit backlogByTimeReceived(bufferId, start, end, types, messagesFromVariantList(msgs));
+}
+
+
+void ClientBacklogManager::receiveSearch(QString text, QVariantMap filter, MsgId last, int limit, QVariantList msgs)
+{
+    Q_UNUSED(limit)
+
+    // search results are handed to whoever asked for them, they don't go into the chat views
+    emit searchResultsReceived(text, filter, last, messagesFromVariantList(msgs));
 }
 
 
@@ -162,6 +243,29 @@ bool ClientBacklogManager::isBuffering()
 }
 
 
+MessageList ClientBacklogManager::backlogMessages(const QVariantList &msgs) const
+{
+    MessageList msglist = messagesFromVariantList(msgs);
+    for (int i = 0; i < msglist.count(); i++) {
+        msglist[i].setFlags(msglist.at(i).flags() | Message::Backlog);
+    }
+    return msglist;
+}
+
+
+void ClientBacklogManager::emitMessagesReceived(const MessageList &messages) const
+{
+    QHash<BufferId, int> counts;
+    foreach(const Message &msg, messages) {
+        counts[msg.bufferId()]++;
+    }
+    QHash<BufferId, int>::const_iterator iter;
+    for (iter = counts.constBegin(); iter != counts.constEnd(); ++iter) {
+        emit messagesReceived(iter.key(), iter.value());
+    }
+}
+
+
 void ClientBacklogManager::dispatchMessages(const MessageList &messages, bool sort)
 {
     if (messages.isEmpty())
@@ -42,7 +42,14 @@ public:
 public slots:
     virtual QVariantList requestBacklog(BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
     virtual void receiveBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional, QVariantList msgs);
+    virtual void receiveBacklogPart(BufferId bufferId, MsgId first, MsgId last, int limit, int additional, QVariantList msgs);
     virtual void receiveBacklogAll(MsgId first, MsgId last, int limit, int additional, QVariantList msgs);
+    virtual void receiveBacklogAllPart(MsgId first, MsgId last, int limit, int additional, QVariantList msgs);
+    virtual QVariantList requestBacklogMulti(QVariantList bufferIds, QVariantList first, int limit = -1, int additional = 0);
+    virtual void receiveBacklogMulti(QVariantList bufferIds, QVariantList first, int limit, int additional, QVariantList msgs);
+    virtual void receiveBacklogMultiPart(QVariantList bufferIds, QVariantList first, int limit, int additional, QVariantList msgs);
+    virtual void receiveBacklogByTime(BufferId bufferId, QDateTime start, QDateTime end, int types, int limit, QVariantList msgs);
+    virtual void receiveSearch(QString text, QVariantMap filter, MsgId last, int limit, QVariantList msgs);
 
     void requestInitialBacklog();
 
@@ -54,12 +61,19 @@ signals:
     void messagesRequested(const QString &) const;
     void messagesProcessed(const QString &) const;
 
+    //! Results of a requestSearch() call, newest first
+    void searchResultsReceived(const QString &text, const QVariantMap &filter, MsgId last, const MessageList &messages);
+    //! Results of a requestBacklogByTime() call, oldest first
+    void backlogByTimeReceived(BufferId bufferId, const QDateTime &start, const QDateTime &end, int types, const MessageList &messages);
+
     void updateProgress(int, int);
 
 private:
     bool isBuffering();
     BufferIdList filterNewBufferIds(const BufferIdList &bufferIds);
 
+    MessageList backlogMessages(const QVariantList &msgs) const;
+    void emitMessagesReceived(const MessageList &messages) const;
     void dispatchMessages(const MessageList &messages, bool sort = false);
 
     BacklogRequester *_requester;
@@ -33,3 +33,24 @@ QVariantList BacklogManager::requestBacklogAll(MsgId first, MsgId last, int limi
     REQUEST(ARG(first), ARG(last), ARG(limit), ARG(additional))
     return QVariantList();
 }
+
+
+QVariantList BacklogManager::requestBacklogMulti(QVariantList bufferIds, QVariantList first, int limit, int additional)
+{
+    REQUEST(ARG(bufferIds), ARG(first), ARG(limit), ARG(additional))
+    return QVariantList();
+}
+
+
+QVariantList BacklogManager::requestBacklogByTime(BufferId bufferId, QDateTime start, QDateTime end, int types, int limit)
+{
+    REQUEST(ARG(bufferId), ARG(start), ARG(end), ARG(types), ARG(limit))
+    return QVariantList();
+}
+
+
+QVariantList BacklogManager::requestSearch(QString text, QVariantMap filter, MsgId last, int limit)
+{
+    REQUEST(ARG(text), ARG(filter), ARG(last), ARG(limit))
+    return QVariantList();
+}
@@ -21,6 +21,8 @@
 #ifndef BACKLOGMANAGER_H
 #define BACKLOGMANAGER_H
 
+#include <QDateTime>
+
 #include "syncableobject.h"
 #include "types.h"
 
@@ -36,9 +38,42 @@ public:
 public slots:
     virtual QVariantList requestBacklog(BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
     inline virtual void receiveBacklog(BufferId, MsgId, MsgId, int, int, QVariantList) {};
+    //! Intermediate chunk of a streamed backlog reply, the final chunk arrives through receiveBacklog()
+    inline virtual void receiveBacklogPart(BufferId, MsgId, MsgId, int, int, QVariantList) {};
 
     virtual QVariantList requestBacklogAll(MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
     inline virtual void receiveBacklogAll(MsgId, MsgId, int, int, QVariantList) {};
+    //! Intermediate chunk of a streamed backlog reply, the final chunk arrives through receiveBacklogAll()
+    inline virtual void receiveBacklogAllPart(MsgId, MsgId, int, int, QVariantList) {};
+
+    //! Request the backlog of several buffers at once
+    /** Works like requestBacklog(bufferId, first[i], -1, limit, additional) for each of the buffers.
+     *  first may be empty, which means -1 for all of them. limit has to be positive, otherwise the
+     *  reply is empty. The reply is always streamed.
+     */
+    virtual QVariantList requestBacklogMulti(QVariantList bufferIds, QVariantList first, int limit = -1, int additional = 0);
+    inline virtual void receiveBacklogMulti(QVariantList, QVariantList, int, int, QVariantList) {};
+    //! Intermediate chunk of a streamed backlog reply, the final chunk arrives through receiveBacklogMulti()
+    /** bufferIds and first only hold the buffers that have messages in this chunk. */
+    inline virtual void receiveBacklogMultiPart(QVariantList, QVariantList, int, int, QVariantList) {};
+
+    //! Request the messages of a buffer sent in [start, end), optionally only those of the given Message::Types
+    /** An invalid start or end leaves that side of the range open, types == 0 selects all messages.
+     *  If there are more than limit messages in range, the oldest ones are returned. The core caps
+     *  the limit at 500; to get more, request again with the time of the newest message as start.
+     */
+    virtual QVariantList requestBacklogByTime(BufferId bufferId, QDateTime start, QDateTime end, int types = 0, int limit = -1);
+    inline virtual void receiveBacklogByTime(BufferId, QDateTime, QDateTime, int, int, QVariantList) {};
+
+    //! Search the whole backlog for messages containing all words of text
+    /** The results are newest first; pass the MsgId of the oldest result as last to get the next page.
+     *  The filter map may restrict the search using the following keys:
+     *    - "BufferId" (BufferId), "NetworkId" (NetworkId)
+     *    - "Sender" (QString): the nick of the sender
+     *    - "From", "To" (QDateTime): only messages sent in [From, To)
+     */
+    virtual QVariantList requestSearch(QString text, QVariantMap filter, MsgId last = -1, int limit = -1);
+    inline virtual void receiveSearch(QString, QVariantMap, MsgId, int, QVariantList) {};
 
 signals:
     void backlogRequested(BufferId, MsgId, MsgId, int, int);
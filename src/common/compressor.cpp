@@ -20,6 +20,7 @@
 
 #include "compressor.h"
 
+#include <QElapsedTimer>
 #include <QTcpSocket>
 #include <QTimer>
 
@@ -30,18 +31,86 @@
 #    include "../../3rdparty/miniz/miniz.c"
 #endif
 
+#ifdef HAVE_LZ4
+#    include <lz4frame.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#    include <zstd.h>
+#endif
+
 const int maxBufferSize = 64 * 1024 * 1024; // protect us from zip bombs
 const int ioBufferSize = 64 * 1024;         // chunk size for inflate/deflate; should not be too large as we preallocate that space!
 
-Compressor::Compressor(QTcpSocket *socket, Compressor::CompressionLevel level, QObject *parent)
+#ifdef HAVE_LZ4
+namespace {
+
+LZ4F_preferences_t lz4Preferences()
+{
+    LZ4F_preferences_t prefs;
+    memset(&prefs, 0, sizeof(prefs));
+    prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+    prefs.frameInfo.blockMode = LZ4F_blockLinked; // let messages refer to previous ones
+    prefs.autoFlush = 1;
+    return prefs;
+}
+
+}
+#endif
+
+#ifdef HAVE_ZSTD
+namespace {
+
+// Raw content dictionary for zstd, primed with the tokens dominating our traffic: type, class and slot
+// names of the SignalProxy protocols, and the most common IRC commands and numerics.
+// Both sides must use the very same dictionary, so any change to it must come with a new zstdDictionaryId!
+const char zstdDictionary[] =
+    "PRIVMSG NOTICE JOIN PART QUIT NICK MODE KICK TOPIC PING PONG AWAY ACCOUNT CHGHOST CAP WHO WHOIS "
+    "352 354 315 311 318 353 366 332 333 324 329 005 001 372 375 376 :irc. ACTION VERSION "
+    "QString QStringList QVariantList QVariantMap QByteArray QDateTime "
+    "BufferId\0BufferInfo\0Message\0MsgId\0NetworkId\0IdentityId\0NetworkInfo\0Network::Server\0"
+    "Identity\0PeerPtr\0"
+    "Network IrcUser IrcChannel BufferSyncer BufferViewConfig BufferViewManager BacklogManager "
+    "CoreInfo IgnoreListManager HighlightRuleManager AliasManager NetworkConfig TransferManager "
+    "displayMsg displayMsgs displayStatusMsg bufferInfoUpdated "
+    "setLastSeenMsg setMarkerLine setBufferActivity markBufferAsRead requestSetLastSeenMsg "
+    "requestSetMarkerLine requestBacklog receiveBacklog receiveBacklogPart requestBacklogAll "
+    "receiveBacklogAll receiveBacklogAllPart "
+    "setAway setAwayMessage setNick setUser setHost setRealName setAccount setServer setIdleTime "
+    "setLoginTime setLastAwayMessage setLastAwayMessageTime setIrcOperator setUserModes addUserModes "
+    "removeUserModes quit partChannel joinChannel joinIrcUsers part setTopic addChannelMode "
+    "removeChannelMode addUserMode removeUserMode setLatency setConnected setConnectionState "
+    "setCurrentServer setMyNick addIrcUser addIrcChannel "
+    "IrcUsersAndChannels nick user host realName account away awayMessage idleTime loginTime "
+    "server ircOperator lastAwayMessage lastAwayMessageTime whoisServiceReply suserHost encrypted "
+    "channels userModes topic password encrypted ChanModes UserModes";
+
+}
+#endif
+
+
+Compressor::Compressor(QTcpSocket *socket, Compressor::CompressionLevel level, Compressor::CompressionMethod method, QObject *parent)
     : QObject(parent),
     _socket(socket),
     _level(level),
+    _method(method),
     _inflater(0),
-    _deflater(0)
+    _deflater(0),
+    _lz4Compressor(0),
+    _lz4Decompressor(0),
+    _lz4HeaderWritten(false),
+    _zstdCompressor(0),
+    _zstdDecompressor(0),
+    _flushLatency(-1),
+    _flushBytes(0),
+    _flushTimer(new QTimer(this)),
+    _windowFlushes(0)
 {
     connect(socket, SIGNAL(readyRead()), SLOT(readData()));
 
+    _flushTimer->setSingleShot(true);
+    connect(_flushTimer, SIGNAL(timeout()), SLOT(writeData()));
+
     bool ok = true;
     if (level != NoCompression)
         ok = initStreams();
@@ -70,10 +139,99 @@ Compressor::~Compressor()
         deflateEnd(_deflater);
         delete _deflater;
     }
+
+#ifdef HAVE_LZ4
+    if (_lz4Compressor)
+        LZ4F_freeCompressionContext(_lz4Compressor);
+    if (_lz4Decompressor)
+        LZ4F_freeDecompressionContext(_lz4Decompressor);
+#endif
+
+#ifdef HAVE_ZSTD
+    if (_zstdCompressor)
+        ZSTD_freeCCtx(_zstdCompressor);
+    if (_zstdDecompressor)
+        ZSTD_freeDCtx(_zstdDecompressor);
+#endif
+}
+
+
+void Compressor::setWriteCoalescing(int latency, int maxBytes)
+{
+    _flushLatency = latency;
+    _flushBytes = maxBytes;
+
+    if (latency < 0 && _flushTimer->isActive())
+        writeData();
+}
+
+
+bool Compressor::isMethodSupported(CompressionMethod method)
+{
+    switch (method) {
+        case Deflate:
+            return true;
+        case Lz4:
+#ifdef HAVE_LZ4
+            return true;
+#else
+            return false;
+#endif
+        case Zstd:
+#ifdef HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+
+QString Compressor::methodName(CompressionMethod method)
+{
+    switch (method) {
+        case Deflate:
+            return "deflate";
+        case Lz4:
+            return "LZ4";
+        case Zstd:
+            return "zstd";
+    }
+    return QString();
+}
+
+
+int Compressor::zstdDictionaryId()
+{
+    // Announced in three bits of the connection features, so this must stay between 1 and 7
+    return 1;
 }
 
 
 bool Compressor::initStreams()
+{
+    bool ok = false;
+    switch (compressionMethod()) {
+        case Deflate:
+            ok = initDeflate();
+            break;
+        case Lz4:
+            ok = initLz4();
+            break;
+        case Zstd:
+            ok = initZstd();
+            break;
+    }
+
+    if (ok)
+        qDebug() << "Enabling" << qPrintable(methodName(compressionMethod())) << "compression...";
+
+    return ok;
+}
+
+
+bool Compressor::initDeflate()
 {
     int zlevel;
     switch(compressionLevel()) {
@@ -104,12 +262,74 @@ bool Compressor::initStreams()
     _inputBuffer.reserve(ioBufferSize); // pre-allocate space
     _outputBuffer.resize(ioBufferSize); // not a typo; we never change the size of this buffer anyway (we *do* for _inputBuffer!)
 
-    qDebug() << "Enabling compression...";
+    return true;
+}
+
+
+bool Compressor::initLz4()
+{
+#ifdef HAVE_LZ4
+    if (LZ4F_isError(LZ4F_createCompressionContext(&_lz4Compressor, LZ4F_VERSION))) {
+        qWarning() << "Could not initialize the LZ4 compression context!";
+        return false;
+    }
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&_lz4Decompressor, LZ4F_VERSION))) {
+        qWarning() << "Could not initialize the LZ4 decompression context!";
+        return false;
+    }
+
+    // room for the frame header and one compressed input chunk, so we never have to grow the buffer
+    LZ4F_preferences_t prefs = lz4Preferences();
+    _inputBuffer.reserve(ioBufferSize);
+    _outputBuffer.resize(LZ4F_compressBound(ioBufferSize, &prefs) + LZ4F_HEADER_SIZE_MAX);
 
     return true;
+#else
+    qWarning() << "LZ4 compression is not supported by this build!";
+    return false;
+#endif
 }
 
 
+bool Compressor::initZstd()
+{
+#ifdef HAVE_ZSTD
+    int zlevel;
+    switch(compressionLevel()) {
+        case BestCompression:
+            zlevel = 6;
+            break;
+        case BestSpeed:
+            zlevel = 1;
+            break;
+        default:
+            zlevel = ZSTD_CLEVEL_DEFAULT;
+    }
+
+    _zstdCompressor = ZSTD_createCCtx();
+    _zstdDecompressor = ZSTD_createDCtx();
+    if (!_zstdCompressor || !_zstdDecompressor) {
+        qWarning() << "Could not initialize the zstd streams!";
+        return false;
+    }
+
+    if (ZSTD_isError(ZSTD_CCtx_setParameter(_zstdCompressor, ZSTD_c_compressionLevel, zlevel))
+        || ZSTD_isError(ZSTD_CCtx_loadDictionary(_zstdCompressor, zstdDictionary, sizeof(zstdDictionary)))
+        || ZSTD_isError(ZSTD_DCtx_loadDictionary(_zstdDecompressor, zstdDictionary, sizeof(zstdDictionary)))) {
+        qWarning() << "Could not set up the zstd streams!";
+        return false;
+    }
+
+    _inputBuffer.reserve(ioBufferSize);
+    _outputBuffer.resize(ioBufferSize);
+
+    return true;
+#else
+    qWarning() << "Zstandard compression is not supported by this build!";
+    return false;
+#endif
+}
+
 
 qint64 Compressor::bytesAvailable() const
 {
@@ -142,14 +362,24 @@ qint64 Compressor::read(char *data, qint64 maxSize)
 // The usual usage pattern is to write a blocksize first, followed by the actual data.
 // By setting NoFlush, one can indicate that the write buffer should not immediately be
 // written, which should make things a bit more efficient.
+// With write coalescing enabled, even flushed writes are held back for a bit, so all
+// messages queued within one event loop iteration end up in a single flush.
 qint64 Compressor::write(const char *data, qint64 count, WriteBufferHint flush)
 {
     int pos = _writeBuffer.size();
     _writeBuffer.resize(pos + count);
     memcpy(_writeBuffer.data() + pos, data, count);
 
-    if (flush != NoFlush)
+    if (flush == NoFlush)
+        return count;
+
+    if (_flushLatency < 0 || _writeBuffer.size() >= _flushBytes)
         writeData();
+    else {
+        _stats.coalescedWrites++;
+        if (!_flushTimer->isActive())
+            _flushTimer->start(_flushLatency);
+    }
 
     return count;
 }
@@ -170,6 +400,22 @@ void Compressor::readData()
         return;
     }
 
+    switch (compressionMethod()) {
+        case Deflate:
+            readDeflate();
+            break;
+        case Lz4:
+            readLz4();
+            break;
+        case Zstd:
+            readZstd();
+            break;
+    }
+}
+
+
+void Compressor::readDeflate()
+{
     // We let zlib directly append to the readBuffer, which means we pre-allocate extra space for ioBufferSize.
     // Afterwards, we'll shrink the buffer appropriately. Since shrinking should not reallocate, the readBuffer's
     // capacity should over time adapt to the largest message sizes we encounter. However, this is not a bad thing
@@ -178,7 +424,9 @@ void Compressor::readData()
 
     while (_socket->bytesAvailable() && _readBuffer.size() + ioBufferSize < maxBufferSize && _inputBuffer.size() < ioBufferSize) {
         _readBuffer.resize(_readBuffer.size() + ioBufferSize);
-        _inputBuffer.append(_socket->read(ioBufferSize - _inputBuffer.size()));
+        QByteArray input = _socket->read(ioBufferSize - _inputBuffer.size());
+        _stats.bytesReceived += input.size();
+        _inputBuffer.append(input);
 
         _inflater->next_in = reinterpret_cast<unsigned char *>(_inputBuffer.data());
         _inflater->avail_in = _inputBuffer.size();
@@ -187,7 +435,11 @@ void Compressor::readData()
 
         const unsigned char *orig_out = _inflater->next_out; // so we see if we have actually produced any output
 
+        QElapsedTimer timer;
+        timer.start();
         int status = inflate(_inflater, Z_SYNC_FLUSH); // get as much data as possible
+        _stats.decompressNsecs += timer.nsecsElapsed();
+        _stats.bytesRead += _inflater->next_out - orig_out;
 
         // adjust input and output buffers
         _readBuffer.resize(_inflater->next_out - reinterpret_cast<unsigned char *>(_readBuffer.data()));
@@ -221,14 +473,147 @@ void Compressor::readData()
 }
 
 
+void Compressor::readLz4()
+{
+#ifdef HAVE_LZ4
+    // Same buffer handling as for deflate, see above
+    while (_socket->bytesAvailable() && _readBuffer.size() + ioBufferSize < maxBufferSize && _inputBuffer.size() < ioBufferSize) {
+        QByteArray input = _socket->read(ioBufferSize - _inputBuffer.size());
+        _stats.bytesReceived += input.size();
+        _inputBuffer.append(input);
+
+        const char *src = _inputBuffer.constData();
+        size_t srcLeft = _inputBuffer.size();
+        bool haveOutput = false;
+
+        QElapsedTimer timer;
+        timer.start();
+        while (_readBuffer.size() + ioBufferSize < maxBufferSize) {
+            int pos = _readBuffer.size();
+            _readBuffer.resize(pos + ioBufferSize);
+            size_t dstSize = ioBufferSize;
+            size_t srcSize = srcLeft;
+            size_t status = LZ4F_decompress(_lz4Decompressor, _readBuffer.data() + pos, &dstSize, src, &srcSize, 0);
+            _readBuffer.resize(pos + dstSize);
+            if (LZ4F_isError(status)) {
+                qWarning() << "Error while decompressing stream:" << LZ4F_getErrorName(status);
+                emit error(StreamError);
+                return;
+            }
+
+            src += srcSize;
+            srcLeft -= srcSize;
+            _stats.bytesRead += dstSize;
+            haveOutput |= dstSize > 0;
+
+            // a partially filled output buffer means there's nothing pending in the decompressor
+            if (srcLeft == 0 && dstSize < static_cast<size_t>(ioBufferSize))
+                break;
+            if (srcSize == 0 && dstSize == 0)
+                break;
+        }
+        _stats.decompressNsecs += timer.nsecsElapsed();
+
+        _inputBuffer.remove(0, _inputBuffer.size() - srcLeft);
+
+        if (haveOutput)
+            emit readyRead();
+    }
+#endif
+}
+
+
+void Compressor::readZstd()
+{
+#ifdef HAVE_ZSTD
+    // Same buffer handling as for deflate, see above
+    while (_socket->bytesAvailable() && _readBuffer.size() + ioBufferSize < maxBufferSize && _inputBuffer.size() < ioBufferSize) {
+        QByteArray data = _socket->read(ioBufferSize - _inputBuffer.size());
+        _stats.bytesReceived += data.size();
+        _inputBuffer.append(data);
+
+        ZSTD_inBuffer input = { _inputBuffer.constData(), static_cast<size_t>(_inputBuffer.size()), 0 };
+        bool haveOutput = false;
+
+        QElapsedTimer timer;
+        timer.start();
+        while (_readBuffer.size() + ioBufferSize < maxBufferSize) {
+            int pos = _readBuffer.size();
+            _readBuffer.resize(pos + ioBufferSize);
+            ZSTD_outBuffer output = { _readBuffer.data() + pos, static_cast<size_t>(ioBufferSize), 0 };
+            size_t status = ZSTD_decompressStream(_zstdDecompressor, &output, &input);
+            _readBuffer.resize(pos + output.pos);
+            if (ZSTD_isError(status)) {
+                qWarning() << "Error while decompressing stream:" << ZSTD_getErrorName(status);
+                emit error(StreamError);
+                return;
+            }
+
+            _stats.bytesRead += output.pos;
+            haveOutput |= output.pos > 0;
+
+            // if the output buffer wasn't filled, the decompressor has flushed all it could
+            if (output.pos < output.size)
+                break;
+        }
+        _stats.decompressNsecs += timer.nsecsElapsed();
+
+        _inputBuffer.remove(0, input.pos);
+
+        if (haveOutput)
+            emit readyRead();
+    }
+#endif
+}
+
+
 void Compressor::writeData()
 {
+    _flushTimer->stop();
+    if (_writeBuffer.isEmpty())
+        return;
+
+    _stats.flushes++;
+    _stats.bytesWritten += _writeBuffer.size();
+
+    if (!_flushRateTimer.isValid())
+        _flushRateTimer.start();
+    _windowFlushes++;
+    qint64 elapsed = _flushRateTimer.elapsed();
+    if (elapsed >= 1000) {
+        _stats.flushesPerSecond = _windowFlushes * 1000 / elapsed;
+        if (_stats.flushesPerSecond > _stats.maxFlushesPerSecond)
+            _stats.maxFlushesPerSecond = _stats.flushesPerSecond;
+        _windowFlushes = 0;
+        _flushRateTimer.restart();
+    }
+
     if (compressionLevel() == NoCompression) {
+        _stats.bytesSent += _writeBuffer.size();
         _socket->write(_writeBuffer);
         _writeBuffer.clear();
         return;
     }
 
+    QElapsedTimer timer;
+    timer.start();
+    switch (compressionMethod()) {
+        case Deflate:
+            writeDeflate();
+            break;
+        case Lz4:
+            writeLz4();
+            break;
+        case Zstd:
+            writeZstd();
+            break;
+    }
+    _stats.compressNsecs += timer.nsecsElapsed();
+}
+
+
+void Compressor::writeDeflate()
+{
     _deflater->next_in = reinterpret_cast<unsigned char *>(_writeBuffer.data());
     _deflater->avail_in = _writeBuffer.size();
 
@@ -246,6 +631,7 @@ void Compressor::writeData()
         if (_deflater->avail_out == static_cast<unsigned int>(ioBufferSize))
             continue; // nothing to write here
 
+        _stats.bytesSent += ioBufferSize - _deflater->avail_out;
         if (!_socket->write(_outputBuffer.constData(), ioBufferSize - _deflater->avail_out)) {
             qWarning() << "Error while writing to socket:" << _socket->errorString();
             emit error(DeviceError);
@@ -264,10 +650,89 @@ void Compressor::writeData()
 }
 
 
+void Compressor::writeLz4()
+{
+#ifdef HAVE_LZ4
+    LZ4F_preferences_t prefs = lz4Preferences();
+    char *out = _outputBuffer.data();
+    size_t capacity = _outputBuffer.size();
+    size_t outSize = 0;
+
+    if (!_lz4HeaderWritten) {
+        size_t status = LZ4F_compressBegin(_lz4Compressor, out, capacity, &prefs);
+        if (LZ4F_isError(status)) {
+            qWarning() << "Error while compressing stream:" << LZ4F_getErrorName(status);
+            emit error(StreamError);
+            return;
+        }
+        outSize = status;
+        _lz4HeaderWritten = true;
+    }
+
+    // compress in chunks, so the output buffer never needs to grow; thanks to autoFlush, every
+    // chunk is complete when LZ4F_compressUpdate() returns
+    int offset = 0;
+    do {
+        int chunkSize = qMin(_writeBuffer.size() - offset, ioBufferSize);
+        size_t status = LZ4F_compressUpdate(_lz4Compressor, out + outSize, capacity - outSize, _writeBuffer.constData() + offset, chunkSize, 0);
+        if (LZ4F_isError(status)) {
+            qWarning() << "Error while compressing stream:" << LZ4F_getErrorName(status);
+            emit error(StreamError);
+            return;
+        }
+        outSize += status;
+        offset += chunkSize;
+
+        if (outSize > 0) {
+            _stats.bytesSent += outSize;
+            if (!_socket->write(out, outSize)) {
+                qWarning() << "Error while writing to socket:" << _socket->errorString();
+                emit error(DeviceError);
+                return;
+            }
+            outSize = 0;
+        }
+    } while (offset < _writeBuffer.size());
+
+    _writeBuffer.resize(0);
+#endif
+}
+
+
+void Compressor::writeZstd()
+{
+#ifdef HAVE_ZSTD
+    ZSTD_inBuffer input = { _writeBuffer.constData(), static_cast<size_t>(_writeBuffer.size()), 0 };
+    size_t remaining;
+    do {
+        ZSTD_outBuffer output = { _outputBuffer.data(), static_cast<size_t>(ioBufferSize), 0 };
+        remaining = ZSTD_compressStream2(_zstdCompressor, &output, &input, ZSTD_e_flush);
+        if (ZSTD_isError(remaining)) {
+            qWarning() << "Error while compressing stream:" << ZSTD_getErrorName(remaining);
+            emit error(StreamError);
+            return;
+        }
+
+        if (output.pos == 0)
+            continue;
+
+        _stats.bytesSent += output.pos;
+        if (!_socket->write(_outputBuffer.constData(), output.pos)) {
+            qWarning() << "Error while writing to socket:" << _socket->errorString();
+            emit error(DeviceError);
+            return;
+        }
+    } while (remaining > 0); // zero means that all input has been consumed and flushed
+
+    _writeBuffer.resize(0);
+#endif
+}
+
+
 void Compressor::flush()
 {
-    if (compressionLevel() == NoCompression && _socket->state() == QAbstractSocket::ConnectedState)
-        _socket->flush();
+    writeData();
 
-    // FIXME: missing impl for enabled compression; but then we're not using this method yet
+    if (_socket->state() == QAbstractSocket::ConnectedState)
+        _socket->flush();
 }
@@ -21,9 +21,11 @@
 #ifndef COMPRESSOR_H
 #define COMPRESSOR_H
 
+#include <QElapsedTimer>
 #include <QObject>
 
 class QTcpSocket;
+class QTimer;
 
 #ifdef HAVE_ZLIB
     typedef struct z_stream_s *z_streamp;
@@ -31,6 +33,11 @@ class QTcpSocket;
     typedef struct mz_stream_s *z_streamp;
 #endif
 
+struct LZ4F_cctx_s;
+struct LZ4F_dctx_s;
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
 class Compressor : public QObject
 {
     Q_OBJECT
@@ -43,6 +50,12 @@ public:
         BestSpeed
     };
 
+    enum CompressionMethod {
+        Deflate,
+        Lz4,
+        Zstd
+    };
+
     enum Error {
         NoError,
         StreamError,
@@ -54,16 +67,49 @@ public:
         Flush
     };
 
-    Compressor(QTcpSocket *socket, CompressionLevel level, QObject *parent = 0);
+    //! Counters for comparing the cost and efficiency of the compression methods
+    struct Stats {
+        quint64 flushes{0};          ///< Number of times the write buffer was compressed and written
+        quint64 coalescedWrites{0};  ///< Writes that were deferred to share a flush with others
+        int flushesPerSecond{0};     ///< Flush rate over the last full second
+        int maxFlushesPerSecond{0};  ///< Highest flush rate seen so far
+        quint64 bytesWritten{0};     ///< Uncompressed bytes written
+        quint64 bytesSent{0};        ///< Compressed bytes sent to the socket
+        qint64 compressNsecs{0};     ///< Time spent compressing
+        quint64 bytesReceived{0};    ///< Compressed bytes received from the socket
+        quint64 bytesRead{0};        ///< Decompressed bytes
+        qint64 decompressNsecs{0};   ///< Time spent decompressing
+    };
+
+    Compressor(QTcpSocket *socket, CompressionLevel level, CompressionMethod method = Deflate, QObject *parent = 0);
     ~Compressor();
 
     CompressionLevel compressionLevel() const { return _level; }
+    CompressionMethod compressionMethod() const { return _method; }
+
+    //! Whether the given method has been compiled in
+    static bool isMethodSupported(CompressionMethod method);
+    static QString methodName(CompressionMethod method);
+
+    //! ID of the built-in zstd dictionary, announced in the handshake so both sides agree on it
+    static int zstdDictionaryId();
+
+    const Stats &stats() const { return _stats; }
+
+    //! Enable coalescing of flushed writes
+    /** Rather than being sent right away, flushed writes are collected for up to \a latency milliseconds
+     *  (0 meaning until control returns to the event loop) and then compressed and sent in one go.
+     *  The buffer is sent immediately once it holds \a maxBytes or more. A negative latency disables
+     *  coalescing, which is the default.
+     */
+    void setWriteCoalescing(int latency, int maxBytes);
 
     qint64 bytesAvailable() const;
 
     qint64 read(char *data, qint64 maxSize);
     qint64 write(const char *data, qint64 count, WriteBufferHint flush = Flush);
 
+    //! Send all pending data immediately
     void flush();
 
 signals:
@@ -72,14 +118,26 @@ signals:
 
 private slots:
     void readData();
+    void writeData();
 
 private:
     bool initStreams();
-    void writeData();
+    bool initDeflate();
+    bool initLz4();
+    bool initZstd();
+
+    void readDeflate();
+    void readLz4();
+    void readZstd();
+
+    void writeDeflate();
+    void writeLz4();
+    void writeZstd();
 
 private:
     QTcpSocket *_socket;
     CompressionLevel _level;
+    CompressionMethod _method;
 
     QByteArray _readBuffer;
     QByteArray _writeBuffer;
@@ -89,6 +147,21 @@ private:
 
     z_streamp _inflater;
     z_streamp _deflater;
+
+    LZ4F_cctx_s *_lz4Compressor;
+    LZ4F_dctx_s *_lz4Decompressor;
+    bool _lz4HeaderWritten;
+
+    ZSTD_CCtx_s *_zstdCompressor;
+    ZSTD_DCtx_s *_zstdDecompressor;
+
+    int _flushLatency;
+    int _flushBytes;
+    QTimer *_flushTimer;
+    QElapsedTimer _flushRateTimer;
+    int _windowFlushes;
+
+    Stats _stats;
 };
 
 #endif
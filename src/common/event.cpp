@@ -23,6 +23,105 @@
 #include "networkevent.h"
 #include "messageevent.h"
 
+namespace {
+
+const size_t poolGranularity = 16;
+const int poolClasses = 16;          // so we pool blocks of up to 256 bytes, enough for all our events
+const int maxPooledPerClass = 256;
+
+struct FreeBlock {
+    FreeBlock *next;
+};
+
+// Events may be deleted by a different thread than the one that created them, in which case the
+// memory simply moves to the deleting thread's pool.
+struct EventPool {
+    FreeBlock *freeLists[poolClasses] = {};
+    int counts[poolClasses] = {};
+    Event::PoolStats stats;
+
+    ~EventPool();
+};
+
+thread_local EventPool eventPool;
+thread_local bool eventPoolDestroyed = false; // trivially destructible, so still valid after the pool is gone
+
+EventPool::~EventPool()
+{
+    for (int i = 0; i < poolClasses; i++) {
+        while (freeLists[i]) {
+            FreeBlock *block = freeLists[i];
+            freeLists[i] = block->next;
+            ::operator delete(block);
+        }
+    }
+    eventPoolDestroyed = true;
+}
+
+
+inline size_t poolClass(size_t size)
+{
+    return (size + poolGranularity - 1) / poolGranularity - 1;
+}
+
+}
+
+
+void *Event::operator new(size_t size)
+{
+    size_t cls = poolClass(size);
+    if (eventPoolDestroyed || cls >= static_cast<size_t>(poolClasses))
+        return ::operator new(size);
+
+    EventPool &pool = eventPool;
+    pool.stats.allocations++;
+    FreeBlock *block = pool.freeLists[cls];
+    if (block) {
+        pool.freeLists[cls] = block->next;
+        pool.counts[cls]--;
+        pool.stats.pooled--;
+        pool.stats.reused++;
+        return block;
+    }
+    // always allocate the full class size, so the block can be reused for any event of this class
+    return ::operator new((cls + 1) * poolGranularity);
+}
+
+
+void Event::operator delete(void *ptr, size_t size)
+{
+    if (!ptr)
+        return;
+
+    size_t cls = poolClass(size);
+    if (eventPoolDestroyed || cls >= static_cast<size_t>(poolClasses)) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    EventPool &pool = eventPool;
+    pool.stats.releases++;
+    if (pool.counts[cls] >= maxPooledPerClass) {
+        ::operator delete(ptr);
+        return;
+    }
+
+    FreeBlock *block = static_cast<FreeBlock *>(ptr);
+    block->next = pool.freeLists[cls];
+    pool.freeLists[cls] = block;
+    pool.counts[cls]++;
+    pool.stats.pooled++;
+}
+
+
+Event::PoolStats Event::poolStats()
+{
+    if (eventPoolDestroyed)
+        return PoolStats();
+    return eventPool.stats;
+}
+
+
 Event::Event(EventManager::EventType type)
     : _type(type)
     , _valid(true)
@@ -31,9 +31,24 @@ class Network;
 class Event
 {
 public:
+    //! Counters of the per-thread event pool
+    struct PoolStats {
+        quint64 allocations{0};  ///< Events allocated
+        quint64 reused{0};       ///< Allocations served from the pool rather than the heap
+        quint64 releases{0};     ///< Events deleted
+        int pooled{0};           ///< Memory blocks currently kept for reuse
+    };
+
     explicit Event(EventManager::EventType type = EventManager::Invalid);
     virtual ~Event() {}
 
+    // Events are created and deleted for every single IRC line, so recycle their memory per thread
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr, size_t size);
+
+    //! The pool counters of the calling thread
+    static PoolStats poolStats();
+
     inline EventManager::EventType type() const { return _type; }
 
     inline void setFlag(EventManager::EventFlag flag) { _flags |= flag; }
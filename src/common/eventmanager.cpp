@@ -23,6 +23,7 @@
 #include <QCoreApplication>
 #include <QEvent>
 #include <QDebug>
+#include <QVarLengthArray>
 
 #include "event.h"
 #include "ircevent.h"
@@ -167,6 +168,7 @@ void EventManager::registerObject(QObject *object, Priority priority, const QStr
             //qDebug() << "Registered event filterer for" << methodSignature << "in" << object;
         }
     }
+    _dispatchChains.clear();
 }
 
 
@@ -206,6 +208,7 @@ void EventManager::registerEventHandler(QList<EventType> events, QObject *object
             qDebug() << "Registered event handler for" << event << "in" << object;
         }
     }
+    _dispatchChains.clear();
 }
 
 
@@ -251,63 +254,49 @@ void EventManager::dispatchEvent(Event *event)
 {
     //qDebug() << "Dispatching" << event;
 
-    // we try handlers from specialized to generic by masking the enum
-
-    // build a list sorted by priorities that contains all eligible handlers
-    QList<Handler> handlers;
-    QHash<QObject *, Handler> filters;
-    QSet<QObject *> ignored;
     uint type = event->type();
-
-    bool checkDupes = false;
+    int num = 0;
 
     // special handling for numeric IrcEvents
     if ((type & ~IrcEventNumericMask) == IrcEventNumeric) {
         ::IrcEventNumeric *numEvent = static_cast< ::IrcEventNumeric *>(event);
         if (!numEvent)
             qWarning() << "Invalid event type for IrcEventNumeric!";
-        else {
-            int num = numEvent->number();
-            if (num > 0) {
-                insertHandlers(registeredHandlers().value(type + num), handlers, false);
-                insertFilters(registeredFilters().value(type + num), filters);
-                checkDupes = true;
-            }
-        }
+        else
+            num = numEvent->number();
     }
 
-    // exact type
-    insertHandlers(registeredHandlers().value(type), handlers, checkDupes);
-    insertFilters(registeredFilters().value(type), filters);
+    // Take a copy, so handlers registering new handlers can't pull the chain from under our feet. This is
+    // cheap, since the vectors are implicitly shared.
+    const DispatchChain chain = dispatchChain(type, num);
 
-    // check if we have a generic handler for the event group
-    if ((type & EventGroupMask) != type) {
-        insertHandlers(registeredHandlers().value(type & EventGroupMask), handlers, true);
-        insertFilters(registeredFilters().value(type & EventGroupMask), filters);
-    }
+    // objects whose filter rejected the event
+    QVarLengthArray<bool, 16> ignored(chain.filters.count());
+    for (int i = 0; i < ignored.count(); i++)
+        ignored[i] = false;
 
     // now dispatch the event
-    QList<Handler>::const_iterator it;
-    for (it = handlers.begin(); it != handlers.end() && !event->isStopped(); ++it) {
-        QObject *obj = it->object;
+    for (int i = 0; i < chain.handlers.count() && !event->isStopped(); i++) {
+        const Handler &handler = chain.handlers.at(i);
+        QObject *obj = handler.object;
 
-        if (ignored.contains(obj)) // object has filtered the event
-            continue;
+        int filter = chain.filterIndex.at(i);
+        if (filter >= 0) { // we have a filter, so let's check if we want to deliver the event
+            if (ignored[filter]) // object has filtered the event
+                continue;
 
-        if (filters.contains(obj)) { // we have a filter, so let's check if we want to deliver the event
-            Handler filter = filters.value(obj);
             bool result = false;
             void *param[] = { Q_RETURN_ARG(bool, result).data(), Q_ARG(Event *, event).data() };
-            obj->qt_metacall(QMetaObject::InvokeMetaMethod, filter.methodIndex, param);
+            obj->qt_metacall(QMetaObject::InvokeMetaMethod, chain.filters.at(filter).methodIndex, param);
             if (!result) {
-                ignored.insert(obj);
+                ignored[filter] = true;
                 continue; // mmmh, event filter told us to not accept
             }
         }
 
         // finally, deliverance!
         void *param[] = { 0, Q_ARG(Event *, event).data() };
-        obj->qt_metacall(QMetaObject::InvokeMetaMethod, it->methodIndex, param);
+        obj->qt_metacall(QMetaObject::InvokeMetaMethod, handler.methodIndex, param);
     }
 
     // that's it
@@ -315,7 +304,68 @@ void EventManager::dispatchEvent(Event *event)
 }
 
 
-void EventManager::insertHandlers(const QList<Handler> &newHandlers, QList<Handler> &existing, bool checkDupes)
+EventManager::DispatchChain EventManager::dispatchChain(uint type, int numeric)
+{
+    // numerics occupy the 1000 values following IrcEventNumeric, so this key is unique
+    uint key = numeric > 0 ? type + numeric : type;
+    QHash<uint, DispatchChain>::const_iterator it = _dispatchChains.constFind(key);
+    if (it != _dispatchChains.constEnd())
+        return it.value();
+
+    return _dispatchChains.insert(key, compileDispatchChain(type, numeric)).value();
+}
+
+
+EventManager::DispatchChain EventManager::compileDispatchChain(uint type, int numeric) const
+{
+    // we try handlers from specialized to generic by masking the enum
+
+    // build a list sorted by priorities that contains all eligible handlers
+    QList<Handler> handlers;
+    QHash<QObject *, Handler> filters;
+
+    bool checkDupes = false;
+
+    // numeric-specific handlers
+    if (numeric > 0) {
+        insertHandlers(registeredHandlers().value(type + numeric), handlers, false);
+        insertFilters(registeredFilters().value(type + numeric), filters);
+        checkDupes = true;
+    }
+
+    // exact type
+    insertHandlers(registeredHandlers().value(type), handlers, checkDupes);
+    insertFilters(registeredFilters().value(type), filters);
+
+    // check if we have a generic handler for the event group
+    if ((type & EventGroupMask) != type) {
+        insertHandlers(registeredHandlers().value(type & EventGroupMask), handlers, true);
+        insertFilters(registeredFilters().value(type & EventGroupMask), filters);
+    }
+
+    // flatten everything, so dispatching doesn't need any lookups
+    DispatchChain chain;
+    QHash<QObject *, int> filterIndices;
+    chain.handlers.reserve(handlers.count());
+    chain.filterIndex.reserve(handlers.count());
+    foreach(const Handler &handler, handlers) {
+        int index = -1;
+        if (filters.contains(handler.object)) {
+            index = filterIndices.value(handler.object, -1);
+            if (index < 0) {
+                index = chain.filters.count();
+                chain.filters.append(filters.value(handler.object));
+                filterIndices[handler.object] = index;
+            }
+        }
+        chain.handlers.append(handler);
+        chain.filterIndex.append(index);
+    }
+    return chain;
+}
+
+
+void EventManager::insertHandlers(const QList<Handler> &newHandlers, QList<Handler> &existing, bool checkDupes) const
 {
     foreach(const Handler &handler, newHandlers) {
         if (existing.isEmpty())
@@ -344,7 +394,7 @@ void EventManager::insertHandlers(const QList<Handler> &newHandlers, QList<Handl
 
 // priority is ignored, and only the first (should be most specialized) filter is being used
 // fun things could happen if you used the registerEventFilter() methods in the wrong order though
-void EventManager::insertFilters(const QList<Handler> &newFilters, QHash<QObject *, Handler> &existing)
+void EventManager::insertFilters(const QList<Handler> &newFilters, QHash<QObject *, Handler> &existing) const
 {
     foreach(const Handler &filter, newFilters) {
         if (!existing.contains(filter.object))
@@ -22,6 +22,7 @@
 #define EVENTMANAGER_H
 
 #include <QMetaEnum>
+#include <QVector>
 
 #include "types.h"
 
@@ -169,6 +170,13 @@ private:
 
     typedef QHash<uint, QList<Handler> > HandlerHash;
 
+    //! The merged handlers and filters for one event type, as walked by dispatchEvent()
+    struct DispatchChain {
+        QVector<Handler> handlers;
+        QVector<int> filterIndex;    ///< Index into filters for each handler, or -1 if its object has no filter
+        QVector<Handler> filters;
+    };
+
     inline const HandlerHash &registeredHandlers() const { return _registeredHandlers; }
     inline HandlerHash &registeredHandlers() { return _registeredHandlers; }
 
@@ -176,20 +184,25 @@ private:
     inline HandlerHash &registeredFilters() { return _registeredFilters; }
 
     //! Add handlers to an existing sorted (by priority) handler list
-    void insertHandlers(const QList<Handler> &newHandlers, QList<Handler> &existing, bool checkDupes = false);
+    void insertHandlers(const QList<Handler> &newHandlers, QList<Handler> &existing, bool checkDupes = false) const;
     //! Add filters to an existing filter hash
-    void insertFilters(const QList<Handler> &newFilters, QHash<QObject *, Handler> &existing);
+    void insertFilters(const QList<Handler> &newFilters, QHash<QObject *, Handler> &existing) const;
 
     int findEventType(const QString &methodSignature, const QString &methodPrefix) const;
 
     void processEvent(Event *event);
     void dispatchEvent(Event *event);
 
+    //! Get the dispatch chain for the given type (and numeric), compiling it if necessary
+    DispatchChain dispatchChain(uint type, int numeric);
+    DispatchChain compileDispatchChain(uint type, int numeric) const;
+
     //! @return the EventType enum
     static QMetaEnum eventEnum();
 
     HandlerHash _registeredHandlers;
     HandlerHash _registeredFilters;
+    QHash<uint, DispatchChain> _dispatchChains; // cleared whenever handlers or filters are registered
     QList<Event *> _eventQueue;
     static QMetaEnum _enum;
 };
@@ -0,0 +1,145 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "highlightmatcher.h"
+
+namespace {
+
+// nick patterns are cheap to rebuild, so we don't bother with proper LRU eviction
+const int maxCachedNickPatterns = 32;
+
+bool hasChannelRestriction(const QString &chanName)
+{
+    return !chanName.isEmpty() && chanName != QLatin1String(".*");
+}
+
+}
+
+
+void HighlightMatcher::setRules(const RuleList &rules)
+{
+    _inverseRules.clear();
+    _rules.clear();
+    _literalPatterns.clear();
+
+    QStringList literals[2]; // indexed by isCaseSensitive
+    foreach(const Rule &rule, rules) {
+        if (!rule.isEnabled)
+            continue;
+
+        if (rule.isInverse)
+            _inverseRules << compile(rule);
+        else if (!rule.isRegEx && rule.sender.isEmpty() && !hasChannelRestriction(rule.chanName))
+            literals[rule.isCaseSensitive] << rule.name;
+        else
+            _rules << compile(rule);
+    }
+
+    if (!literals[0].isEmpty())
+        _literalPatterns << wordPattern(literals[0], Qt::CaseInsensitive);
+    if (!literals[1].isEmpty())
+        _literalPatterns << wordPattern(literals[1], Qt::CaseSensitive);
+}
+
+
+bool HighlightMatcher::matchRules(const QString &contents, const QString &sender, const QString &bufferName) const
+{
+    foreach(const CompiledRule &rule, _inverseRules) {
+        if (matches(rule, contents, sender, bufferName))
+            return false;
+    }
+
+    foreach(const QRegExp &pattern, _literalPatterns) {
+        if (pattern.indexIn(contents) >= 0)
+            return true;
+    }
+
+    foreach(const CompiledRule &rule, _rules) {
+        if (matches(rule, contents, sender, bufferName))
+            return true;
+    }
+    return false;
+}
+
+
+bool HighlightMatcher::matchNicks(const QString &contents, const QStringList &nicks, bool caseSensitive) const
+{
+    if (nicks.isEmpty())
+        return false;
+
+    // nicks can't contain spaces, so this makes for an unambiguous key
+    QString key = nicks.join(" ") + (caseSensitive ? " 1" : " 0");
+    QHash<QString, QRegExp>::const_iterator it = _nickPatterns.constFind(key);
+    if (it == _nickPatterns.constEnd()) {
+        if (_nickPatterns.count() >= maxCachedNickPatterns)
+            _nickPatterns.clear();
+        it = _nickPatterns.insert(key, wordPattern(nicks, caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive));
+    }
+    return it->indexIn(contents) >= 0;
+}
+
+
+HighlightMatcher::CompiledRule HighlightMatcher::compile(const Rule &rule)
+{
+    Qt::CaseSensitivity cs = rule.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+
+    CompiledRule compiled;
+    if (rule.isRegEx)
+        compiled.contents = QRegExp(rule.name, cs);
+    else
+        compiled.contents = wordPattern(QStringList() << rule.name, cs);
+
+    if (hasChannelRestriction(rule.chanName)) {
+        compiled.hasChanName = true;
+        compiled.chanNameInverse = rule.chanName.startsWith('!');
+        compiled.chanName = QRegExp(compiled.chanNameInverse ? rule.chanName.mid(1) : rule.chanName, Qt::CaseInsensitive);
+    }
+
+    if (!rule.sender.isEmpty()) {
+        compiled.hasSender = true;
+        if (rule.isRegEx)
+            compiled.sender = QRegExp(rule.sender, cs);
+        else
+            compiled.sender = QRegExp(rule.sender, Qt::CaseInsensitive, QRegExp::Wildcard);
+    }
+    return compiled;
+}
+
+
+bool HighlightMatcher::matches(const CompiledRule &rule, const QString &contents, const QString &sender, const QString &bufferName)
+{
+    if (rule.hasChanName && rule.chanName.exactMatch(bufferName) == rule.chanNameInverse)
+        return false;
+
+    if (rule.hasSender && !rule.sender.exactMatch(sender))
+        return false;
+
+    return rule.contents.indexIn(contents) >= 0;
+}
+
+
+QRegExp HighlightMatcher::wordPattern(const QStringList &words, Qt::CaseSensitivity cs)
+{
+    QStringList escaped;
+    foreach(const QString &word, words)
+        escaped << QRegExp::escape(word);
+
+    return QRegExp("(^|\\W)(?:" + escaped.join("|") + ")(\\W|$)", cs);
+}
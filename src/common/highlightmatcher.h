@@ -0,0 +1,95 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QRegExp>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Precompiled highlight rules, shared by the core- and client-side highlighting.
+ *
+ * Matching a message against the user's rules used to construct a fresh QRegExp for every rule,
+ * channel filter and nick on every single message. The matcher compiles the rule list once
+ * whenever it changes instead. Plain-text rules that apply to all channels and senders are folded
+ * into a single alternation (one per case sensitivity), so that the common case of many literal
+ * keywords costs one scan of the message rather than one per rule.
+ *
+ * Nick patterns are compiled on demand and cached by nick list, since the set of nicks to look
+ * for depends on the network a message belongs to.
+ */
+class HighlightMatcher
+{
+public:
+    struct Rule {
+        QString name;
+        bool isRegEx = false;
+        bool isCaseSensitive = false;
+        bool isEnabled = true;
+        bool isInverse = false;
+        QString sender;
+        QString chanName;
+
+        Rule() {}
+        Rule(const QString &name_, bool isRegEx_, bool isCaseSensitive_, bool isEnabled_, bool isInverse_,
+             const QString &sender_, const QString &chanName_)
+            : name(name_), isRegEx(isRegEx_), isCaseSensitive(isCaseSensitive_), isEnabled(isEnabled_),
+              isInverse(isInverse_), sender(sender_), chanName(chanName_) {}
+    };
+    typedef QList<Rule> RuleList;
+
+    //! Replace the rule set, compiling all patterns
+    void setRules(const RuleList &rules);
+
+    //! Check if a message matches the rules
+    /** Inverse rules take precedence: if any of them matches, the message is never highlighted.
+     *  \param contents   The message text with format codes already stripped
+     *  \param sender     The full sender (nick!user@host)
+     *  \param bufferName The name of the buffer the message belongs to
+     */
+    bool matchRules(const QString &contents, const QString &sender, const QString &bufferName) const;
+
+    //! Check if any of the given nicks occurs as a word in a message
+    /** \param contents The message text with format codes already stripped */
+    bool matchNicks(const QString &contents, const QStringList &nicks, bool caseSensitive) const;
+
+private:
+    struct CompiledRule {
+        QRegExp contents;
+        QRegExp chanName;
+        QRegExp sender;
+        bool hasChanName = false;
+        bool chanNameInverse = false;
+        bool hasSender = false;
+    };
+
+    static CompiledRule compile(const Rule &rule);
+    static bool matches(const CompiledRule &rule, const QString &contents, const QString &sender, const QString &bufferName);
+    static QRegExp wordPattern(const QStringList &words, Qt::CaseSensitivity cs);
+
+    QList<CompiledRule> _inverseRules;
+    QList<CompiledRule> _rules;
+    QList<QRegExp> _literalPatterns;
+
+    mutable QHash<QString, QRegExp> _nickPatterns;
+};
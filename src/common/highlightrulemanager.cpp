@@ -34,6 +34,7 @@ HighlightRuleManager &HighlightRuleManager::operator=(const HighlightRuleManager
     _highlightRuleList = other._highlightRuleList;
     _nicksCaseSensitive = other._nicksCaseSensitive;
     _highlightNick = other._highlightNick;
+    _matcherDirty = true;
     return *this;
 }
 
@@ -106,6 +107,7 @@ void HighlightRuleManager::initSetHighlightRuleList(const QVariantMap &highlight
     }
     _highlightNick = HighlightNickType(highlightRuleList["highlightNick"].toInt());
     _nicksCaseSensitive = highlightRuleList["nicksCaseSensitive"].toBool();
+    _matcherDirty = true;
 }
 
 void HighlightRuleManager::addHighlightRule(const QString &name, bool isRegEx, bool isCaseSensitive, bool isActive,
@@ -117,6 +119,7 @@ void HighlightRuleManager::addHighlightRule(const QString &name, bool isRegEx, b
 
     HighlightRule newItem = HighlightRule(name, isRegEx, isCaseSensitive, isActive, isInverse, sender, channel);
     _highlightRuleList << newItem;
+    _matcherDirty = true;
 
     SYNC(ARG(name), ARG(isRegEx), ARG(isCaseSensitive), ARG(isActive), ARG(isInverse), ARG(sender), ARG(channel))
 }
@@ -134,57 +137,17 @@ bool HighlightRuleManager::match(const QString &msgContents,
        return false;
     }
 
-    bool matches = false;
-
-    for (int i = 0; i < _highlightRuleList.count(); i++) {
-        const HighlightRule &rule = _highlightRuleList.at(i);
-        if (!rule.isEnabled)
-            continue;
-
-        if (rule.chanName.size() > 0 && rule.chanName.compare(".*") != 0) {
-            if (rule.chanName.startsWith("!")) {
-                QRegExp rx(rule.chanName.mid(1), Qt::CaseInsensitive);
-                if (rx.exactMatch(bufferName))
-                    continue;
-            }
-            else {
-                QRegExp rx(rule.chanName, Qt::CaseInsensitive);
-                if (!rx.exactMatch(bufferName))
-                    continue;
-            }
-        }
-
-        QRegExp rx;
-        if (rule.isRegEx) {
-            rx = QRegExp(rule.name, rule.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-        } else {
-            rx = QRegExp("(^|\\W)" + QRegExp::escape(rule.name) + "(\\W|$)", rule.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-        }
-        bool nameMatch = (rx.indexIn(stripFormatCodes(msgContents)) >= 0);
-
-        bool senderMatch;
-        if (rule.sender.isEmpty()) {
-            senderMatch = true;
-        } else {
-            if (rule.isRegEx) {
-                rx = QRegExp(rule.sender, rule.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            } else {
-                rx = QRegExp(rule.sender, Qt::CaseInsensitive, QRegExp::Wildcard);
-            }
-            senderMatch = rx.exactMatch(msgSender);
-        }
-
-        if (nameMatch && senderMatch) {
-            // If an inverse rule matches, then we know that we never want to return a highlight.
-            if (rule.isInverse) {
-                return false;
-            } else {
-                matches = true;
-            }
-        }
+    if (_matcherDirty) {
+        HighlightMatcher::RuleList rules;
+        foreach(const HighlightRule &rule, _highlightRuleList)
+            rules << HighlightMatcher::Rule(rule.name, rule.isRegEx, rule.isCaseSensitive, rule.isEnabled,
+                                            rule.isInverse, rule.sender, rule.chanName);
+        _matcher.setRules(rules);
+        _matcherDirty = false;
     }
 
-    if (matches)
+    QString contents = stripFormatCodes(msgContents);
+    if (_matcher.matchRules(contents, msgSender, bufferName))
         return true;
 
     if (!currentNick.isEmpty()) {
@@ -198,12 +161,8 @@ bool HighlightRuleManager::match(const QString &msgContents,
                 nickList.prepend(currentNick);
         }
 
-        for(const QString &nickname : nickList) {
-            QRegExp nickRegExp("(^|\\W)" + QRegExp::escape(nickname) + "(\\W|$)", _nicksCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            if (nickRegExp.indexIn(stripFormatCodes(msgContents)) >= 0) {
-                return true;
-            }
-        }
+        if (_matcher.matchNicks(contents, nickList, _nicksCaseSensitive))
+            return true;
     }
 
     return false;
@@ -222,6 +181,7 @@ void HighlightRuleManager::toggleHighlightRule(const QString &highlightRule)
     if (idx == -1)
         return;
     _highlightRuleList[idx].isEnabled = !_highlightRuleList[idx].isEnabled;
+    _matcherDirty = true;
     SYNC(ARG(highlightRule))
 }
 
@@ -28,6 +28,7 @@
 #include <QVariantList>
 #include <QVariantMap>
 
+#include "highlightmatcher.h"
 #include "message.h"
 #include "syncableobject.h"
 
@@ -76,9 +77,9 @@ public:
     inline bool contains(const QString &rule) const { return indexOf(rule) != -1; }
     inline bool isEmpty() const { return _highlightRuleList.isEmpty(); }
     inline int count() const { return _highlightRuleList.count(); }
-    inline void removeAt(int index) { _highlightRuleList.removeAt(index); }
-    inline void clear() { _highlightRuleList.clear(); }
-    inline HighlightRule &operator[](int i) { return _highlightRuleList[i]; }
+    inline void removeAt(int index) { _highlightRuleList.removeAt(index); _matcherDirty = true; }
+    inline void clear() { _highlightRuleList.clear(); _matcherDirty = true; }
+    inline HighlightRule &operator[](int i) { _matcherDirty = true; return _highlightRuleList[i]; }
     inline const HighlightRule &operator[](int i) const { return _highlightRuleList.at(i); }
     inline const HighlightRuleList &highlightRuleList() const { return _highlightRuleList; }
 
@@ -142,7 +143,7 @@ public slots:
     inline void setNicksCaseSensitive(bool nicksCaseSensitive) { _nicksCaseSensitive = nicksCaseSensitive; }
 
 protected:
-    void setHighlightRuleList(const QList<HighlightRule> &HighlightRuleList) { _highlightRuleList = HighlightRuleList; }
+    void setHighlightRuleList(const QList<HighlightRule> &HighlightRuleList) { _highlightRuleList = HighlightRuleList; _matcherDirty = true; }
 
     bool match(const QString &msgContents,
                const QString &msgSender,
@@ -159,4 +160,7 @@ private:
     HighlightRuleList _highlightRuleList;
     HighlightNickType _highlightNick = HighlightNickType::CurrentNick;
     bool _nicksCaseSensitive = false;
+
+    HighlightMatcher _matcher;
+    bool _matcherDirty = true;  ///< Rule list changed since the matcher was last compiled
 };
@@ -24,6 +24,21 @@
 #include <QDebug>
 #include <QStringList>
 
+namespace {
+
+// the caches are rebuilt quickly, so we simply drop them once they grow too large
+const int maxCachedScopes = 2048;
+const int maxCachedVerdicts = 4096;
+
+bool itemMatch(const IgnoreListManager::IgnoreListItem &item, const QString &string)
+{
+    if (item.isRegEx)
+        return item.regEx.indexIn(string) != -1;
+    return item.regEx.exactMatch(string);
+}
+
+}
+
 INIT_SYNCABLE_OBJECT(IgnoreListManager)
 IgnoreListManager &IgnoreListManager::operator=(const IgnoreListManager &other)
 {
@@ -32,6 +47,7 @@ IgnoreListManager &IgnoreListManager::operator=(const IgnoreListManager &other)
 
     SyncableObject::operator=(other);
     _ignoreList = other._ignoreList;
+    invalidateCache();
     return *this;
 }
 
@@ -101,6 +117,7 @@ void IgnoreListManager::initSetIgnoreList(const QVariantMap &ignoreList)
             static_cast<StrictnessType>(strictness[i].toInt()), static_cast<ScopeType>(scope[i].toInt()),
             scopeRule[i], isActive[i].toBool());
     }
+    invalidateCache();
 }
 
 
@@ -119,6 +136,7 @@ void IgnoreListManager::addIgnoreListItem(int type, const QString &ignoreRule, b
     IgnoreListItem newItem = IgnoreListItem(static_cast<IgnoreType>(type), ignoreRule, isRegEx, static_cast<StrictnessType>(strictness),
         static_cast<ScopeType>(scope), scopeRule, isActive);
     _ignoreList << newItem;
+    invalidateCache();
 
     SYNC(ARG(type), ARG(ignoreRule), ARG(isRegEx), ARG(strictness), ARG(scope), ARG(scopeRule), ARG(isActive))
 }
@@ -132,30 +150,38 @@ IgnoreListManager::StrictnessType IgnoreListManager::_match(const QString &msgCo
     if (!(msgType & (Message::Plain | Message::Notice | Message::Action)))
         return UnmatchedStrictness;
 
-    foreach(IgnoreListItem item, _ignoreList) {
-        if (!item.isActive || item.type == CtcpIgnore)
-            continue;
-        if (item.scope == GlobalScope
-            || (item.scope == NetworkScope && scopeMatch(item.scopeRule, network))
-            || (item.scope == ChannelScope && scopeMatch(item.scopeRule, bufferName))) {
-            QString str;
-            if (item.type == MessageIgnore)
-                str = msgContents;
-            else
-                str = msgSender;
-
-//      qDebug() << "IgnoreListManager::match: ";
-//      qDebug() << "string: " << str;
-//      qDebug() << "pattern: " << ruleRx.pattern();
-//      qDebug() << "scopeRule: " << item.scopeRule;
-//      qDebug() << "now testing";
-            if ((!item.isRegEx && item.regEx.exactMatch(str)) ||
-                (item.isRegEx && item.regEx.indexIn(str) != -1)) {
-//        qDebug() << "MATCHED!";
-                return item.strictness;
+    ScopedRules &rules = scopedRules(network, bufferName);
+
+    int senderMatch = -1;
+    if (!rules.senderRules.isEmpty()) {
+        QHash<QString, int>::const_iterator verdict = rules.senderVerdicts.constFind(msgSender);
+        if (verdict != rules.senderVerdicts.constEnd()) {
+            senderMatch = *verdict;
+        }
+        else {
+            foreach(int index, rules.senderRules) {
+                if (itemMatch(_ignoreList.at(index), msgSender)) {
+                    senderMatch = index;
+                    break;
+                }
             }
+            if (rules.senderVerdicts.count() >= maxCachedVerdicts)
+                rules.senderVerdicts.clear();
+            rules.senderVerdicts.insert(msgSender, senderMatch);
         }
     }
+
+    // The first matching rule in the list wins, so message rules only need to be tested up to
+    // the matching sender rule
+    foreach(int index, rules.messageRules) {
+        if (senderMatch != -1 && index > senderMatch)
+            break;
+        if (itemMatch(_ignoreList.at(index), msgContents))
+            return _ignoreList.at(index).strictness;
+    }
+
+    if (senderMatch != -1)
+        return _ignoreList.at(senderMatch).strictness;
     return UnmatchedStrictness;
 }
 
@@ -187,31 +213,122 @@ void IgnoreListManager::toggleIgnoreRule(const QString &ignoreRule)
     if (idx == -1)
         return;
     _ignoreList[idx].isActive = !_ignoreList[idx].isActive;
+    invalidateCache();
     SYNC(ARG(ignoreRule))
 }
 
 
 bool IgnoreListManager::ctcpMatch(const QString sender, const QString &network, const QString &type)
 {
-    foreach(IgnoreListItem item, _ignoreList) {
-        if (!item.isActive)
-            continue;
-        if (item.scope == GlobalScope || (item.scope == NetworkScope && scopeMatch(item.scopeRule, network))) {
-            QString sender_;
-            QStringList types = item.ignoreRule.split(QRegExp("\\s+"), QString::SkipEmptyParts);
-
-            sender_ = types.takeAt(0);
-
-            QRegExp ruleRx = QRegExp(sender_);
-            ruleRx.setCaseSensitivity(Qt::CaseInsensitive);
-            if (!item.isRegEx)
-                ruleRx.setPatternSyntax(QRegExp::Wildcard);
-            if ((!item.isRegEx && ruleRx.exactMatch(sender)) ||
-                (item.isRegEx && ruleRx.indexIn(sender) != -1)) {
-                if (types.isEmpty() || types.contains(type, Qt::CaseInsensitive))
-                    return true;
-            }
+    foreach(int i, ctcpRules(network)) {
+        const CtcpRule &rule = _ctcpRules.at(i);
+        bool senderMatch;
+        if (_ignoreList.at(rule.index).isRegEx)
+            senderMatch = rule.sender.indexIn(sender) != -1;
+        else
+            senderMatch = rule.sender.exactMatch(sender);
+
+        if (senderMatch && (rule.types.isEmpty() || rule.types.contains(type, Qt::CaseInsensitive)))
+            return true;
+    }
+    return false;
+}
+
+
+void IgnoreListManager::invalidateCache()
+{
+    _compiled = false;
+    _scopePatterns.clear();
+    _ctcpRules.clear();
+    _scopedRules.clear();
+    _ctcpRulesByNetwork.clear();
+}
+
+
+void IgnoreListManager::compile()
+{
+    invalidateCache();
+
+    QRegExp separator("\\s+");
+    for (int i = 0; i < _ignoreList.count(); i++) {
+        const IgnoreListItem &item = _ignoreList.at(i);
+
+        QList<QRegExp> scopePatterns;
+        if (item.scope != GlobalScope) {
+            foreach(QString rule, item.scopeRule.split(";"))
+                scopePatterns << QRegExp(rule.trimmed(), Qt::CaseInsensitive, QRegExp::Wildcard);
+        }
+        _scopePatterns << scopePatterns;
+
+        // CTCP rules are of the form "<sender> [<type> ...]"
+        QStringList types = item.ignoreRule.split(separator, QString::SkipEmptyParts);
+        if (item.isActive && !types.isEmpty()) {
+            CtcpRule rule;
+            rule.index = i;
+            rule.sender = QRegExp(types.takeFirst(), Qt::CaseInsensitive, item.isRegEx ? QRegExp::RegExp : QRegExp::Wildcard);
+            rule.types = types;
+            _ctcpRules << rule;
         }
     }
+    _compiled = true;
+}
+
+
+bool IgnoreListManager::compiledScopeMatch(int index, const QString &string) const
+{
+    foreach(const QRegExp &pattern, _scopePatterns.at(index)) {
+        if (pattern.exactMatch(string))
+            return true;
+    }
     return false;
 }
+
+
+IgnoreListManager::ScopedRules &IgnoreListManager::scopedRules(const QString &network, const QString &bufferName)
+{
+    if (!_compiled)
+        compile();
+
+    QString key = network + '\n' + bufferName;
+    QHash<QString, ScopedRules>::iterator it = _scopedRules.find(key);
+    if (it != _scopedRules.end())
+        return *it;
+
+    if (_scopedRules.count() >= maxCachedScopes)
+        _scopedRules.clear();
+
+    ScopedRules rules;
+    for (int i = 0; i < _ignoreList.count(); i++) {
+        const IgnoreListItem &item = _ignoreList.at(i);
+        if (!item.isActive || item.type == CtcpIgnore)
+            continue;
+        if (item.scope == GlobalScope
+            || (item.scope == NetworkScope && compiledScopeMatch(i, network))
+            || (item.scope == ChannelScope && compiledScopeMatch(i, bufferName))) {
+            if (item.type == MessageIgnore)
+                rules.messageRules << i;
+            else
+                rules.senderRules << i;
+        }
+    }
+    return *_scopedRules.insert(key, rules);
+}
+
+
+const QList<int> &IgnoreListManager::ctcpRules(const QString &network)
+{
+    if (!_compiled)
+        compile();
+
+    QHash<QString, QList<int> >::iterator it = _ctcpRulesByNetwork.find(network);
+    if (it != _ctcpRulesByNetwork.end())
+        return *it;
+
+    QList<int> rules;
+    for (int i = 0; i < _ctcpRules.count(); i++) {
+        const IgnoreListItem &item = _ignoreList.at(_ctcpRules.at(i).index);
+        if (item.scope == GlobalScope || (item.scope == NetworkScope && compiledScopeMatch(_ctcpRules.at(i).index, network)))
+            rules << i;
+    }
+    return *_ctcpRulesByNetwork.insert(network, rules);
+}
@@ -21,6 +21,7 @@
 #ifndef IGNORELISTMANAGER_H
 #define IGNORELISTMANAGER_H
 
+#include <QHash>
 #include <QString>
 #include <QRegExp>
 
@@ -88,8 +89,8 @@ public:
     inline bool contains(const QString &ignore) const { return indexOf(ignore) != -1; }
     inline bool isEmpty() const { return _ignoreList.isEmpty(); }
     inline int count() const { return _ignoreList.count(); }
-    inline void removeAt(int index) { _ignoreList.removeAt(index); }
-    inline IgnoreListItem &operator[](int i) { return _ignoreList[i]; }
+    inline void removeAt(int index) { _ignoreList.removeAt(index); invalidateCache(); }
+    inline IgnoreListItem &operator[](int i) { invalidateCache(); return _ignoreList[i]; }
     inline const IgnoreListItem &operator[](int i) const { return _ignoreList.at(i); }
     inline const IgnoreList &ignoreList() const { return _ignoreList; }
 
@@ -146,7 +147,7 @@ public slots:
         int scope, const QString &scopeRule, bool isActive);
 
 protected:
-    void setIgnoreList(const QList<IgnoreListItem> &ignoreList) { _ignoreList = ignoreList; }
+    void setIgnoreList(const QList<IgnoreListItem> &ignoreList) { _ignoreList = ignoreList; invalidateCache(); }
     bool scopeMatch(const QString &scopeRule, const QString &string) const; // scopeRule is a ';'-separated list, string is a network/channel-name
 
     StrictnessType _match(const QString &msgContents, const QString &msgSender, Message::Type msgType, const QString &network, const QString &bufferName);
@@ -155,7 +156,34 @@ signals:
     void ignoreAdded(IgnoreType type, const QString &ignoreRule, bool isRegex, StrictnessType strictness, ScopeType scope, const QVariant &scopeRule, bool isActive);
 
 private:
+    //! The active rules applying to a given network and buffer, as indexes into _ignoreList
+    struct ScopedRules {
+        QList<int> senderRules;
+        QList<int> messageRules;
+        QHash<QString, int> senderVerdicts; ///< First matching sender rule per sender, -1 if none
+    };
+
+    //! A rule split into its sender pattern and CTCP types
+    struct CtcpRule {
+        int index;
+        QRegExp sender;
+        QStringList types;
+    };
+
+    void invalidateCache();
+    void compile();
+    bool compiledScopeMatch(int index, const QString &string) const;
+    ScopedRules &scopedRules(const QString &network, const QString &bufferName);
+    const QList<int> &ctcpRules(const QString &network);
+
     IgnoreList _ignoreList;
+
+    // Compiled rules, rebuilt lazily whenever the list changes
+    bool _compiled = false;
+    QList<QList<QRegExp> > _scopePatterns; ///< Indexed like _ignoreList
+    QList<CtcpRule> _ctcpRules;
+    QHash<QString, ScopedRules> _scopedRules;
+    QHash<QString, QList<int> > _ctcpRulesByNetwork;
 };
 
 
@@ -49,6 +49,14 @@ namespace IrcCap {
      */
     const uint ACCOUNT_NOTIFY_WHOX_NUM = 369;
 
+    /**
+     * Magic number for WHOX refreshing only away state and account ("%tcnfa")
+     *
+     * Used by AutoWho for channels that have already been polled with all fields, keeping the
+     * replies for large channels small.
+     */
+    const uint AUTO_WHOX_MINIMAL_NUM = 370;
+
     /**
      * Away change notification.
      *
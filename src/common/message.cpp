@@ -25,6 +25,8 @@
 #include "signalproxy.h"
 
 #include <QDataStream>
+#include <QDebug>
+#include <QHash>
 
 Message::Message(const BufferInfo &bufferInfo, Type type, const QString &contents, const QString &sender, const QString &senderPrefixes, Flags flags)
     : _timestamp(QDateTime::currentDateTime().toUTC()),
@@ -103,6 +105,193 @@ QDataStream &operator>>(QDataStream &in, Message &msg)
 }
 
 
+namespace {
+
+const quint8 compactMessagesVersion = 1;
+
+void writeVarUInt(QDataStream &out, quint64 value)
+{
+    char buf[10];
+    int len = 0;
+    do {
+        quint8 byte = value & 0x7f;
+        value >>= 7;
+        if (value)
+            byte |= 0x80;
+        buf[len++] = byte;
+    } while (value);
+    out.writeRawData(buf, len);
+}
+
+
+quint64 readVarUInt(QDataStream &in)
+{
+    quint64 value = 0;
+    for (int shift = 0; shift < 64 && !in.atEnd(); shift += 7) {
+        quint8 byte;
+        in >> byte;
+        value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    in.setStatus(QDataStream::ReadCorruptData);
+    return 0;
+}
+
+
+// zigzag encoding keeps small negative deltas small
+inline void writeVarInt(QDataStream &out, qint64 value)
+{
+    writeVarUInt(out, (quint64(value) << 1) ^ quint64(value >> 63));
+}
+
+
+inline qint64 readVarInt(QDataStream &in)
+{
+    quint64 value = readVarUInt(in);
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+
+void writeString(QDataStream &out, const QString &string)
+{
+    QByteArray utf8 = string.toUtf8();
+    writeVarUInt(out, utf8.size());
+    out.writeRawData(utf8.constData(), utf8.size());
+}
+
+
+QString readString(QDataStream &in)
+{
+    quint64 size = readVarUInt(in);
+    if (in.status() != QDataStream::Ok || size > quint64(in.device()->bytesAvailable())) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return QString();
+    }
+    QByteArray utf8(size, Qt::Uninitialized);
+    in.readRawData(utf8.data(), size);
+    return QString::fromUtf8(utf8);
+}
+
+
+QByteArray packMessages(const MessageList &messages)
+{
+    QHash<BufferId, int> bufferIndex;
+    QList<BufferInfo> buffers;
+    foreach(const Message &msg, messages) {
+        if (!bufferIndex.contains(msg.bufferId())) {
+            bufferIndex[msg.bufferId()] = buffers.count();
+            buffers << msg.bufferInfo();
+        }
+    }
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << compactMessagesVersion;
+    writeVarUInt(out, buffers.count());
+    foreach(const BufferInfo &bufferInfo, buffers) {
+        out << bufferInfo;
+    }
+
+    writeVarUInt(out, messages.count());
+    qint64 lastMsgId = 0;
+    qint64 lastTimestamp = 0;
+    foreach(const Message &msg, messages) {
+        qint64 timestamp = msg.timestamp().toTime_t();
+        writeVarUInt(out, bufferIndex.value(msg.bufferId()));
+        writeVarInt(out, msg.msgId().toInt() - lastMsgId);
+        writeVarInt(out, timestamp - lastTimestamp);
+        writeVarUInt(out, msg.type());
+        out << (quint8) msg.flags();
+        writeString(out, msg.sender());
+        writeString(out, msg.senderPrefixes());
+        writeString(out, msg.contents());
+        lastMsgId = msg.msgId().toInt();
+        lastTimestamp = timestamp;
+    }
+    return data;
+}
+
+
+MessageList unpackMessages(const QByteArray &data)
+{
+    MessageList messages;
+    QDataStream in(data);
+
+    quint8 version;
+    in >> version;
+    if (version != compactMessagesVersion) {
+        qWarning() << "Received messages with unknown encoding version" << version;
+        return messages;
+    }
+
+    QList<BufferInfo> buffers;
+    quint64 bufferCount = readVarUInt(in);
+    for (quint64 i = 0; i < bufferCount && in.status() == QDataStream::Ok; i++) {
+        BufferInfo bufferInfo;
+        in >> bufferInfo;
+        buffers << bufferInfo;
+    }
+
+    quint64 count = readVarUInt(in);
+    qint64 msgId = 0;
+    qint64 timestamp = 0;
+    for (quint64 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        quint64 index = readVarUInt(in);
+        msgId += readVarInt(in);
+        timestamp += readVarInt(in);
+        Message::Type type = (Message::Type)readVarUInt(in);
+        quint8 flags;
+        in >> flags;
+        QString sender = readString(in);
+        QString senderPrefixes = readString(in);
+        QString contents = readString(in);
+        if (in.status() != QDataStream::Ok || index >= quint64(buffers.count()))
+            break;
+
+        Message msg(QDateTime::fromTime_t(timestamp), buffers.at(index), type, contents, sender, senderPrefixes, (Message::Flags)flags);
+        msg.setMsgId(msgId);
+        messages << msg;
+    }
+
+    if (in.status() != QDataStream::Ok || quint64(messages.count()) != count)
+        qWarning() << "Received corrupted message list, decoded" << messages.count() << "of" << count << "messages";
+
+    return messages;
+}
+
+}
+
+
+QVariantList messagesToVariantList(const MessageList &messages, const Peer *peer)
+{
+    QVariantList list;
+    if (peer && peer->hasFeature(Quassel::Feature::CompactMessages)) {
+        if (!messages.isEmpty())
+            list << packMessages(messages);
+        return list;
+    }
+
+    foreach(const Message &msg, messages) {
+        list << qVariantFromValue(msg);
+    }
+    return list;
+}
+
+
+MessageList messagesFromVariantList(const QVariantList &list)
+{
+    MessageList messages;
+    foreach(const QVariant &v, list) {
+        if (v.type() == QVariant::ByteArray)
+            messages << unpackMessages(v.toByteArray());
+        else
+            messages << v.value<Message>();
+    }
+    return messages;
+}
+
+
 QDebug operator<<(QDebug dbg, const Message &msg)
 {
     dbg.nospace() << qPrintable(QString("Message(MsgId:")) << msg.msgId()
@@ -23,6 +23,7 @@
 
 #include <QCoreApplication>
 #include <QDateTime>
+#include <QVariant>
 
 #include "bufferinfo.h"
 #include "types.h"
@@ -112,6 +113,18 @@ QDataStream &operator<<(QDataStream &out, const Message &msg);
 QDataStream &operator>>(QDataStream &in, Message &msg);
 QDebug operator<<(QDebug dbg, const Message &msg);
 
+class Peer;
+
+//! Prepares a list of messages for sending it to the given peer
+/** If the peer supports Quassel::Feature::CompactMessages, the list is packed into a single
+ *  QByteArray: every BufferInfo is sent only once, and MsgIds and timestamps are stored as
+ *  varint-packed deltas. Otherwise every message becomes an entry of its own.
+ */
+QVariantList messagesToVariantList(const MessageList &messages, const Peer *peer);
+
+//! Extracts the messages from a list created by messagesToVariantList()
+MessageList messagesFromVariantList(const QVariantList &list);
+
 Q_DECLARE_METATYPE(Message)
 Q_DECLARE_OPERATORS_FOR_FLAGS(Message::Types)
 Q_DECLARE_OPERATORS_FOR_FLAGS(Message::Flags)
@@ -23,6 +23,7 @@
 Peer::Peer(AuthHandler *authHandler, QObject *parent)
     : QObject(parent)
     , _authHandler(authHandler)
+    , _featuresKey(_features.toStringList().join(',').toUtf8())
 {
 
 }
@@ -68,6 +69,35 @@ Quassel::Features Peer::features() const
 
 void Peer::setFeatures(Quassel::Features features) {
     _features = std::move(features);
+    _featuresKey = _features.toStringList().join(',').toUtf8();
+}
+
+QByteArray Peer::featuresKey() const
+{
+    return _featuresKey;
+}
+
+QByteArray Peer::serializationKey() const
+{
+    return QByteArray();
+}
+
+QByteArray Peer::serializeParams(const QVariantList &params)
+{
+    Q_UNUSED(params)
+    return QByteArray();
+}
+
+void Peer::dispatchSerialized(const Protocol::SyncMessage &msg, const QByteArray &serializedParams)
+{
+    Q_UNUSED(serializedParams)
+    dispatch(msg);
+}
+
+void Peer::dispatchSerialized(const Protocol::RpcCall &msg, const QByteArray &serializedParams)
+{
+    Q_UNUSED(serializedParams)
+    dispatch(msg);
 }
 
 int Peer::id() const {
@@ -69,6 +69,17 @@ public:
     virtual QString address() const = 0;
     virtual quint16 port() const = 0;
 
+    /* Broadcast fan-out */
+    //! Identifies peers that serialize message parameters to identical bytes
+    /** SignalProxy serializes the parameters of a broadcast only once for all peers sharing the same
+     *  non-empty key, and hands the result to dispatchSerialized(). An empty key (the default) means
+     *  that the peer can only be sent regular messages.
+     */
+    virtual QByteArray serializationKey() const;
+    virtual QByteArray serializeParams(const QVariantList &params);
+    virtual void dispatchSerialized(const Protocol::SyncMessage &msg, const QByteArray &serializedParams);
+    virtual void dispatchSerialized(const Protocol::RpcCall &msg, const QByteArray &serializedParams);
+
 public slots:
     /* Handshake messages */
     virtual void dispatch(const Protocol::RegisterClient &) = 0;
@@ -99,6 +110,9 @@ protected:
     template<typename T>
     void handle(const T &protoMessage);
 
+    //! The enabled features in a form suitable for serializationKey()
+    QByteArray featuresKey() const;
+
 private:
     QPointer<AuthHandler> _authHandler;
 
@@ -107,6 +121,7 @@ private:
     QString _buildDate;
     QString _clientVersion;
     Quassel::Features _features;
+    QByteArray _featuresKey;
 
     int _id = -1;
 };
@@ -20,6 +20,7 @@
 
 #include "peerfactory.h"
 
+#include "protocols/binary/binarypeer.h"
 #include "protocols/datastream/datastreampeer.h"
 #include "protocols/legacy/legacypeer.h"
 
@@ -27,19 +28,20 @@
 PeerFactory::ProtoList PeerFactory::supportedProtocols()
 {
     ProtoList result;
+    result.append(ProtoDescriptor(Protocol::BinaryProtocol, BinaryPeer::supportedFeatures()));
     result.append(ProtoDescriptor(Protocol::DataStreamProtocol, DataStreamPeer::supportedFeatures()));
     result.append(ProtoDescriptor(Protocol::LegacyProtocol, 0));
     return result;
 }
 
 
-RemotePeer *PeerFactory::createPeer(const ProtoDescriptor &protocol, AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, QObject *parent)
+RemotePeer *PeerFactory::createPeer(const ProtoDescriptor &protocol, AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, Compressor::CompressionMethod method, QObject *parent)
 {
-    return createPeer(ProtoList() << protocol, authHandler, socket, level, parent);
+    return createPeer(ProtoList() << protocol, authHandler, socket, level, method, parent);
 }
 
 
-RemotePeer *PeerFactory::createPeer(const ProtoList &protocols, AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, QObject *parent)
+RemotePeer *PeerFactory::createPeer(const ProtoList &protocols, AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, Compressor::CompressionMethod method, QObject *parent)
 {
     foreach(const ProtoDescriptor &protodesc, protocols) {
         Protocol::Type proto = protodesc.first;
@@ -47,9 +49,13 @@ RemotePeer *PeerFactory::createPeer(const ProtoList &protocols, AuthHandler *aut
         switch(proto) {
             case Protocol::LegacyProtocol:
                 return new LegacyPeer(authHandler, socket, level, parent);
+            case Protocol::BinaryProtocol:
+                if (BinaryPeer::acceptsFeatures(features))
+                    return new BinaryPeer(authHandler, socket, features, level, method, parent);
+                break;
             case Protocol::DataStreamProtocol:
                 if (DataStreamPeer::acceptsFeatures(features))
-                    return new DataStreamPeer(authHandler, socket, features, level, parent);
+                    return new DataStreamPeer(authHandler, socket, features, level, method, parent);
                 break;
             default:
                 break;
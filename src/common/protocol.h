@@ -33,15 +33,21 @@ const quint32 magic = 0x42b33f00;
 enum Type {
     InternalProtocol = 0x00,
     LegacyProtocol = 0x01,
-    DataStreamProtocol = 0x02
+    DataStreamProtocol = 0x02,
+    BinaryProtocol = 0x03
 };
 
 
 enum Feature {
     Encryption = 0x01,
-    Compression = 0x02
+    Compression = 0x02,
+    Lz4Compression = 0x04,
+    ZstdCompression = 0x08,
+    ZstdDictionaryMask = 0x70  ///< ID of the zstd dictionary, see Compressor::zstdDictionaryId()
 };
 
+const int ZstdDictionaryShift = 4;
+
 
 enum class Handler {
     SignalProxy,
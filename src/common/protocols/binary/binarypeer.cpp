@@ -0,0 +1,518 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "binarypeer.h"
+
+#include <QDataStream>
+#include <QDateTime>
+
+#include "serializers/serializers.h"
+
+using namespace Protocol;
+using Serializers::Types::QuasselType;
+using Serializers::Types::VariantType;
+
+namespace {
+
+// Tags identifying the type of a value on the wire
+const quint32 boxedValueTag = 0;       ///< Followed by a regular, self-describing QVariant
+const quint32 quasselTypeTagBase = 256; ///< Added to Serializers::Types::QuasselType
+
+// 1 to 255 are Serializers::Types::VariantType
+inline quint32 variantTag(VariantType type)
+{
+    return static_cast<quint32>(type);
+}
+
+const int maxInternedNames = 65536;
+const int maxValueDepth = 32;
+
+void writeVarUInt(QDataStream &out, quint64 value)
+{
+    char buf[10];
+    int len = 0;
+    do {
+        quint8 byte = value & 0x7f;
+        value >>= 7;
+        if (value)
+            byte |= 0x80;
+        buf[len++] = byte;
+    } while (value);
+    out.writeRawData(buf, len);
+}
+
+
+bool readVarUInt(QDataStream &in, quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        quint8 byte;
+        in >> byte;
+        if (in.status() != QDataStream::Ok)
+            return false;
+        value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+
+void writeBytes(QDataStream &out, const QByteArray &bytes)
+{
+    writeVarUInt(out, bytes.size());
+    out.writeRawData(bytes.constData(), bytes.size());
+}
+
+
+bool readBytes(QDataStream &in, QByteArray &bytes)
+{
+    quint64 size;
+    if (!readVarUInt(in, size) || size > quint64(in.device()->bytesAvailable()))
+        return false;
+    bytes.resize(size);
+    return in.readRawData(bytes.data(), size) == int(size);
+}
+
+
+// every element takes at least one byte, so we can reject bogus counts early
+bool readCount(QDataStream &in, quint64 &count)
+{
+    return readVarUInt(in, count) && count <= quint64(in.device()->bytesAvailable());
+}
+
+}
+
+BinaryPeer::BinaryPeer(::AuthHandler *authHandler, QTcpSocket *socket, quint16 features, Compressor::CompressionLevel level, Compressor::CompressionMethod method, QObject *parent)
+    : DataStreamPeer(authHandler, socket, features, level, method, parent)
+{
+}
+
+
+quint16 BinaryPeer::supportedFeatures()
+{
+    return 0;
+}
+
+
+bool BinaryPeer::acceptsFeatures(quint16 peerFeatures)
+{
+    Q_UNUSED(peerFeatures);
+    return true;
+}
+
+
+quint16 BinaryPeer::enabledFeatures() const
+{
+    return 0;
+}
+
+
+void BinaryPeer::processMessage(const QByteArray &msg)
+{
+    // the handshake is shared with the DataStream protocol
+    if (!signalProxy()) {
+        DataStreamPeer::processMessage(msg);
+        return;
+    }
+
+    QDataStream in(msg);
+    in.setVersion(QDataStream::Qt_4_2);
+
+    quint8 requestType;
+    in >> requestType;
+
+    bool valid = in.status() == QDataStream::Ok;
+    QByteArray className;
+    QByteArray objectName;
+    switch (requestType) {
+        case Sync: {
+            QByteArray slotName;
+            QVariantList params;
+            valid = valid && readName(in, className) && readName(in, objectName) && readName(in, slotName) && readParams(in, params);
+            if (valid)
+                handle(Protocol::SyncMessage(className, QString::fromUtf8(objectName), slotName, params));
+            break;
+        }
+        case RpcCall: {
+            QByteArray slotName;
+            QVariantList params;
+            valid = valid && readName(in, slotName) && readParams(in, params);
+            if (valid)
+                handle(Protocol::RpcCall(slotName, params));
+            break;
+        }
+        case InitRequest: {
+            valid = valid && readName(in, className) && readName(in, objectName);
+            if (valid)
+                handle(Protocol::InitRequest(className, QString::fromUtf8(objectName)));
+            break;
+        }
+        case InitData: {
+            quint64 count;
+            QVariantMap initData;
+            valid = valid && readName(in, className) && readName(in, objectName) && readCount(in, count);
+            for (quint64 i = 0; valid && i < count; i++) {
+                QByteArray key;
+                QVariant value;
+                valid = readName(in, key) && readValue(in, value);
+                initData[QString::fromUtf8(key)] = value;
+            }
+            if (valid)
+                handle(Protocol::InitData(className, QString::fromUtf8(objectName), initData));
+            break;
+        }
+        case HeartBeat:
+        case HeartBeatReply: {
+            QVariant timestamp;
+            valid = valid && readValue(in, timestamp);
+            if (valid && requestType == HeartBeat)
+                handle(Protocol::HeartBeat(timestamp.toDateTime()));
+            else if (valid)
+                handle(Protocol::HeartBeatReply(timestamp.toDateTime()));
+            break;
+        }
+        default:
+            valid = false;
+    }
+
+    if (!valid)
+        close("Peer sent corrupt data, closing down!");
+}
+
+
+void BinaryPeer::dispatch(const Protocol::SyncMessage &msg)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << (quint8)Sync;
+    writeName(out, msg.className);
+    writeName(out, msg.objectName.toUtf8());
+    writeName(out, msg.slotName);
+    writeParams(out, msg.params);
+
+    writeMessage(data);
+}
+
+
+void BinaryPeer::dispatch(const Protocol::RpcCall &msg)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << (quint8)RpcCall;
+    writeName(out, msg.slotName);
+    writeParams(out, msg.params);
+
+    writeMessage(data);
+}
+
+
+void BinaryPeer::dispatch(const Protocol::InitRequest &msg)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << (quint8)InitRequest;
+    writeName(out, msg.className);
+    writeName(out, msg.objectName.toUtf8());
+
+    writeMessage(data);
+}
+
+
+void BinaryPeer::dispatch(const Protocol::InitData &msg)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << (quint8)InitData;
+    writeName(out, msg.className);
+    writeName(out, msg.objectName.toUtf8());
+    writeVarUInt(out, msg.initData.count());
+    QVariantMap::const_iterator it = msg.initData.begin();
+    while (it != msg.initData.end()) {
+        writeName(out, it.key().toUtf8());
+        writeValue(out, it.value());
+        ++it;
+    }
+
+    writeMessage(data);
+}
+
+
+void BinaryPeer::dispatch(const Protocol::HeartBeat &msg)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << (quint8)HeartBeat;
+    writeValue(out, msg.timestamp);
+
+    writeMessage(data);
+}
+
+
+void BinaryPeer::dispatch(const Protocol::HeartBeatReply &msg)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << (quint8)HeartBeatReply;
+    writeValue(out, msg.timestamp);
+
+    writeMessage(data);
+}
+
+
+/*** Broadcast fan-out ***/
+
+/* Names are interned per connection, but parameters are encoded without any connection state,
+ * so only the message header needs to be written for each peer.
+ */
+QByteArray BinaryPeer::serializationKey() const
+{
+    return "Binary:" + featuresKey();
+}
+
+
+QByteArray BinaryPeer::serializeParams(const QVariantList &params)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    writeParams(out, params);
+    return data;
+}
+
+
+void BinaryPeer::dispatchSerialized(const Protocol::SyncMessage &msg, const QByteArray &serializedParams)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << (quint8)Sync;
+    writeName(out, msg.className);
+    writeName(out, msg.objectName.toUtf8());
+    writeName(out, msg.slotName);
+    data.append(serializedParams);
+
+    writeMessage(data);
+}
+
+
+void BinaryPeer::dispatchSerialized(const Protocol::RpcCall &msg, const QByteArray &serializedParams)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << (quint8)RpcCall;
+    writeName(out, msg.slotName);
+    data.append(serializedParams);
+
+    writeMessage(data);
+}
+
+
+/*** Encoding ***/
+
+/* Names are sent as a varint reference: 0 means the name follows inline and gets the next free id
+ * (as long as the table isn't full), any other value refers to the name with id (value - 1).
+ * Both sides build their tables in the order the names appear on the wire, so no further
+ * synchronization is needed.
+ */
+void BinaryPeer::writeName(QDataStream &out, const QByteArray &name)
+{
+    QHash<QByteArray, quint32>::const_iterator it = _sentNames.constFind(name);
+    if (it != _sentNames.constEnd()) {
+        writeVarUInt(out, it.value() + 1);
+        return;
+    }
+
+    writeVarUInt(out, 0);
+    writeBytes(out, name);
+    if (_sentNames.count() < maxInternedNames)
+        _sentNames.insert(name, _sentNames.count());
+}
+
+
+bool BinaryPeer::readName(QDataStream &in, QByteArray &name)
+{
+    quint64 ref;
+    if (!readVarUInt(in, ref))
+        return false;
+
+    if (ref > 0) {
+        if (ref > quint64(_receivedNames.count()))
+            return false;
+        name = _receivedNames.at(ref - 1);
+        return true;
+    }
+
+    if (!readBytes(in, name))
+        return false;
+    if (_receivedNames.count() < maxInternedNames)
+        _receivedNames << name;
+    return true;
+}
+
+
+quint32 BinaryPeer::valueTag(int typeId)
+{
+    QHash<int, quint32>::const_iterator it = _valueTags.constFind(typeId);
+    if (it != _valueTags.constEnd())
+        return it.value();
+
+    quint32 tag = boxedValueTag;
+    switch (typeId) {
+        case QMetaType::Bool: tag = variantTag(VariantType::Bool); break;
+        case QMetaType::Int: tag = variantTag(VariantType::Int); break;
+        case QMetaType::UInt: tag = variantTag(VariantType::UInt); break;
+        case QMetaType::QChar: tag = variantTag(VariantType::QChar); break;
+        case QMetaType::QString: tag = variantTag(VariantType::QString); break;
+        case QMetaType::QStringList: tag = variantTag(VariantType::QStringList); break;
+        case QMetaType::QByteArray: tag = variantTag(VariantType::QByteArray); break;
+        case QMetaType::QDate: tag = variantTag(VariantType::QDate); break;
+        case QMetaType::QTime: tag = variantTag(VariantType::QTime); break;
+        case QMetaType::QDateTime: tag = variantTag(VariantType::QDateTime); break;
+        case QMetaType::Long: tag = variantTag(VariantType::Long); break;
+        case QMetaType::Short: tag = variantTag(VariantType::Short); break;
+        case QMetaType::Char: tag = variantTag(VariantType::Char); break;
+        case QMetaType::ULong: tag = variantTag(VariantType::ULong); break;
+        case QMetaType::UShort: tag = variantTag(VariantType::UShort); break;
+        case QMetaType::UChar: tag = variantTag(VariantType::UChar); break;
+        default:
+            if (typeId >= QMetaType::User) {
+                QByteArray name = QMetaType::typeName(typeId);
+                QuasselType type = Serializers::Types::fromName(name);
+                if (type != QuasselType::Invalid)
+                    tag = quasselTypeTagBase + static_cast<quint32>(type);
+            }
+    }
+
+    _valueTags[typeId] = tag;
+    return tag;
+}
+
+
+void BinaryPeer::writeValue(QDataStream &out, const QVariant &value)
+{
+    int typeId = value.userType();
+    if (typeId == QMetaType::QVariantList) {
+        const QVariantList &list = *static_cast<const QVariantList *>(value.constData());
+        writeVarUInt(out, variantTag(VariantType::QVariantList));
+        writeParams(out, list);
+        return;
+    }
+    if (typeId == QMetaType::QVariantMap) {
+        const QVariantMap &map = *static_cast<const QVariantMap *>(value.constData());
+        writeVarUInt(out, variantTag(VariantType::QVariantMap));
+        writeVarUInt(out, map.count());
+        QVariantMap::const_iterator it = map.begin();
+        while (it != map.end()) {
+            writeBytes(out, it.key().toUtf8());
+            writeValue(out, it.value());
+            ++it;
+        }
+        return;
+    }
+
+    quint32 tag = valueTag(typeId);
+    writeVarUInt(out, tag);
+    if (tag == boxedValueTag)
+        out << value;
+    else
+        QMetaType::save(out, typeId, value.constData());
+}
+
+
+bool BinaryPeer::readValue(QDataStream &in, QVariant &value, int depth)
+{
+    quint64 tag;
+    if (depth > maxValueDepth || !readVarUInt(in, tag))
+        return false;
+
+    if (tag == boxedValueTag)
+        return Serializers::deserialize(in, features(), value);
+
+    if (tag >= quasselTypeTagBase)
+        return Serializers::deserialize(in, features(), value, static_cast<QuasselType>(tag - quasselTypeTagBase));
+
+    switch (static_cast<VariantType>(tag)) {
+        case VariantType::QVariantList: {
+            quint64 count;
+            if (!readCount(in, count))
+                return false;
+            QVariantList list;
+            list.reserve(count);
+            for (quint64 i = 0; i < count; i++) {
+                QVariant element;
+                if (!readValue(in, element, depth + 1))
+                    return false;
+                list << element;
+            }
+            value = list;
+            return true;
+        }
+        case VariantType::QVariantMap: {
+            quint64 count;
+            if (!readCount(in, count))
+                return false;
+            QVariantMap map;
+            for (quint64 i = 0; i < count; i++) {
+                QByteArray key;
+                QVariant element;
+                if (!readBytes(in, key) || !readValue(in, element, depth + 1))
+                    return false;
+                map[QString::fromUtf8(key)] = element;
+            }
+            value = map;
+            return true;
+        }
+        default:
+            return Serializers::deserialize(in, features(), value, static_cast<VariantType>(tag));
+    }
+}
+
+
+void BinaryPeer::writeParams(QDataStream &out, const QVariantList &params)
+{
+    writeVarUInt(out, params.count());
+    foreach(const QVariant &param, params) {
+        writeValue(out, param);
+    }
+}
+
+
+bool BinaryPeer::readParams(QDataStream &in, QVariantList &params)
+{
+    quint64 count;
+    if (!readCount(in, count))
+        return false;
+    params.reserve(count);
+    for (quint64 i = 0; i < count; i++) {
+        QVariant param;
+        if (!readValue(in, param))
+            return false;
+        params << param;
+    }
+    return true;
+}
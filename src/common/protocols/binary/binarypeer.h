@@ -0,0 +1,84 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+
+#include "../datastream/datastreampeer.h"
+
+/**
+ * Binary, schema-driven variant of the DataStream protocol.
+ *
+ * The handshake is identical to the one of the DataStream protocol. Afterwards, class, object and
+ * slot names as well as the property names of InitData are interned into per-connection numeric ids
+ * the first time they are sent. Parameters are tagged with a compact type id instead of being
+ * boxed into QVariants carrying their type name.
+ */
+class BinaryPeer : public DataStreamPeer
+{
+    Q_OBJECT
+
+public:
+    using DataStreamPeer::dispatch;
+
+    BinaryPeer(AuthHandler *authHandler, QTcpSocket *socket, quint16 features, Compressor::CompressionLevel level, Compressor::CompressionMethod method, QObject *parent = 0);
+
+    Protocol::Type protocol() const { return Protocol::BinaryProtocol; }
+    QString protocolName() const { return "the Binary protocol"; }
+
+    static quint16 supportedFeatures();
+    static bool acceptsFeatures(quint16 peerFeatures);
+    quint16 enabledFeatures() const;
+
+    void dispatch(const Protocol::SyncMessage &msg);
+    void dispatch(const Protocol::RpcCall &msg);
+    void dispatch(const Protocol::InitRequest &msg);
+    void dispatch(const Protocol::InitData &msg);
+
+    void dispatch(const Protocol::HeartBeat &msg);
+    void dispatch(const Protocol::HeartBeatReply &msg);
+
+    QByteArray serializationKey() const;
+    QByteArray serializeParams(const QVariantList &params);
+    void dispatchSerialized(const Protocol::SyncMessage &msg, const QByteArray &serializedParams);
+    void dispatchSerialized(const Protocol::RpcCall &msg, const QByteArray &serializedParams);
+
+protected:
+    void processMessage(const QByteArray &msg);
+
+private:
+    void writeName(QDataStream &out, const QByteArray &name);
+    bool readName(QDataStream &in, QByteArray &name);
+
+    void writeValue(QDataStream &out, const QVariant &value);
+    bool readValue(QDataStream &in, QVariant &value, int depth = 0);
+
+    void writeParams(QDataStream &out, const QVariantList &params);
+    bool readParams(QDataStream &in, QVariantList &params);
+
+    quint32 valueTag(int typeId);
+
+    QHash<QByteArray, quint32> _sentNames;
+    QList<QByteArray> _receivedNames;
+    QHash<int, quint32> _valueTags;
+};
@@ -29,8 +29,8 @@
 
 using namespace Protocol;
 
-DataStreamPeer::DataStreamPeer(::AuthHandler *authHandler, QTcpSocket *socket, quint16 features, Compressor::CompressionLevel level, QObject *parent)
-    : RemotePeer(authHandler, socket, level, parent)
+DataStreamPeer::DataStreamPeer(::AuthHandler *authHandler, QTcpSocket *socket, quint16 features, Compressor::CompressionLevel level, Compressor::CompressionMethod method, QObject *parent)
+    : RemotePeer(authHandler, socket, level, method, parent)
 {
     Q_UNUSED(features);
 }
@@ -429,3 +429,51 @@ void DataStreamPeer::dispatchPackedFunc(const QVariantList &packedFunc)
 {
     writeMessage(packedFunc);
 }
+
+
+/*** Broadcast fan-out ***/
+
+/* A packed function is serialized as a QVariantList, i.e. the element count followed by each element
+ * as a QVariant. The parameters are the trailing elements of that list, one QVariant each, so their
+ * serialization can be shared by all peers that stream variants the same way. Each peer only needs to
+ * write the element count (header fields plus parameters) and the header fields in front of them.
+ */
+QByteArray DataStreamPeer::serializationKey() const
+{
+    return "DataStream:" + featuresKey();
+}
+
+
+QByteArray DataStreamPeer::serializeParams(const QVariantList &params)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    foreach(const QVariant &param, params)
+        out << param;
+    return data;
+}
+
+
+void DataStreamPeer::dispatchSerialized(const Protocol::SyncMessage &msg, const QByteArray &serializedParams)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << (quint32)(4 + msg.params.count()) << QVariant((qint16)Sync) << QVariant(msg.className) << QVariant(msg.objectName.toUtf8()) << QVariant(msg.slotName);
+    data.append(serializedParams);
+
+    writeMessage(data);
+}
+
+
+void DataStreamPeer::dispatchSerialized(const Protocol::RpcCall &msg, const QByteArray &serializedParams)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << (quint32)(2 + msg.params.count()) << QVariant((qint16)RpcCall) << QVariant(msg.slotName);
+    data.append(serializedParams);
+
+    writeMessage(data);
+}
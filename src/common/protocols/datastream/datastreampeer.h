@@ -39,7 +39,7 @@ public:
         HeartBeatReply
     };
 
-    DataStreamPeer(AuthHandler *authHandler, QTcpSocket *socket, quint16 features, Compressor::CompressionLevel level, QObject *parent = 0);
+    DataStreamPeer(AuthHandler *authHandler, QTcpSocket *socket, quint16 features, Compressor::CompressionLevel level, Compressor::CompressionMethod method, QObject *parent = 0);
 
     Protocol::Type protocol() const { return Protocol::DataStreamProtocol; }
     QString protocolName() const { return "the DataStream protocol"; }
@@ -67,16 +67,23 @@ public:
     void dispatch(const Protocol::HeartBeat &msg);
     void dispatch(const Protocol::HeartBeatReply &msg);
 
+    QByteArray serializationKey() const;
+    QByteArray serializeParams(const QVariantList &params);
+    void dispatchSerialized(const Protocol::SyncMessage &msg, const QByteArray &serializedParams);
+    void dispatchSerialized(const Protocol::RpcCall &msg, const QByteArray &serializedParams);
+
 signals:
     void protocolError(const QString &errorString);
 
-private:
+protected:
     using RemotePeer::writeMessage;
     void writeMessage(const QVariantMap &handshakeMsg);
     void writeMessage(const QVariantList &sigProxyMsg);
     void processMessage(const QByteArray &msg);
 
     void handleHandshakeMessage(const QVariantList &mapData);
+
+private:
     void handlePackedFunc(const QVariantList &packedFunc);
     void dispatchPackedFunc(const QVariantList &packedFunc);
 };
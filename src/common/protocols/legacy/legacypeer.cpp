@@ -34,7 +34,7 @@ const uint clientNeedsProtocol = protocolVersion;
 using namespace Protocol;
 
 LegacyPeer::LegacyPeer(::AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, QObject *parent)
-    : RemotePeer(authHandler, socket, level, parent),
+    : RemotePeer(authHandler, socket, level, Compressor::Deflate, parent),
     _useCompression(false)
 {
 
@@ -720,6 +720,14 @@ bool Quassel::Features::isEnabled(Feature feature) const
 }
 
 
+void Quassel::Features::setEnabled(Feature feature, bool enabled)
+{
+    size_t i = static_cast<size_t>(feature);
+    if (i < _features.size())
+        _features[i] = enabled;
+}
+
+
 QStringList Quassel::Features::toStringList(bool enabled) const
 {
     // Check if any feature is enabled
@@ -134,6 +134,12 @@ public:
 #if QT_VERSION >= 0x050500
         EcdsaCertfpKeys,          ///< ECDSA keys for CertFP in identities
 #endif
+        BacklogChunks,            ///< Backlog replies are streamed in bounded chunks
+        BatchedDisplayMsgs,       ///< New messages are sent in batches through displayMsgs()
+        CompactMessages,          ///< Compact encoding for lists of messages
+        BacklogMulti,             ///< Backlog of several buffers can be requested at once
+        BacklogSearch,            ///< Full-text search of the backlog on the core
+        BacklogByTime,            ///< Backlog can be requested by time range and message type
     };
     Q_ENUMS(Feature)
 
@@ -301,6 +307,14 @@ public:
      */
     bool isEnabled(Feature feature) const;
 
+    /**
+     * Marks a given feature as enabled or disabled in this Features instance.
+     *
+     * @param feature The feature to be changed
+     * @param enabled Whether the feature should be enabled
+     */
+    void setEnabled(Feature feature, bool enabled);
+
     /**
      * Provides a list of all features marked as either enabled or disabled (as indicated by the @a enabled argument) as strings.
      *
@@ -35,10 +35,10 @@ using namespace Protocol;
 
 const quint32 maxMessageSize = 64 * 1024 * 1024; // This is uncompressed size. 64 MB should be enough for any sort of initData or backlog chunk
 
-RemotePeer::RemotePeer(::AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, QObject *parent)
+RemotePeer::RemotePeer(::AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, Compressor::CompressionMethod method, QObject *parent)
     : Peer(authHandler, parent),
     _socket(socket),
-    _compressor(new Compressor(socket, level, this)),
+    _compressor(new Compressor(socket, level, method, this)),
     _signalProxy(0),
     _heartBeatTimer(new QTimer(this)),
     _heartBeatCount(0),
@@ -68,6 +68,32 @@ void RemotePeer::onSocketStateChanged(QAbstractSocket::SocketState state)
     if (state == QAbstractSocket::ClosingState) {
         emit statusMessage(tr("Disconnecting..."));
     }
+    else if (state == QAbstractSocket::UnconnectedState) {
+        logWriteStats();
+    }
+}
+
+
+void RemotePeer::logWriteStats() const
+{
+    const Compressor::Stats &stats = _compressor->stats();
+    if (!stats.flushes)
+        return;
+
+    qDebug().nospace() << "Write stats for " << qPrintable(description()) << ": "
+                       << stats.flushes << " flushes, " << stats.coalescedWrites << " coalesced writes, "
+                       << stats.flushesPerSecond << " flushes/s (max " << stats.maxFlushesPerSecond << ")";
+
+    if (_compressor->compressionLevel() == Compressor::NoCompression)
+        return;
+
+    qDebug().nospace() << "Compression stats for " << qPrintable(description()) << " ("
+                       << qPrintable(Compressor::methodName(_compressor->compressionMethod())) << "): "
+                       << "sent " << stats.bytesSent << "/" << stats.bytesWritten << " bytes (ratio "
+                       << (stats.bytesWritten ? (double)stats.bytesSent / stats.bytesWritten : 0.0) << ") in "
+                       << stats.flushes << " flushes, " << stats.compressNsecs / 1000 / (qint64)stats.flushes << " us per flush; "
+                       << "received " << stats.bytesReceived << "/" << stats.bytesRead << " bytes, "
+                       << stats.decompressNsecs / 1000 << " us decompressing";
 }
 
 
@@ -162,6 +188,12 @@ QTcpSocket *RemotePeer::socket() const
 }
 
 
+void RemotePeer::setWriteCoalescing(int latency, int maxBytes)
+{
+    _compressor->setWriteCoalescing(latency, maxBytes);
+}
+
+
 bool RemotePeer::isSecure() const
 {
     if (socket()) {
@@ -200,6 +232,7 @@ void RemotePeer::close(const QString &reason)
     }
 
     if (socket() && socket()->state() != QTcpSocket::UnconnectedState) {
+        _compressor->flush(); // don't lose coalesced messages
         socket()->disconnectFromHost();
     }
 }
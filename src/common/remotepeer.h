@@ -41,7 +41,7 @@ public:
     using Peer::handle;
     using Peer::dispatch;
 
-    RemotePeer(AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, QObject *parent = 0);
+    RemotePeer(AuthHandler *authHandler, QTcpSocket *socket, Compressor::CompressionLevel level, Compressor::CompressionMethod method, QObject *parent = 0);
 
     void setSignalProxy(SignalProxy *proxy);
 
@@ -61,6 +61,9 @@ public:
     bool compressionEnabled() const;
     void setCompressionEnabled(bool enabled);
 
+    //! Collect outgoing messages for up to latency ms before sending them, see Compressor::setWriteCoalescing()
+    void setWriteCoalescing(int latency, int maxBytes);
+
     QTcpSocket *socket() const;
 
 public slots:
@@ -96,6 +99,7 @@ private slots:
 
 private:
     bool readMessage(QByteArray &msg);
+    void logWriteStats() const;
 
 private:
     QTcpSocket *_socket;
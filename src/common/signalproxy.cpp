@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QHostAddress>
 #include <QMetaMethod>
 #include <QMetaProperty>
@@ -156,13 +157,10 @@ int SignalProxy::SignalRelay::qt_metacall(QMetaObject::Call _c, int _id, void **
                 params << QVariant(argTypes[i], _a[i+1]);
             }
 
-            if (proxy()->_restrictMessageTarget) {
-                for (auto peer : proxy()->_restrictedTargets) {
-                    if (peer != nullptr)
-                        proxy()->dispatch(peer, RpcCall(signal.signature, params));
-                }
-            } else
-                proxy()->dispatch(RpcCall(signal.signature, params));
+            if (proxy()->_restrictMessageTarget)
+                proxy()->broadcast(proxy()->_restrictedTargets.toList(), RpcCall(signal.signature, params));
+            else
+                proxy()->broadcast(proxy()->_peerMap.values(), RpcCall(signal.signature, params));
         }
         _id -= _slots.count();
     }
@@ -538,6 +536,62 @@ void SignalProxy::dispatch(Peer *peer, const T &protoMessage)
 }
 
 
+// Only the parameters make up a significant part of the message, so they get serialized once per group
+// of peers with the same serializationKey(); the per-peer part of the message is written by the peer itself.
+template<class T>
+void SignalProxy::broadcast(const QList<Peer *> &peers, const T &protoMessage)
+{
+    if (peers.count() < 2) {
+        for (auto peer : peers) {
+            if (peer)
+                dispatch(peer, protoMessage);
+        }
+        return;
+    }
+
+    struct Serialized {
+        QByteArray params;
+        qint64 nsecs;
+    };
+    QHash<QByteArray, Serialized> serialized;
+    qint64 saved = 0;
+
+    for (auto peer : peers) {
+        if (!peer)
+            continue;
+
+        QByteArray key = peer->isOpen() ? peer->serializationKey() : QByteArray();
+        if (key.isEmpty()) {
+            dispatch(peer, protoMessage); // also takes care of removing closed peers
+            continue;
+        }
+
+        _targetPeer = peer; // serializers may depend on the target's features
+        auto it = serialized.find(key);
+        if (it == serialized.end()) {
+            QElapsedTimer timer;
+            timer.start();
+            Serialized s;
+            s.params = peer->serializeParams(protoMessage.params);
+            s.nsecs = timer.nsecsElapsed();
+            it = serialized.insert(key, s);
+            _broadcastStats.serializations++;
+            _broadcastStats.serializeNsecs += s.nsecs;
+        }
+        else {
+            saved += it->nsecs;
+            _broadcastStats.sharedDispatches++;
+        }
+        peer->dispatchSerialized(protoMessage, it->params);
+        _targetPeer = nullptr;
+    }
+
+    _broadcastStats.broadcasts++;
+    _broadcastStats.savedNsecs += saved;
+    _broadcastStats.lastSavedNsecs = saved;
+}
+
+
 void SignalProxy::handle(Peer *peer, const SyncMessage &syncMessage)
 {
     if (!_syncSlave.contains(syncMessage.className) || !_syncSlave[syncMessage.className].contains(syncMessage.objectName)) {
@@ -566,12 +620,13 @@ void SignalProxy::handle(Peer *peer, const SyncMessage &syncMessage)
     if (returnType != QMetaType::Void)
         returnValue = QVariant(static_cast<QVariant::Type>(returnType));
 
+    _replyDeferred = false;
     if (!invokeSlot(receiver, slotId, syncMessage.params, returnValue, peer)) {
         qWarning("SignalProxy::handleSync(): invokeMethod for \"%s\" failed ", eMeta->methodName(slotId).constData());
         return;
     }
 
-    if (returnValue.type() != QVariant::Invalid && eMeta->receiveMap().contains(slotId)) {
+    if (returnValue.type() != QVariant::Invalid && eMeta->receiveMap().contains(slotId) && !_replyDeferred) {
         int receiverId = eMeta->receiveMap()[slotId];
         QVariantList returnParams;
         if (eMeta->argTypes(receiverId).count() > 1)
@@ -773,13 +828,10 @@ void SignalProxy::sync_call__(const SyncableObject *obj, SignalProxy::ProxyMode
         params << QVariant(argTypes[i], va_arg(ap, void *));
     }
 
-    if (_restrictMessageTarget) {
-        for (auto peer : _restrictedTargets) {
-            if (peer != nullptr)
-                dispatch(peer, SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
-        }
-    } else
-        dispatch(SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
+    if (_restrictMessageTarget)
+        broadcast(_restrictedTargets.toList(), SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
+    else
+        broadcast(_peerMap.values(), SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
 }
 
 
@@ -811,6 +863,10 @@ void SignalProxy::dumpProxyStats()
     qDebug() << "          attached Slots:" << _attachedSlots.count();
     qDebug() << " number of synced Slaves:" << slaveCount;
     qDebug() << "number of Classes cached:" << _extendedMetaObjects.count();
+    qDebug() << "    broadcasts (fan-out):" << _broadcastStats.broadcasts << "serializations:" << _broadcastStats.serializations
+             << "shared:" << _broadcastStats.sharedDispatches;
+    qDebug() << " serialization time saved:" << _broadcastStats.savedNsecs / 1000 << "us total,"
+             << (_broadcastStats.broadcasts ? _broadcastStats.savedNsecs / 1000 / (qint64)_broadcastStats.broadcasts : 0) << "us per broadcast";
 }
 
 
@@ -879,6 +935,10 @@ void SignalProxy::setTargetPeer(Peer *targetPeer) {
     _targetPeer = targetPeer;
 }
 
+void SignalProxy::deferReply() {
+    _replyDeferred = true;
+}
+
 // ==================================================
 //  ExtendedMetaObject
 // ==================================================
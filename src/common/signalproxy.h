@@ -76,7 +76,18 @@ public:
     inline ExtendedMetaObject *extendedMetaObject(const QObject *obj) const { return extendedMetaObject(metaObject(obj)); }
     inline ExtendedMetaObject *createExtendedMetaObject(const QObject *obj, bool checkConflicts = false) { return createExtendedMetaObject(metaObject(obj), checkConflicts); }
 
+    //! Counters for the serialize-once fan-out of broadcast messages
+    struct BroadcastStats {
+        quint64 broadcasts{0};        ///< Messages sent to more than one peer
+        quint64 serializations{0};    ///< Times the parameters of such a message were serialized
+        quint64 sharedDispatches{0};  ///< Dispatches that reused parameters serialized for another peer
+        qint64 serializeNsecs{0};     ///< Time spent serializing parameters
+        qint64 savedNsecs{0};         ///< Serialization time saved by sharing
+        qint64 lastSavedNsecs{0};     ///< Serialization time saved by the last broadcast
+    };
+
     bool isSecure() const { return _secure; }
+    const BroadcastStats &broadcastStats() const { return _broadcastStats; }
     void dumpProxyStats();
     void dumpSyncMap(SyncableObject *object);
 
@@ -108,6 +119,7 @@ public:
     /**}@*/
 
     inline int peerCount() const { return _peerMap.size(); }
+    inline QList<Peer *> peers() const { return _peerMap.values(); }
     QVariantList peerData();
 
     Peer *peerById(int peerId);
@@ -124,6 +136,12 @@ public:
     Peer *targetPeer();
     void setTargetPeer(Peer *targetPeer);
 
+    /**
+     * Suppresses the automatic reply of the sync call that is currently being handled.
+     * The slot is then responsible for sending the reply itself later on.
+     */
+    void deferReply();
+
 public slots:
     void detachObject(QObject *obj);
     void detachSignals(QObject *sender);
@@ -170,6 +188,8 @@ private:
     void dispatch(const T &protoMessage);
     template<class T>
     void dispatch(Peer *peer, const T &protoMessage);
+    template<class T>
+    void broadcast(const QList<Peer *> &peers, const T &protoMessage);
 
     void handle(Peer *peer, const Protocol::SyncMessage &syncMessage);
     void handle(Peer *peer, const Protocol::RpcCall &rpcCall);
@@ -218,6 +238,9 @@ private:
 
     Peer *_sourcePeer = nullptr;
     Peer *_targetPeer = nullptr;
+    bool _replyDeferred = false;
+
+    BroadcastStats _broadcastStats;
 
     thread_local static SignalProxy *_current;
 
@@ -0,0 +1,9 @@
+SELECT CASE WHEN :lastseenmsgid >= buffer.lastmsgid THEN 0
+    ELSE (SELECT count(*)
+          FROM backlog
+          WHERE bufferid = :bufferid
+            AND flags & 3 = 2
+            AND messageid > :lastseenmsgid)
+    END
+FROM buffer
+WHERE buffer.bufferid = :bufferid
@@ -0,0 +1,9 @@
+SELECT messageid, time,  type, flags, sender, senderprefixes, message
+FROM backlog
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE backlog.bufferid = $1
+    AND backlog.time >= $2
+    AND backlog.time < $3
+    AND ($4 = 0 OR backlog.type & $4 != 0)
+ORDER BY backlog.time, backlog.messageid
+LIMIT $5
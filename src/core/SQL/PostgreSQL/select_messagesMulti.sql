@@ -0,0 +1,16 @@
+SELECT backlog.messageid, backlog.time, backlog.type, backlog.flags, sender.sender, backlog.senderprefixes, backlog.message,
+    buffer.bufferid, buffer.networkid, buffer.buffertype, buffer.buffername
+FROM unnest($2::integer[], $3::integer[], $4::integer[]) WITH ORDINALITY AS requested(bufferid, firstmsg, lastmsg, position)
+JOIN buffer ON buffer.bufferid = requested.bufferid AND buffer.userid = $1
+CROSS JOIN LATERAL (
+    SELECT messageid, time, type, flags, senderid, senderprefixes, message
+    FROM backlog
+    WHERE backlog.bufferid = requested.bufferid
+        AND backlog.messageid >= requested.firstmsg
+        AND backlog.messageid < requested.lastmsg
+        AND backlog.messageid <= buffer.lastmsgid
+    ORDER BY backlog.messageid DESC
+    LIMIT $5
+) AS backlog
+JOIN sender ON backlog.senderid = sender.senderid
+ORDER BY requested.position, backlog.messageid DESC
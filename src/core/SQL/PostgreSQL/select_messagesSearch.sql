@@ -0,0 +1,15 @@
+SELECT backlog.messageid, backlog.bufferid, backlog.time, backlog.type, backlog.flags, sender.sender, backlog.senderprefixes, backlog.message
+FROM backlog
+JOIN buffer ON backlog.bufferid = buffer.bufferid
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE to_tsvector('simple', backlog.message) @@ plainto_tsquery('simple', CAST(:query AS text))
+    AND backlog.messageid < :lastmsg
+    AND buffer.userid = :userid
+    AND (:bufferid = -1 OR backlog.bufferid = :bufferid)
+    AND (:networkid = -1 OR buffer.networkid = :networkid)
+    AND (CAST(:sender AS text) = '' OR lower(sender.sender) = CAST(:sender AS text)
+        OR substr(lower(sender.sender), 1, length(CAST(:sender AS text)) + 1) = CAST(:sender AS text) || '!')
+    AND backlog.time >= :fromtime
+    AND backlog.time < :totime
+ORDER BY backlog.messageid DESC
+LIMIT :limit
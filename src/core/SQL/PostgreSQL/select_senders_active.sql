@@ -0,0 +1,6 @@
+SELECT sender.senderid, sender.sender
+FROM sender
+JOIN (SELECT senderid, count(*) AS msgcount
+      FROM (SELECT senderid FROM backlog ORDER BY messageid DESC LIMIT 100000) AS recentbacklog
+      GROUP BY senderid) AS recentsenders ON recentsenders.senderid = sender.senderid
+ORDER BY recentsenders.msgcount DESC
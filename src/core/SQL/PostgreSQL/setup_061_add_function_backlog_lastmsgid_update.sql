@@ -3,7 +3,9 @@ RETURNS trigger
 AS $BODY$
     BEGIN
         UPDATE buffer
-        SET lastmsgid = new.messageid
+        SET lastmsgid = new.messageid,
+            bufferactivity = CASE WHEN new.flags & 1 = 0 THEN buffer.bufferactivity | new.type ELSE buffer.bufferactivity END,
+            highlightcount = CASE WHEN new.flags & 3 = 2 THEN buffer.highlightcount + 1 ELSE buffer.highlightcount END
         WHERE buffer.bufferid = new.bufferid
             AND buffer.lastmsgid < new.messageid;
         RETURN new;
@@ -0,0 +1 @@
+CREATE INDEX backlog_buffer_time_idx ON backlog(bufferid, time, messageid)
@@ -0,0 +1,14 @@
+CREATE OR REPLACE FUNCTION public.backlog_lastmsgid_update()
+RETURNS trigger
+AS $BODY$
+    BEGIN
+        UPDATE buffer
+        SET lastmsgid = new.messageid,
+            bufferactivity = CASE WHEN new.flags & 1 = 0 THEN buffer.bufferactivity | new.type ELSE buffer.bufferactivity END,
+            highlightcount = CASE WHEN new.flags & 3 = 2 THEN buffer.highlightcount + 1 ELSE buffer.highlightcount END
+        WHERE buffer.bufferid = new.bufferid
+            AND buffer.lastmsgid < new.messageid;
+        RETURN new;
+    END
+$BODY$
+LANGUAGE plpgsql;
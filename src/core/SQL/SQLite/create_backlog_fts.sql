@@ -0,0 +1,5 @@
+CREATE VIRTUAL TABLE IF NOT EXISTS backlog_fts USING fts5(
+	message,
+	content = 'backlog',
+	content_rowid = 'messageid'
+)
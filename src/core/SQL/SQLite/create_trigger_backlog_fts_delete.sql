@@ -0,0 +1,8 @@
+CREATE TRIGGER IF NOT EXISTS backlog_fts_trigger_delete
+AFTER DELETE
+ON backlog
+FOR EACH ROW
+    BEGIN
+        INSERT INTO backlog_fts (backlog_fts, rowid, message)
+        VALUES ('delete', old.messageid, old.message);
+    END
@@ -0,0 +1,8 @@
+CREATE TRIGGER IF NOT EXISTS backlog_fts_trigger_insert
+AFTER INSERT
+ON backlog
+FOR EACH ROW
+    BEGIN
+        INSERT INTO backlog_fts (rowid, message)
+        VALUES (new.messageid, new.message);
+    END
@@ -0,0 +1 @@
+DROP TRIGGER IF EXISTS backlog_fts_trigger_delete
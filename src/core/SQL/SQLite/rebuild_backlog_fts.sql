@@ -0,0 +1,2 @@
+INSERT INTO backlog_fts (backlog_fts)
+VALUES ('rebuild')
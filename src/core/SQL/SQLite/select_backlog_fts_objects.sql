@@ -0,0 +1 @@
+SELECT count(*) FROM sqlite_master WHERE (type = 'table' AND name = 'backlog_fts') OR (type = 'trigger' AND name IN ('backlog_fts_trigger_insert', 'backlog_fts_trigger_delete'))
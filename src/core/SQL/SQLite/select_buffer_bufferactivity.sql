@@ -1,7 +1,11 @@
-SELECT COALESCE(SUM(t.type),0)
-FROM
-  (SELECT DISTINCT TYPE
-   FROM backlog
-   WHERE bufferid = :bufferid
-     AND flags & 1 = 0
-     AND messageid > :lastseenmsgid) t;
+SELECT CASE WHEN :lastseenmsgid >= buffer.lastmsgid THEN 0
+    ELSE (SELECT COALESCE(SUM(t.type),0)
+          FROM
+            (SELECT DISTINCT TYPE
+             FROM backlog
+             WHERE bufferid = :bufferid
+               AND flags & 1 = 0
+               AND messageid > :lastseenmsgid) t)
+    END
+FROM buffer
+WHERE buffer.bufferid = :bufferid
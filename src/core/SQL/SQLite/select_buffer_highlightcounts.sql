@@ -0,0 +1,3 @@
+SELECT bufferid, highlightcount
+FROM buffer
+WHERE userid = :userid
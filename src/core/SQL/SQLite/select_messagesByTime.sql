@@ -0,0 +1,9 @@
+SELECT messageid, time,  type, flags, sender, senderprefixes, message
+FROM backlog
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE backlog.bufferid = :bufferid
+    AND backlog.time >= :starttime
+    AND backlog.time < :endtime
+    AND (:types = 0 OR backlog.type & :types != 0)
+ORDER BY backlog.time, backlog.messageid
+LIMIT :limit
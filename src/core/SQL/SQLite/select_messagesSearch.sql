@@ -0,0 +1,15 @@
+SELECT backlog.messageid, backlog.bufferid, backlog.time, backlog.type, backlog.flags, sender.sender, backlog.senderprefixes, backlog.message
+FROM backlog_fts
+JOIN backlog ON backlog.messageid = backlog_fts.rowid
+JOIN buffer ON backlog.bufferid = buffer.bufferid
+JOIN sender ON backlog.senderid = sender.senderid
+WHERE backlog_fts MATCH :query
+    AND backlog_fts.rowid < :lastmsg
+    AND buffer.userid = :userid
+    AND (:bufferid = -1 OR backlog.bufferid = :bufferid)
+    AND (:networkid = -1 OR buffer.networkid = :networkid)
+    AND (:sender = '' OR lower(sender.sender) = :sender OR substr(lower(sender.sender), 1, length(:sender) + 1) = :sender || '!')
+    AND backlog.time >= :fromtime
+    AND backlog.time < :totime
+ORDER BY backlog_fts.rowid DESC
+LIMIT :limit
@@ -4,7 +4,9 @@ ON backlog
 FOR EACH ROW
     BEGIN
         UPDATE buffer
-        SET lastmsgid = new.messageid
+        SET lastmsgid = new.messageid,
+            bufferactivity = CASE WHEN new.flags & 1 = 0 THEN bufferactivity | new.type ELSE bufferactivity END,
+            highlightcount = CASE WHEN new.flags & 3 = 2 THEN highlightcount + 1 ELSE highlightcount END
         WHERE buffer.bufferid = new.bufferid
             AND buffer.lastmsgid < new.messageid;
     END
@@ -1,3 +1,5 @@
 UPDATE buffer
-SET lastseenmsgid = min(:lastseenmsgid, buffer.lastmsgid)
+SET lastseenmsgid = min(:lastseenmsgid, buffer.lastmsgid),
+    bufferactivity = CASE WHEN :lastseenmsgid >= buffer.lastmsgid THEN 0 ELSE bufferactivity END,
+    highlightcount = CASE WHEN :lastseenmsgid >= buffer.lastmsgid THEN 0 ELSE highlightcount END
 WHERE userid = :userid AND bufferid = :bufferid
@@ -0,0 +1,2 @@
+ALTER TABLE buffer
+ADD COLUMN highlightcount integer NOT NULL DEFAULT 0
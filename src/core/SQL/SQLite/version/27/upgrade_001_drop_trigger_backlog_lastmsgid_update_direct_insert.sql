@@ -0,0 +1 @@
+DROP TRIGGER IF EXISTS backlog_lastmsgid_update_trigger_insert
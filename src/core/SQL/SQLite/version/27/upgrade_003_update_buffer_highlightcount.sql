@@ -0,0 +1,8 @@
+UPDATE buffer
+SET highlightcount = (
+    SELECT count(*)
+    FROM backlog
+    WHERE backlog.bufferid = buffer.bufferid
+        AND backlog.messageid > buffer.lastseenmsgid
+        AND backlog.flags & 3 = 2
+)
@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include "abstractsqlstorage.h"
+#include "coresettings.h"
 #include "quassel.h"
 
 #include "logger.h"
@@ -32,7 +33,9 @@
 int AbstractSqlStorage::_nextConnectionId = 0;
 AbstractSqlStorage::AbstractSqlStorage(QObject *parent)
     : Storage(parent),
-    _schemaVersion(0)
+    _schemaVersion(0),
+    _senderCacheHits(0),
+    _senderCacheMisses(0)
 {
 }
 
@@ -103,6 +106,11 @@ void AbstractSqlStorage::addConnectionToPool()
 
 void AbstractSqlStorage::dbConnect(QSqlDatabase &db)
 {
+    // prepared statements don't survive a reconnect
+    Connection *connection = _connectionPool.value(QThread::currentThread());
+    if (connection)
+        connection->preparedQueries().clear();
+
     if (!db.open()) {
         quWarning() << "Unable to open database" << displayName() << "for thread" << QThread::currentThread();
         quWarning() << "-" << db.lastError().text();
@@ -144,13 +152,90 @@ Storage::State AbstractSqlStorage::init(const QVariantMap &settings)
         }
     }
 
+    if (!initOptionalSchema())
+        return NotAvailable;
+
+    prewarmSenderCache();
+
     quInfo() << qPrintable(displayName()) << "storage backend is ready. Schema version:" << installedSchemaVersion();
     return IsReady;
 }
 
 
+QVariantMap AbstractSqlStorage::statistics()
+{
+    QMutexLocker locker(&_senderCacheMutex);
+    quint64 lookups = _senderCacheHits + _senderCacheMisses;
+    QVariantMap senderCache;
+    senderCache["Size"] = _senderCache.size();
+    senderCache["Capacity"] = _senderCache.maxCost();
+    senderCache["Hits"] = _senderCacheHits;
+    senderCache["Misses"] = _senderCacheMisses;
+    senderCache["HitRate"] = lookups ? (double)_senderCacheHits / lookups : 0.0;
+
+    QVariantMap stats;
+    stats["SenderCache"] = senderCache;
+    return stats;
+}
+
+
+int AbstractSqlStorage::cachedSenderId(const QString &sender)
+{
+    QMutexLocker locker(&_senderCacheMutex);
+    int *senderId = _senderCache.object(sender);
+    if (!senderId) {
+        _senderCacheMisses++;
+        return -1;
+    }
+    _senderCacheHits++;
+    return *senderId;
+}
+
+
+void AbstractSqlStorage::cacheSenderIds(const QHash<QString, int> &senderIds)
+{
+    QMutexLocker locker(&_senderCacheMutex);
+    QHash<QString, int>::const_iterator iter;
+    for (iter = senderIds.constBegin(); iter != senderIds.constEnd(); ++iter) {
+        if (iter.value() > 0)
+            _senderCache.insert(iter.key(), new int(iter.value()));
+    }
+}
+
+
+void AbstractSqlStorage::prewarmSenderCache()
+{
+    CoreSettings s;
+    int cacheSize = s.storageCacheSettings().toMap().value("SenderCacheSize", 20000).toInt();
+
+    QMutexLocker locker(&_senderCacheMutex);
+    _senderCache.clear();
+    _senderCache.setMaxCost(qMax(cacheSize, 0));
+    if (cacheSize <= 0)
+        return;
+
+    // only used when there is a singlethread (during startup), so the ordering is stable
+    QSqlQuery query = logDb().exec(queryString("select_senders_active"));
+    if (!watchQuery(query))
+        return;
+
+    while (_senderCache.size() < cacheSize && query.next()) {
+        _senderCache.insert(query.value(1).toString(), new int(query.value(0).toInt()));
+    }
+    quInfo() << qPrintable(displayName()) << "sender cache prewarmed with" << _senderCache.size() << "senders";
+}
+
+
 QString AbstractSqlStorage::queryString(const QString &queryName, int version)
 {
+    // the current schema's queries are requested over and over again, so keep them around
+    if (version == 0) {
+        QMutexLocker locker(&_queryStringMutex);
+        QHash<QString, QString>::const_iterator iter = _queryStrings.constFind(queryName);
+        if (iter != _queryStrings.constEnd())
+            return iter.value();
+    }
+
     QFileInfo queryInfo;
 
     // The current schema is stored in the root folder, while upgrade queries are stored in the
@@ -173,10 +258,37 @@ QString AbstractSqlStorage::queryString(const QString &queryName, int version)
     QFile queryFile(queryInfo.filePath());
     if (!queryFile.open(QIODevice::ReadOnly | QIODevice::Text))
         return QString();
-    QString query = QTextStream(&queryFile).readAll();
+    QString query = QTextStream(&queryFile).readAll().trimmed();
     queryFile.close();
 
-    return query.trimmed();
+    if (version == 0) {
+        QMutexLocker locker(&_queryStringMutex);
+        _queryStrings[queryName] = query;
+    }
+    return query;
+}
+
+
+QSqlQuery AbstractSqlStorage::cachedQuery(const QString &queryName, QSqlDatabase &db)
+{
+    Connection *connection = _connectionPool.value(QThread::currentThread());
+    if (!connection) {
+        QSqlQuery query(db);
+        query.prepare(queryString(queryName));
+        return query;
+    }
+
+    QHash<QString, QSqlQuery> &preparedQueries = connection->preparedQueries();
+    QHash<QString, QSqlQuery>::iterator iter = preparedQueries.find(queryName);
+    if (iter == preparedQueries.end()) {
+        QSqlQuery query(db);
+        if (!query.prepare(queryString(queryName))) {
+            // don't cache broken statements, the error is reported when executing
+            return query;
+        }
+        iter = preparedQueries.insert(queryName, query);
+    }
+    return iter.value();
 }
 
 
@@ -345,6 +457,8 @@ AbstractSqlStorage::Connection::Connection(const QString &name, QObject *parent)
 
 AbstractSqlStorage::Connection::~Connection()
 {
+    // the statements have to be released before the connection is removed
+    _preparedQueries.clear();
     {
         QSqlDatabase db = QSqlDatabase::database(name(), false);
         if (db.isOpen()) {
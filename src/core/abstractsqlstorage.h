@@ -24,6 +24,8 @@
 
 #include <memory>
 
+#include <QCache>
+#include <QMutex>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
@@ -46,9 +48,32 @@ public slots:
     virtual State init(const QVariantMap &settings = QVariantMap());
     virtual bool setup(const QVariantMap &settings = QVariantMap());
 
+    QVariantMap statistics() override;
+
 protected:
     inline virtual void sync() {};
 
+    /**
+     * Look up a sender in the process-wide sender cache
+     *
+     * @param[in] sender  The sender as stored in the sender table
+     * @return The sender's id, or -1 if the sender isn't cached
+     */
+    int cachedSenderId(const QString &sender);
+
+    /**
+     * Add senders to the sender cache
+     *
+     * Only pass senders whose rows have been committed already, as the cache is shared by all
+     * connections and never validated against the database.
+     *
+     * @param[in] senderIds  Map of sender to sender id
+     */
+    void cacheSenderIds(const QHash<QString, int> &senderIds);
+
+    //! Fill the sender cache with the senders most active in the recent backlog
+    void prewarmSenderCache();
+
     QSqlDatabase logDb();
 
     /**
@@ -70,6 +95,22 @@ protected:
      */
     QString queryString(const QString &queryName, int version = 0);
 
+    /**
+     * Fetch a prepared query for the current thread's database connection
+     *
+     * The query is prepared on first use and kept for the lifetime of the connection, so the SQL
+     * text doesn't have to be parsed again for every execution. The returned object shares its
+     * statement with the cache, so bound values have to be set anew for every use.
+     *
+     * @note SELECT queries must either be read until the end or finish()ed before the storage
+     * lock is released, otherwise the statement keeps the database locked.
+     *
+     * @param[in] queryName  File name of the SQL query, minus the .sql extension
+     * @param[in] db         The database connection of the current thread, as returned by logDb()
+     * @return The prepared query, ready for binding values
+     */
+    QSqlQuery cachedQuery(const QString &queryName, QSqlDatabase &db);
+
     QStringList setupQueries();
 
     QStringList upgradeQueries(int ver);
@@ -99,6 +140,14 @@ protected:
      */
     inline virtual bool initDbSession(QSqlDatabase & /* db */) { return true; }
 
+    //! Create or remove the parts of the schema that depend on optional features of the database
+    /** These are kept out of the versioned schema, as the features available may change between
+     *  runs on the same database. Called by init() once the schema is up to date, so it has to
+     *  cope with any state left behind by a previous run. The default implementation does nothing.
+     *  \return false if the database can't be used as it is
+     */
+    inline virtual bool initOptionalSchema() { return true; }
+
 private slots:
     void connectionDestroyed();
 
@@ -109,6 +158,14 @@ private:
     int _schemaVersion;
     bool _debug;
 
+    QMutex _senderCacheMutex;
+    QCache<QString, int> _senderCache;
+    quint64 _senderCacheHits;
+    quint64 _senderCacheMisses;
+
+    QMutex _queryStringMutex;
+    QHash<QString, QString> _queryStrings;
+
     static int _nextConnectionId;
     QMutex _connectionPoolMutex;
     // we let a Connection Object manage each actual db connection
@@ -131,9 +188,11 @@ public:
     ~Connection();
 
     inline QLatin1String name() const { return QLatin1String(_name); }
+    inline QHash<QString, QSqlQuery> &preparedQueries() { return _preparedQueries; }
 
 private:
     QByteArray _name;
+    QHash<QString, QSqlQuery> _preparedQueries;
 };
 
 
@@ -234,6 +293,7 @@ public:
         int lastseenmsgid;
         int markerlinemsgid;
         int bufferactivity;
+        int highlightcount;
         QString key;
         bool joined;
     };
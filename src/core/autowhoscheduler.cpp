@@ -0,0 +1,112 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "autowhoscheduler.h"
+
+#include "corenetwork.h"
+#include "corenetworkconfig.h"
+
+namespace {
+
+const int tickInterval = 1000;       // ms
+const double budgetPerSecond = 50;   // users per network
+const double maxBudget = 1000;       // users per network
+const int maxWhosPerTick = 2;        // for the whole session
+
+}
+
+AutoWhoScheduler::AutoWhoScheduler(QObject *parent)
+    : QObject(parent)
+{
+    _clock.start();
+    _timer.setInterval(tickInterval);
+    connect(&_timer, SIGNAL(timeout()), SLOT(tick()));
+}
+
+
+void AutoWhoScheduler::setEnabled(CoreNetwork *network, bool enabled)
+{
+    int idx = indexOf(network);
+    if (enabled && idx == -1) {
+        NetworkState state;
+        state.network = network;
+        state.budget = maxBudget;
+        state.lastWho = _clock.elapsed(); // wait for the AutoWho delay before the first poll
+        _networks << state;
+        if (!_timer.isActive()) {
+            _lastTick = _clock.elapsed();
+            _timer.start();
+        }
+    }
+    else if (!enabled && idx != -1) {
+        _networks.removeAt(idx);
+        if (_networks.isEmpty())
+            _timer.stop();
+    }
+}
+
+
+int AutoWhoScheduler::indexOf(CoreNetwork *network) const
+{
+    for (int i = 0; i < _networks.count(); i++) {
+        if (_networks.at(i).network == network)
+            return i;
+    }
+    return -1;
+}
+
+
+void AutoWhoScheduler::tick()
+{
+    qint64 now = _clock.elapsed();
+    double refill = (now - _lastTick) * budgetPerSecond / 1000;
+    _lastTick = now;
+
+    int sent = 0;
+    QList<NetworkState> served;
+    QList<NetworkState>::iterator it = _networks.begin();
+    while (it != _networks.end()) {
+        CoreNetwork *network = it->network;
+        if (!network) {
+            it = _networks.erase(it);
+            continue;
+        }
+
+        it->budget = qMin(maxBudget, it->budget + refill);
+        if (sent < maxWhosPerTick && it->budget > 0
+            && now - it->lastWho >= network->networkConfig()->autoWhoDelay() * 1000) {
+            int cost = network->sendAutoWho();
+            if (cost > 0) {
+                it->budget -= cost;
+                it->lastWho = now;
+                sent++;
+                served << *it;
+                it = _networks.erase(it);
+                continue;
+            }
+        }
+        ++it;
+    }
+    // networks that just got their turn go to the back of the line
+    _networks << served;
+
+    if (_networks.isEmpty())
+        _timer.stop();
+}
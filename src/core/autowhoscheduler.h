@@ -0,0 +1,69 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+
+class CoreNetwork;
+
+/**
+ * Schedules the AutoWho polls of all networks of a session.
+ *
+ * Rather than every network running its own timer, networks with AutoWho enabled register with
+ * the session's scheduler, which hands out WHO requests round-robin. Each network has a budget
+ * of users it may poll: a WHO costs one unit per channel member, and the budget refills at a
+ * fixed rate. That keeps large channels from flooding the core with replies, while small
+ * channels and single nicks still get polled promptly. The per-network AutoWho delay still
+ * applies between two polls of the same network.
+ */
+class AutoWhoScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    AutoWhoScheduler(QObject *parent = 0);
+
+    //! Start or stop scheduling polls for the given network
+    void setEnabled(CoreNetwork *network, bool enabled);
+
+    inline bool isEnabled(CoreNetwork *network) const { return indexOf(network) != -1; }
+
+private slots:
+    void tick();
+
+private:
+    struct NetworkState {
+        QPointer<CoreNetwork> network;
+        double budget;   ///< Number of users this network may poll right now
+        qint64 lastWho;  ///< Time of the last poll, in ms on the scheduler's clock
+    };
+
+    int indexOf(CoreNetwork *network) const;
+
+    QList<NetworkState> _networks;  ///< In round-robin order
+    QTimer _timer;
+    QElapsedTimer _clock;
+    qint64 _lastTick{0};
+};
@@ -0,0 +1,288 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "backlogcache.h"
+
+#include "core.h"
+#include "coresettings.h"
+
+BacklogCache::BacklogCache(UserId user)
+    : _user(user)
+{
+    CoreSettings s;
+    QVariantMap settings = s.storageCacheSettings().toMap();
+    _bufferSize = qMax(settings.value("BacklogCacheSize", 500).toInt(), 0);
+    _maxMemory = settings.value("BacklogCacheMemory", 16).toLongLong() * 1024 * 1024;
+}
+
+
+MessageList BacklogCache::requestMsgs(BufferId bufferId, MsgId first, MsgId last, int limit)
+{
+    if (!_bufferSize)
+        return Core::requestMsgs(_user, bufferId, first, last, limit);
+
+    QHash<BufferId, Ring>::iterator it = _rings.find(bufferId);
+    if (it == _rings.end())
+        it = load(bufferId);
+
+    MessageList result;
+    if (lookup(*it, first, last, limit, result)) {
+        it->lastUsed = ++_useCounter;
+        _stats.hits++;
+        return result;
+    }
+
+    it->lastUsed = ++_useCounter;
+    _stats.misses++;
+    return Core::requestMsgs(_user, bufferId, first, last, limit);
+}
+
+
+bool BacklogCache::cachedMsgs(BufferId bufferId, MsgId first, MsgId last, int limit, MessageList &result)
+{
+    QHash<BufferId, Ring>::iterator it = _rings.find(bufferId);
+    if (it == _rings.end())
+        return false;
+
+    it->lastUsed = ++_useCounter;
+    MessageList msgs;
+    if (!lookup(*it, first, last, limit, msgs)) {
+        _stats.misses++;
+        return false;
+    }
+
+    _stats.hits++;
+    result << msgs;
+    return true;
+}
+
+
+MessageList BacklogCache::requestMsgsMulti(const BufferIdList &bufferIds, const QList<MsgId> &first, const QList<MsgId> &last, int limit)
+{
+    if (!_bufferSize)
+        return Core::requestMsgsMulti(_user, bufferIds, first, last, limit);
+
+    MessageList result;
+    BufferIdList uncachedBuffers;
+    QList<MsgId> uncachedFirst;
+    QList<MsgId> uncachedLast;
+    for (int i = 0; i < bufferIds.count(); i++) {
+        MsgId firstId = first.value(i, -1);
+        MsgId lastId = last.value(i, -1);
+        if (!_rings.contains(bufferIds.at(i)))
+            _stats.misses++;
+        else if (cachedMsgs(bufferIds.at(i), firstId, lastId, limit, result))
+            continue;
+
+        uncachedBuffers << bufferIds.at(i);
+        uncachedFirst << firstId;
+        uncachedLast << lastId;
+    }
+    if (uncachedBuffers.isEmpty())
+        return result;
+
+    MessageList msgs = Core::requestMsgsMulti(_user, uncachedBuffers, uncachedFirst, uncachedLast, limit);
+    result << msgs;
+
+    // the storage returns the messages grouped by buffer, newest first
+    QHash<BufferId, MessageList> msgsByBuffer;
+    foreach(const Message &msg, msgs) {
+        msgsByBuffer[msg.bufferId()] << msg;
+    }
+
+    // without an upper bound, the result holds the newest messages of a buffer, just like load() would
+    for (int i = 0; i < uncachedBuffers.count(); i++) {
+        if (uncachedLast.at(i) != -1 || _rings.contains(uncachedBuffers.at(i)))
+            continue;
+
+        const MessageList &bufferMsgs = msgsByBuffer[uncachedBuffers.at(i)];
+        bool complete = uncachedFirst.at(i) == -1 && (limit < 0 || bufferMsgs.count() < limit);
+        // a ring that holds less than the configured size would miss on most later requests
+        if (complete || bufferMsgs.count() >= _bufferSize)
+            seed(uncachedBuffers.at(i), bufferMsgs, complete);
+    }
+    if (_stats.memory > _maxMemory)
+        evict(BufferId());
+
+    return result;
+}
+
+
+void BacklogCache::addMessages(const MessageList &messages)
+{
+    foreach(const Message &msg, messages) {
+        if (!msg.msgId().isValid())
+            continue;
+
+        // we only keep buffers up to date that have been requested before; the others are loaded on demand
+        QHash<BufferId, Ring>::iterator it = _rings.find(msg.bufferId());
+        if (it == _rings.end())
+            continue;
+
+        // the ring may have been loaded after this message was stored already
+        if (!it->messages.isEmpty() && msg.msgId() <= it->messages.last().msgId())
+            continue;
+
+        it->messages << msg;
+        it->memory += messageMemory(msg);
+        _stats.memory += messageMemory(msg);
+        trim(*it);
+    }
+    if (_stats.memory > _maxMemory)
+        evict(BufferId());
+}
+
+
+void BacklogCache::invalidate(BufferId bufferId)
+{
+    QHash<BufferId, Ring>::iterator it = _rings.find(bufferId);
+    if (it == _rings.end())
+        return;
+
+    _stats.memory -= it->memory;
+    _rings.erase(it);
+}
+
+
+BacklogCache::Stats BacklogCache::stats() const
+{
+    Stats stats = _stats;
+    stats.buffers = _rings.count();
+    return stats;
+}
+
+
+QVariantMap BacklogCache::statsMap() const
+{
+    Stats s = stats();
+    QVariantMap map;
+    map["Hits"] = s.hits;
+    map["Misses"] = s.misses;
+    map["Loads"] = s.loads;
+    map["Evictions"] = s.evictions;
+    map["Buffers"] = s.buffers;
+    map["Memory"] = s.memory;
+    return map;
+}
+
+
+QHash<BufferId, BacklogCache::Ring>::iterator BacklogCache::load(BufferId bufferId)
+{
+    // the storage returns the newest messages first
+    MessageList msgs = Core::requestMsgs(_user, bufferId, -1, -1, _bufferSize);
+    seed(bufferId, msgs, msgs.count() < _bufferSize);
+
+    QHash<BufferId, Ring>::iterator it = _rings.find(bufferId);
+    if (_stats.memory > _maxMemory) {
+        evict(bufferId);
+        it = _rings.find(bufferId);
+    }
+    return it;
+}
+
+
+// msgs are the newest messages of the buffer, newest first
+void BacklogCache::seed(BufferId bufferId, const MessageList &msgs, bool complete)
+{
+    _stats.loads++;
+
+    Ring ring;
+    ring.complete = complete;
+    ring.lastUsed = ++_useCounter;
+    int count = qMin(msgs.count(), _bufferSize);
+    if (count < msgs.count())
+        ring.complete = false;
+    ring.messages.reserve(count);
+    for (int i = count - 1; i >= 0; i--) {
+        ring.messages << msgs.at(i);
+        ring.memory += messageMemory(msgs.at(i));
+    }
+    _stats.memory += ring.memory;
+    _rings.insert(bufferId, ring);
+}
+
+
+// Storage semantics: messages with first <= msgId < last (no upper bound if last is -1, no lower bound
+// if first is -1), newest first, at most limit of them (no limit if negative)
+bool BacklogCache::lookup(const Ring &ring, MsgId first, MsgId last, int limit, MessageList &result) const
+{
+    if (limit == 0)
+        return true;
+
+    const MessageList &msgs = ring.messages;
+    int i = msgs.count() - 1;
+    if (last != -1) {
+        while (i >= 0 && msgs.at(i).msgId() >= last)
+            --i;
+    }
+
+    for (; i >= 0; --i) {
+        const Message &msg = msgs.at(i);
+        if (first != -1 && msg.msgId() < first)
+            return true; // we have seen everything in range
+        result << msg;
+        if (limit > 0 && result.count() >= limit)
+            return true;
+    }
+
+    // we ran out of cached messages, so we only know the answer if there can't be any older matches
+    if (ring.complete || (first != -1 && !msgs.isEmpty() && msgs.first().msgId() == first))
+        return true;
+
+    result.clear();
+    return false;
+}
+
+
+void BacklogCache::trim(Ring &ring)
+{
+    while (ring.messages.count() > _bufferSize) {
+        qint64 memory = messageMemory(ring.messages.first());
+        ring.memory -= memory;
+        _stats.memory -= memory;
+        ring.messages.removeFirst();
+        ring.complete = false;
+    }
+}
+
+
+void BacklogCache::evict(BufferId keep)
+{
+    while (_stats.memory > _maxMemory && _rings.count() > (_rings.contains(keep) ? 1 : 0)) {
+        QHash<BufferId, Ring>::iterator oldest = _rings.end();
+        for (QHash<BufferId, Ring>::iterator it = _rings.begin(); it != _rings.end(); ++it) {
+            if (it.key() != keep && (oldest == _rings.end() || it->lastUsed < oldest->lastUsed))
+                oldest = it;
+        }
+        if (oldest == _rings.end())
+            break;
+
+        _stats.memory -= oldest->memory;
+        _stats.evictions++;
+        _rings.erase(oldest);
+    }
+}
+
+
+qint64 BacklogCache::messageMemory(const Message &msg)
+{
+    // rough estimate including the container and string overhead
+    return sizeof(Message) + 3 * 32 + (msg.contents().size() + msg.sender().size() + msg.senderPrefixes().size()) * sizeof(QChar);
+}
@@ -0,0 +1,104 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QVariantMap>
+
+#include "message.h"
+#include "types.h"
+
+/**
+ * In-memory cache of the most recent messages of a session's buffers.
+ *
+ * For each buffer that has been requested, the newest messages are kept in a ring of bounded size,
+ * which is kept up to date with newly stored messages. Backlog requests that can be answered from
+ * a ring don't touch the database at all. The total memory used by the rings of a user is capped;
+ * once exceeded, the least recently requested buffers are dropped.
+ */
+class BacklogCache
+{
+public:
+    struct Stats {
+        quint64 hits{0};       ///< Requests served from memory
+        quint64 misses{0};     ///< Requests that had to go to the database
+        quint64 loads{0};      ///< Rings filled from the database
+        quint64 evictions{0};  ///< Rings dropped to stay within the memory cap
+        int buffers{0};        ///< Buffers currently cached
+        qint64 memory{0};      ///< Estimated memory used by the cached messages, in bytes
+    };
+
+    /**
+     * The number of messages kept per buffer and the memory cap are read from the core settings
+     * ("BacklogCacheSize" and "BacklogCacheMemory" in StorageCacheSettings, the latter in MB).
+     * A size of 0 disables the cache.
+     *
+     * @param user The user owning the buffers
+     */
+    BacklogCache(UserId user);
+
+    //! Get messages for a buffer, with the same semantics as Core::requestMsgs()
+    MessageList requestMsgs(BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1);
+
+    //! Like requestMsgs(), but only answers from buffers already in memory and never touches the database
+    /** \return true if the messages could be served from memory
+     */
+    bool cachedMsgs(BufferId bufferId, MsgId first, MsgId last, int limit, MessageList &result);
+
+    //! Get messages for several buffers, with the same semantics as Core::requestMsgsMulti()
+    /** Buffers already in memory are answered from there, the others with a single query. Their
+     *  rings are filled from that query's result where it holds the newest messages of a buffer.
+     */
+    MessageList requestMsgsMulti(const BufferIdList &bufferIds, const QList<MsgId> &first, const QList<MsgId> &last, int limit);
+
+    //! Add newly stored messages to the buffers we cache
+    void addMessages(const MessageList &messages);
+
+    //! Drop the cached messages of a buffer, must be called when a buffer is renamed, merged or removed
+    void invalidate(BufferId bufferId);
+
+    Stats stats() const;
+    QVariantMap statsMap() const;
+
+private:
+    struct Ring {
+        MessageList messages;   // ascending by MsgId; holds all messages of the buffer newer than the first one
+        bool complete{false};   // whether there are no older messages than the ones we hold
+        qint64 memory{0};
+        quint64 lastUsed{0};
+    };
+
+    QHash<BufferId, Ring>::iterator load(BufferId bufferId);
+    void seed(BufferId bufferId, const MessageList &msgs, bool complete);
+    bool lookup(const Ring &ring, MsgId first, MsgId last, int limit, MessageList &result) const;
+    void trim(Ring &ring);
+    void evict(BufferId keep);
+
+    static qint64 messageMemory(const Message &msg);
+
+    UserId _user;
+    int _bufferSize;
+    qint64 _maxMemory;
+
+    QHash<BufferId, Ring> _rings;
+    quint64 _useCounter{0};
+    Stats _stats;
+};
@@ -252,6 +252,8 @@ Core::~Core()
         handler->deleteLater(); // disconnect non authed clients
     }
     qDeleteAll(_sessions);
+    // flush what the sessions left behind while the storage backend is still around
+    _storageWriter.reset();
 }
 
 
@@ -424,15 +426,38 @@ bool Core::initStorage(const QString &backend, const QVariantMap &settings, bool
                 this, SIGNAL(bufferInfoUpdated(UserId, const BufferInfo &)));
         break;
     }
+    // the writer thread may still be flushing into the old backend
+    _storageWriter.reset();
     _storage = std::move(storage);
+    initStorageWriter();
     return true;
 }
 
 
+void Core::initStorageWriter()
+{
+    _storageWriter.reset();
+    if (!_storage)
+        return;
+
+    CoreSettings s;
+    QVariantMap settings = s.storageWriterSettings().toMap();
+    _storageWriter.reset(new StorageWriter(_storage.get(),
+                                           settings.value("FlushInterval", 50).toInt(),
+                                           settings.value("MaxBatchSize", 500).toInt(),
+                                           settings.value("MaxQueueSize", 10000).toInt()));
+    _storageWriter->start();
+}
+
+
 void Core::syncStorage()
 {
-    if (_storage)
+    if (_storage) {
         _storage->sync();
+        qDebug() << "Storage statistics:" << _storage->statistics();
+    }
+    if (_storageWriter)
+        qDebug() << "Storage writer statistics:" << _storageWriter->statsMap();
 }
 
 
@@ -734,6 +759,12 @@ void Core::setupClientSession(RemotePeer *peer, UserId uid)
     // Find or create session for validated user
     sessionForUser(uid);
 
+    // Coalesce the messages sent within one event loop iteration (or FlushLatency ms) into a single
+    // write; negative values disable this
+    CoreSettings s;
+    QVariantMap settings = s.connectionSettings().toMap();
+    peer->setWriteCoalescing(settings.value("FlushLatency", 0).toInt(), settings.value("MaxFlushBytes", 64 * 1024).toInt());
+
     // as we are currently handling an event triggered by incoming data on this socket
     // it is unsafe to directly move the socket to the client thread.
     QCoreApplication::postEvent(this, new AddClientEvent(peer, uid));
@@ -777,6 +808,7 @@ void Core::setupInternalClientSession(InternalPeer *clientPeer)
     InternalPeer *corePeer = new InternalPeer(this);
     corePeer->setPeer(clientPeer);
     clientPeer->setPeer(corePeer);
+    clientPeer->setFeatures(features());
 
     // Find or create session for validated user
     SessionThread *sessionThread = sessionForUser(uid);
@@ -802,6 +834,18 @@ void Core::socketError(QAbstractSocket::SocketError err, const QString &errorStr
 }
 
 
+Quassel::Features Core::features()
+{
+    Quassel::Features features;
+    // without a usable storage, we can't tell yet
+    if (!isSearchAvailable())
+        features.setEnabled(Quassel::Feature::BacklogSearch, false);
+    if (!isMultiBacklogAvailable())
+        features.setEnabled(Quassel::Feature::BacklogMulti, false);
+    return features;
+}
+
+
 QVariantList Core::backendInfo()
 {
     instance()->registerStorageBackends();
@@ -903,6 +947,7 @@ bool Core::selectBackend(const QString &backend)
     auto writer = getMigrationWriter(storage.get());
     if (reader && writer) {
         qDebug() << qPrintable(tr("Migrating storage backend %1 to %2...").arg(_storage->displayName(), storage->displayName()));
+        _storageWriter.reset();
         _storage.reset();
         storage.reset();
         if (reader->migrateTo(writer.get())) {
@@ -930,7 +975,9 @@ bool Core::selectBackend(const QString &backend)
     }
 
     // so we were unable to merge, but let's create a user \o/
+    _storageWriter.reset();
     _storage = std::move(storage);
+    initStorageWriter();
     createUser();
     return true;
 }
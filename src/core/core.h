@@ -41,8 +41,10 @@
 #include "deferredptr.h"
 #include "message.h"
 #include "oidentdconfiggenerator.h"
+#include "quassel.h"
 #include "sessionthread.h"
 #include "storage.h"
+#include "storagewriter.h"
 #include "types.h"
 
 class CoreAuthHandler;
@@ -389,6 +391,42 @@ public:
     }
 
 
+    //! Queue a list of Messages for storage by the storage writer thread.
+    /** The messages are written together with the messages of other sessions in a single
+     *  transaction. Once stored, \p member of \p receiver is invoked (queued) with the messages,
+     *  which then carry their unique Id.
+     *  \note This method is threadsafe.
+     *
+     *  \param messages The list message objects to be stored
+     *  \param receiver The object the stored messages are handed back to
+     *  \param member   The name of the receiver's slot, taking a MessageList
+     */
+    static inline void storeMessagesAsync(const MessageList &messages, QObject *receiver, const char *member)
+    {
+        if (instance()->_storageWriter) {
+            instance()->_storageWriter->enqueue(messages, receiver, member);
+            return;
+        }
+
+        // without a storage writer, we store the messages ourselves, but still hand them back queued
+        if (messages.isEmpty())
+            return;
+        MessageList msgs = messages;
+        storeMessages(msgs);
+        QMetaObject::invokeMethod(receiver, member, Qt::QueuedConnection, Q_ARG(MessageList, msgs));
+    }
+
+
+    //! Forget about pending storeMessagesAsync() results for the given receiver.
+    /** \note This method is threadsafe.
+     */
+    static inline void cancelStoreMessages(QObject *receiver)
+    {
+        if (instance()->_storageWriter)
+            instance()->_storageWriter->dropReceiver(receiver);
+    }
+
+
     //! Request a certain number messages stored in a given buffer.
     /** \param buffer   The buffer we request messages from
      *  \param first    if != -1 return only messages with a MsgId >= first
@@ -402,6 +440,33 @@ public:
     }
 
 
+    //! Request messages stored in several buffers at once.
+    /** \param bufferIds The buffers we request messages from
+     *  \param first     The first MsgId for each buffer, as in requestMsgs()
+     *  \param last      The last MsgId for each buffer, as in requestMsgs()
+     *  \param limit     if != -1 limit the returned list to a max of \limit entries per buffer
+     *  \return The requested messages, grouped by buffer and newest first within each buffer
+     */
+    static inline QList<Message> requestMsgsMulti(UserId user, const QList<BufferId> &bufferIds, const QList<MsgId> &first, const QList<MsgId> &last, int limit = -1)
+    {
+        return instance()->_storage->requestMsgsMulti(user, bufferIds, first, last, limit);
+    }
+
+
+    //! Request the messages of a buffer sent in a given time range
+    /** \param bufferId The buffer we request messages from
+     *  \param start    if valid return only messages sent at or after start
+     *  \param end      if valid return only messages sent before end
+     *  \param types    if != 0 return only messages of these types
+     *  \param limit    if != -1 limit the returned list to a max of \limit entries
+     *  \return The requested messages, oldest first; if limited, the ones closest to start
+     */
+    static inline QList<Message> requestMsgsByTime(UserId user, BufferId bufferId, const QDateTime &start, const QDateTime &end, Message::Types types = 0, int limit = -1)
+    {
+        return instance()->_storage->requestMsgsByTime(user, bufferId, start, end, types, limit);
+    }
+
+
     //! Request a certain number of messages across all buffers
     /** \param first    if != -1 return only messages with a MsgId >= first
      *  \param last     if != -1 return only messages with a MsgId < last
@@ -414,6 +479,37 @@ public:
     }
 
 
+    //! Whether the storage backend supports requestMsgsMulti()
+    static inline bool isMultiBacklogAvailable()
+    {
+        return instance()->_storage && instance()->_storage->isMultiBacklogAvailable();
+    }
+
+
+    //! Whether the storage backend supports searchMsgs()
+    static inline bool isSearchAvailable()
+    {
+        return instance()->_storage && instance()->_storage->isSearchAvailable();
+    }
+
+
+    //! Search all messages of a user
+    /** \param text      The text to search for, all of its words have to appear in a message
+     *  \param bufferId  if valid, only search this buffer
+     *  \param networkId if valid, only search the buffers of this network
+     *  \param sender    if not empty, only return messages sent by this nick
+     *  \param from      if valid, only return messages sent at or after this time
+     *  \param to        if valid, only return messages sent before this time
+     *  \param last      if != -1 return only messages with a MsgId < last, to page through the results
+     *  \param limit     if != -1 limit the returned list to a max of \limit entries
+     *  \return The matching messages, newest first
+     */
+    static inline QList<Message> searchMsgs(UserId user, const QString &text, BufferId bufferId, NetworkId networkId, const QString &sender, const QDateTime &from, const QDateTime &to, MsgId last = -1, int limit = -1)
+    {
+        return instance()->_storage->searchMsgs(user, text, bufferId, networkId, sender, from, to, last, limit);
+    }
+
+
     //! Request a list of all buffers known to a user.
     /** This method is used to get a list of all buffers we have stored a backlog from.
      *  \note This method is threadsafe.
@@ -579,6 +675,39 @@ public:
         return instance()->_storage->bufferActivity(bufferId, lastSeenMsgId);
     }
 
+    //! Update the highlight count for a Buffer
+    /** This Method is used to make the number of unread highlights of a Buffer persistent
+     *  \note This method is threadsafe.
+     *
+     * \param user      The Owner of that Buffer
+     * \param bufferId  The buffer id
+     * \param count     The number of unread highlights
+     */
+    static inline void setHighlightCount(UserId user, BufferId bufferId, int count) {
+        return instance()->_storage->setHighlightCount(user, bufferId, count);
+    }
+
+    //! Get a Hash of all highlight counts
+    /** This Method is called when the Quassel Core is started to restore the highlight counts
+     *  \note This method is threadsafe.
+     *
+     * \param user      The Owner of the buffers
+     */
+    static inline QHash<BufferId, int> highlightCounts(UserId user) {
+        return instance()->_storage->highlightCounts(user);
+    }
+
+    //! Get the number of unread highlights for a buffer
+    /** This method is used to load the highlight count of a buffer when its last seen message changes.
+     *  \note This method is threadsafe.
+     *
+     * \param bufferId The buffer
+     * \param lastSeenMsgId     The last seen message
+     */
+    static inline int highlightCount(BufferId bufferId, MsgId lastSeenMsgId) {
+        return instance()->_storage->highlightCount(bufferId, lastSeenMsgId);
+    }
+
     static inline QDateTime startTime() { return instance()->_startTime; }
     static inline bool isConfigured() { return instance()->_configured; }
     static bool sslSupported();
@@ -593,6 +722,10 @@ public:
     static void cacheSysIdent();
 
     static QVariantList backendInfo();
+
+    //! The features supported by this core, as announced to clients
+    /** Some features depend on the storage backend, so this must only be called once the storage is set up. */
+    static Quassel::Features features();
     static QVariantList authenticatorInfo();
 
     static QString setup(const QString &adminUser, const QString &adminPassword, const QString &backend, const QVariantMap &setupData, const QString &authenticator, const QVariantMap &authSetupMap);
@@ -660,6 +793,8 @@ private:
     DeferredSharedPtr<Storage>       storageBackend(const QString& backendId) const;
     DeferredSharedPtr<Authenticator> authenticator(const QString& authenticatorId) const;
 
+    void initStorageWriter();
+
     bool selectBackend(const QString &backend);
     bool selectAuthenticator(const QString &backend);
 
@@ -674,6 +809,7 @@ private:
     QHash<UserId, SessionThread *> _sessions;
     DeferredSharedPtr<Storage>       _storage;        ///< Active storage backend
     DeferredSharedPtr<Authenticator> _authenticator;  ///< Active authenticator
+    std::unique_ptr<StorageWriter>   _storageWriter;  ///< Batches message inserts for all sessions
     QTimer _storageSyncTimer;
     QMap<UserId, QString> _authUserNames;
 
@@ -20,6 +20,8 @@
 
 #include "coreauthhandler.h"
 
+#include <QHostAddress>
+
 #ifdef HAVE_SSL
 #  include <QSslSocket>
 #endif
@@ -29,6 +31,27 @@
 
 using namespace Protocol;
 
+namespace {
+
+// Loopback and private networks. Dual-stack sockets report IPv4 peers as IPv4-mapped IPv6 addresses, so those are
+// listed as well; QHostAddress::isLoopback() and toIPv4Address(bool *) would need Qt 5.6 and 5.5, respectively.
+bool isLocalAddress(const QHostAddress &address)
+{
+    static const char *localSubnets[] = {
+        "127.0.0.0/8", "10.0.0.0/8", "172.16.0.0/12", "192.168.0.0/16",
+        "::ffff:127.0.0.0/104", "::ffff:10.0.0.0/104", "::ffff:172.16.0.0/108", "::ffff:192.168.0.0/112",
+        "::1/128", "fc00::/7", "fe80::/10"
+    };
+
+    for (const char *subnet : localSubnets) {
+        if (address.isInSubnet(QHostAddress::parseSubnet(subnet)))
+            return true;
+    }
+    return false;
+}
+
+}
+
 CoreAuthHandler::CoreAuthHandler(QTcpSocket *socket, QObject *parent)
     : AuthHandler(parent),
     _peer(0),
@@ -63,7 +86,7 @@ void CoreAuthHandler::onReadyRead()
             // no magic, assume legacy protocol
             qDebug() << "Legacy client detected, switching to compatibility mode";
             _legacy = true;
-            RemotePeer *peer = PeerFactory::createPeer(PeerFactory::ProtoDescriptor(Protocol::LegacyProtocol, 0), this, socket(), Compressor::NoCompression, this);
+            RemotePeer *peer = PeerFactory::createPeer(PeerFactory::ProtoDescriptor(Protocol::LegacyProtocol, 0), this, socket(), Compressor::NoCompression, Compressor::Deflate, this);
             connect(peer, SIGNAL(protocolVersionMismatch(int,int)), SLOT(onProtocolVersionMismatch(int,int)));
             setPeer(peer);
             return;
@@ -74,8 +97,10 @@ void CoreAuthHandler::onReadyRead()
         // figure out which connection features we'll use based on the client's support
         if (Core::sslSupported() && (features & Protocol::Encryption))
             _connectionFeatures |= Protocol::Encryption;
-        if (features & Protocol::Compression)
+        if (features & Protocol::Compression) {
             _connectionFeatures |= Protocol::Compression;
+            _connectionFeatures |= selectCompressionMethod(features);
+        }
 
         socket()->read((char*)&magic, 4); // read the 4 bytes we've just peeked at
     }
@@ -97,7 +122,13 @@ void CoreAuthHandler::onReadyRead()
             else
                 level = Compressor::NoCompression;
 
-            RemotePeer *peer = PeerFactory::createPeer(_supportedProtos, this, socket(), level, this);
+            Compressor::CompressionMethod method = Compressor::Deflate;
+            if (_connectionFeatures & Protocol::ZstdCompression)
+                method = Compressor::Zstd;
+            else if (_connectionFeatures & Protocol::Lz4Compression)
+                method = Compressor::Lz4;
+
+            RemotePeer *peer = PeerFactory::createPeer(_supportedProtos, this, socket(), level, method, this);
             if (!peer) {
                 qWarning() << "Received invalid handshake data from client" << socket()->peerAddress().toString();
                 close();
@@ -156,6 +187,30 @@ bool CoreAuthHandler::checkClientRegistered()
 }
 
 
+quint8 CoreAuthHandler::selectCompressionMethod(quint8 clientFeatures) const
+{
+    bool lz4 = (clientFeatures & Protocol::Lz4Compression) && Compressor::isMethodSupported(Compressor::Lz4);
+    bool zstd = (clientFeatures & Protocol::ZstdCompression) && Compressor::isMethodSupported(Compressor::Zstd);
+
+    // zstd streams are primed with a dictionary, so both sides need to have the same one
+    quint8 zstdDictionary = (Compressor::zstdDictionaryId() << Protocol::ZstdDictionaryShift) & Protocol::ZstdDictionaryMask;
+    if (zstd && (clientFeatures & Protocol::ZstdDictionaryMask) != zstdDictionary) {
+        qDebug() << "Client uses a different zstd dictionary, not offering zstd compression";
+        zstd = false;
+    }
+
+    // On fast links, the CPU time spent compressing matters more than the bandwidth saved, so prefer LZ4 there
+    if (lz4 && isLocalAddress(socket()->peerAddress()))
+        return Protocol::Lz4Compression;
+
+    if (zstd)
+        return Protocol::ZstdCompression | zstdDictionary;
+    if (lz4)
+        return Protocol::Lz4Compression;
+    return 0;
+}
+
+
 void CoreAuthHandler::handle(const RegisterClient &msg)
 {
     bool useSsl;
@@ -185,7 +240,7 @@ void CoreAuthHandler::handle(const RegisterClient &msg)
         }
     }
 
-    _peer->dispatch(ClientRegistered(Quassel::Features{}, configured, backends, authenticators, useSsl));
+    _peer->dispatch(ClientRegistered(Core::features(), configured, backends, authenticators, useSsl));
 
     // useSsl is only used for the legacy protocol
     if (_legacy && useSsl)
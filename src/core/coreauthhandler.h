@@ -48,6 +48,10 @@ private:
 
     bool checkClientRegistered();
 
+    //! Picks the compression method to use from the ones offered by the client
+    /** \return The connection feature bits of the chosen method (for zstd, including the dictionary ID), or 0 for plain deflate */
+    quint8 selectCompressionMethod(quint8 clientFeatures) const;
+
 private slots:
     void onReadyRead();
 
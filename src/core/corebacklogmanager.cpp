@@ -21,22 +21,46 @@
 #include "corebacklogmanager.h"
 #include "core.h"
 #include "coresession.h"
+#include "peer.h"
+#include "signalproxy.h"
 
 #include <QDebug>
 
+namespace {
+
+// Maximum number of messages sent in one part of a streamed backlog reply
+const int backlogChunkSize = 500;
+
+// Upper bound for the number of messages fetched by one query of a multi-buffer request
+const int multiBacklogQuerySize = 20000;
+
+// Maximum number of results returned for one search request
+const int maxSearchResults = 500;
+
+// Maximum number of messages returned for one time range request
+const int maxTimeRangeResults = 500;
+
+}
+
 INIT_SYNCABLE_OBJECT(CoreBacklogManager)
 CoreBacklogManager::CoreBacklogManager(CoreSession *coreSession)
     : BacklogManager(coreSession),
     _coreSession(coreSession)
 {
+    _streamTimer.setInterval(0);
+    connect(&_streamTimer, SIGNAL(timeout()), this, SLOT(continueStreams()));
 }
 
 
 QVariantList CoreBacklogManager::requestBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
 {
+    Peer *peer = SignalProxy::current() ? SignalProxy::current()->sourcePeer() : nullptr;
+    if (peer && peer->hasFeature(Quassel::Feature::BacklogChunks))
+        return requestBacklogStreamed(peer, bufferId, first, last, limit, additional);
+
     QVariantList backlog;
     QList<Message> msgList;
-    msgList = Core::requestMsgs(coreSession()->user(), bufferId, first, last, limit);
+    msgList = coreSession()->backlogCache()->requestMsgs(bufferId, first, last, limit);
 
     QList<Message>::const_iterator msgIter = msgList.constBegin();
     QList<Message>::const_iterator msgListEnd = msgList.constEnd();
@@ -64,7 +88,7 @@ QVariantList CoreBacklogManager::requestBacklog(BufferId bufferId, MsgId first,
         // only fetch additional messages if they continue seemlessly
         // that is, if the list of messages is not truncated by the limit
         if (last == oldestMessage) {
-            msgList = Core::requestMsgs(coreSession()->user(), bufferId, -1, last, additional);
+            msgList = coreSession()->backlogCache()->requestMsgs(bufferId, -1, last, additional);
             msgIter = msgList.constBegin();
             msgListEnd = msgList.constEnd();
             while (msgIter != msgListEnd) {
@@ -80,6 +104,10 @@ QVariantList CoreBacklogManager::requestBacklog(BufferId bufferId, MsgId first,
 
 QVariantList CoreBacklogManager::requestBacklogAll(MsgId first, MsgId last, int limit, int additional)
 {
+    Peer *peer = SignalProxy::current() ? SignalProxy::current()->sourcePeer() : nullptr;
+    if (peer && peer->hasFeature(Quassel::Feature::BacklogChunks))
+        return requestBacklogAllStreamed(peer, first, last, limit, additional);
+
     QVariantList backlog;
     QList<Message> msgList;
     msgList = Core::requestAllMsgs(coreSession()->user(), first, last, limit);
@@ -115,3 +143,298 @@ QVariantList CoreBacklogManager::requestBacklogAll(MsgId first, MsgId last, int
 
     return backlog;
 }
+
+
+void CoreBacklogManager::startStream(Peer *peer, const FetchFunction &fetch, const SendFunction &send, MsgId first, MsgId last, int limit, int additional, bool seamless)
+{
+    BacklogStream stream;
+    stream.peer = peer;
+    stream.fetch = fetch;
+    stream.send = send;
+    stream.first = first;
+    stream.last = last;
+    stream.limit = limit;
+    stream.fetched = 0;
+    stream.oldestMessage = -1;
+    stream.requestFirst = first;
+    stream.additional = additional;
+    stream.seamless = seamless;
+    startStream(stream);
+}
+
+
+void CoreBacklogManager::startStream(Peer *peer, const StepFunction &step, const SendFunction &send)
+{
+    BacklogStream stream;
+    stream.peer = peer;
+    stream.step = step;
+    stream.send = send;
+    startStream(stream);
+}
+
+
+void CoreBacklogManager::startStream(const BacklogStream &stream)
+{
+    _streams << stream;
+
+    // the reply is sent once the stream is complete
+    coreSession()->signalProxy()->deferReply();
+    if (!_streamTimer.isActive())
+        _streamTimer.start();
+}
+
+
+void CoreBacklogManager::continueStreams()
+{
+    // one chunk per stream and iteration, so several clients requesting backlog are served alternately
+    QList<BacklogStream>::iterator it = _streams.begin();
+    while (it != _streams.end()) {
+        if (!it->peer || advanceStream(*it))
+            it = _streams.erase(it);
+        else
+            ++it;
+    }
+
+    if (_streams.isEmpty())
+        _streamTimer.stop();
+}
+
+
+bool CoreBacklogManager::advanceStream(BacklogStream &stream)
+{
+    if (stream.step) {
+        MessageList msgList;
+        bool done = stream.step(msgList);
+        foreach(const Message &msg, msgList) {
+            if (stream.chunk.count() >= backlogChunkSize) {
+                stream.send(stream.chunk, false);
+                stream.chunk.clear();
+            }
+            stream.chunk << msg;
+        }
+        if (done)
+            stream.send(stream.chunk, true);
+        return done;
+    }
+
+    bool phaseDone = stream.limit >= 0 && stream.fetched >= stream.limit;
+    if (!phaseDone) {
+        int count = stream.limit < 0 ? backlogChunkSize : qMin(backlogChunkSize, stream.limit - stream.fetched);
+        MessageList msgList = stream.fetch(stream.first, stream.last, count);
+        if (!msgList.isEmpty()) {
+            if (stream.chunk.count() >= backlogChunkSize) {
+                stream.send(stream.chunk, false);
+                stream.chunk.clear();
+            }
+
+            stream.chunk << msgList;
+            stream.fetched += msgList.count();
+
+            // continue below the oldest message of this page
+            if (msgList.first().msgId() < msgList.last().msgId())
+                stream.oldestMessage = msgList.first().msgId();
+            else
+                stream.oldestMessage = msgList.last().msgId();
+            stream.last = stream.oldestMessage;
+        }
+        phaseDone = msgList.count() < count;
+    }
+    if (!phaseDone)
+        return false;
+
+    if (stream.additional && (!stream.seamless || stream.limit != 0)) {
+        MsgId oldestMessage = stream.oldestMessage;
+        if (stream.seamless && oldestMessage == -1)
+            oldestMessage = stream.requestFirst;
+        MsgId additionalLast = stream.requestFirst != -1 ? stream.requestFirst : oldestMessage;
+
+        // only fetch additional messages if they continue seemlessly
+        // that is, if the list of messages is not truncated by the limit
+        if (!stream.seamless || additionalLast == oldestMessage) {
+            stream.first = -1;
+            stream.last = additionalLast;
+            stream.limit = stream.additional;
+            stream.fetched = 0;
+            stream.oldestMessage = -1;
+            stream.additional = 0;
+            return false;
+        }
+    }
+
+    // the final chunk is the reply to the request and marks the end of the stream
+    stream.send(stream.chunk, true);
+    return true;
+}
+
+
+QVariantList CoreBacklogManager::requestBacklogStreamed(Peer *peer, BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
+{
+    BacklogCache *cache = coreSession()->backlogCache();
+    FetchFunction fetch = [cache, bufferId](MsgId from, MsgId to, int count) {
+        return cache->requestMsgs(bufferId, from, to, count);
+    };
+    QPointer<Peer> target = peer;
+    SendFunction send = [this, target, bufferId, first, last, limit, additional](const MessageList &msgList, bool final) {
+        QVariantList msgs = messagesToVariantList(msgList, target);
+        coreSession()->signalProxy()->restrictTargetPeers(target.data(), [&]{
+            if (final)
+                SYNC_OTHER(receiveBacklog, ARG(bufferId), ARG(first), ARG(last), ARG(limit), ARG(additional), ARG(msgs))
+            else
+                SYNC_OTHER(receiveBacklogPart, ARG(bufferId), ARG(first), ARG(last), ARG(limit), ARG(additional), ARG(msgs))
+        });
+    };
+
+    startStream(peer, fetch, send, first, last, limit, additional, true);
+    return QVariantList();
+}
+
+
+QVariantList CoreBacklogManager::requestBacklogAllStreamed(Peer *peer, MsgId first, MsgId last, int limit, int additional)
+{
+    UserId user = coreSession()->user();
+    FetchFunction fetch = [user](MsgId from, MsgId to, int count) {
+        return Core::requestAllMsgs(user, from, to, count);
+    };
+    QPointer<Peer> target = peer;
+    SendFunction send = [this, target, first, last, limit, additional](const MessageList &msgList, bool final) {
+        QVariantList msgs = messagesToVariantList(msgList, target);
+        coreSession()->signalProxy()->restrictTargetPeers(target.data(), [&]{
+            if (final)
+                SYNC_OTHER(receiveBacklogAll, ARG(first), ARG(last), ARG(limit), ARG(additional), ARG(msgs))
+            else
+                SYNC_OTHER(receiveBacklogAllPart, ARG(first), ARG(last), ARG(limit), ARG(additional), ARG(msgs))
+        });
+    };
+
+    startStream(peer, fetch, send, first, last, limit, additional, false);
+    return QVariantList();
+}
+
+
+QVariantList CoreBacklogManager::requestBacklogMulti(QVariantList bufferIds, QVariantList first, int limit, int additional)
+{
+    Peer *peer = SignalProxy::current() ? SignalProxy::current()->sourcePeer() : nullptr;
+
+    // not advertised in this case, but older clients may still ask
+    if (!Core::isMultiBacklogAvailable())
+        return QVariantList();
+
+    // an unlimited request for many buffers at once is exactly what this is meant to avoid
+    if (limit <= 0) {
+        if (limit < 0)
+            qWarning() << "CoreBacklogManager::requestBacklogMulti(): rejecting request without limit for" << bufferIds.count() << "buffers";
+        return QVariantList();
+    }
+    int additionalLimit = qMax(additional, 0);
+
+    BufferIdList buffers;
+    QList<MsgId> firstIds;
+    QHash<BufferId, int> bufferIndex;
+    for (int i = 0; i < bufferIds.count(); i++) {
+        buffers << bufferIds.at(i).value<BufferId>();
+        firstIds << (i < first.count() ? first.at(i).value<MsgId>() : MsgId(-1));
+        bufferIndex.insert(buffers.last(), i);
+    }
+
+    // one group of buffers per step keeps the amount of messages held at once bounded
+    int groupSize = qMax(1, multiBacklogQuerySize / qMax(limit, additionalLimit));
+    int start = 0;
+    StepFunction step = [this, buffers, firstIds, limit, additionalLimit, groupSize, start](MessageList &msgs) mutable {
+        BufferIdList groupBuffers = buffers.mid(start, groupSize);
+        QList<MsgId> groupFirst = firstIds.mid(start, groupSize);
+        start += groupSize;
+
+        BacklogCache *cache = coreSession()->backlogCache();
+        MessageList msgList = cache->requestMsgsMulti(groupBuffers, groupFirst, QList<MsgId>(), limit);
+        msgs << msgList;
+        if (!additionalLimit)
+            return start >= buffers.count();
+
+        QHash<BufferId, MsgId> oldestMessages;
+        foreach(const Message &msg, msgList) {
+            MsgId &oldest = oldestMessages[msg.bufferId()];
+            if (!oldest.isValid() || msg.msgId() < oldest)
+                oldest = msg.msgId();
+        }
+
+        // only fetch additional messages if they continue seemlessly, as in requestBacklog()
+        BufferIdList additionalBuffers;
+        QList<MsgId> additionalLast;
+        for (int i = 0; i < groupBuffers.count(); i++) {
+            MsgId oldestMessage = oldestMessages.value(groupBuffers.at(i), groupFirst.at(i));
+            MsgId last = groupFirst.at(i) != -1 ? groupFirst.at(i) : oldestMessage;
+            if (last == oldestMessage) {
+                additionalBuffers << groupBuffers.at(i);
+                additionalLast << last;
+            }
+        }
+        if (!additionalBuffers.isEmpty())
+            msgs << cache->requestMsgsMulti(additionalBuffers, QList<MsgId>(), additionalLast, additionalLimit);
+        return start >= buffers.count();
+    };
+
+    QPointer<Peer> target = peer;
+    SendFunction send = [this, target, bufferIds, first, bufferIndex, limit, additional](const MessageList &msgList, bool final) {
+        QVariantList msgs = messagesToVariantList(msgList, target);
+        if (final) {
+            coreSession()->signalProxy()->restrictTargetPeers(target.data(), [&]{
+                SYNC_OTHER(receiveBacklogMulti, ARG(bufferIds), ARG(first), ARG(limit), ARG(additional), ARG(msgs))
+            });
+            return;
+        }
+
+        // only name the buffers this part has messages of, the final reply covers all of them
+        QVariantList partBufferIds;
+        QVariantList partFirst;
+        QSet<BufferId> seen;
+        foreach(const Message &msg, msgList) {
+            if (seen.contains(msg.bufferId()))
+                continue;
+            seen.insert(msg.bufferId());
+            int i = bufferIndex.value(msg.bufferId());
+            partBufferIds << bufferIds.at(i);
+            if (i < first.count())
+                partFirst << first.at(i);
+        }
+        coreSession()->signalProxy()->restrictTargetPeers(target.data(), [&]{
+            SYNC_OTHER(receiveBacklogMultiPart, ARG(partBufferIds), ARG(partFirst), ARG(limit), ARG(additional), ARG(msgs))
+        });
+    };
+
+    startStream(peer, step, send);
+    return QVariantList();
+}
+
+
+QVariantList CoreBacklogManager::requestBacklogByTime(BufferId bufferId, QDateTime start, QDateTime end, int types, int limit)
+{
+    Peer *peer = SignalProxy::current() ? SignalProxy::current()->sourcePeer() : nullptr;
+
+    if (limit < 0 || limit > maxTimeRangeResults)
+        limit = maxTimeRangeResults;
+
+    MessageList msgList = Core::requestMsgsByTime(coreSession()->user(), bufferId, start, end, Message::Types(types), limit);
+    return messagesToVariantList(msgList, peer);
+}
+
+
+QVariantList CoreBacklogManager::requestSearch(QString text, QVariantMap filter, MsgId last, int limit)
+{
+    Peer *peer = SignalProxy::current() ? SignalProxy::current()->sourcePeer() : nullptr;
+
+    // not advertised in this case, but older clients may still ask
+    if (!Core::isSearchAvailable())
+        return QVariantList();
+
+    if (limit < 0 || limit > maxSearchResults)
+        limit = maxSearchResults;
+
+    MessageList msgList = Core::searchMsgs(coreSession()->user(), text,
+                                           filter.value("BufferId").value<BufferId>(),
+                                           filter.value("NetworkId").value<NetworkId>(),
+                                           filter.value("Sender").toString(),
+                                           filter.value("From").toDateTime(),
+                                           filter.value("To").toDateTime(),
+                                           last, limit);
+    return messagesToVariantList(msgList, peer);
+}
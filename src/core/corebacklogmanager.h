@@ -21,9 +21,16 @@
 #ifndef COREBACKLOGMANAGER_H
 #define COREBACKLOGMANAGER_H
 
+#include <functional>
+
+#include <QPointer>
+#include <QTimer>
+
 #include "backlogmanager.h"
+#include "message.h"
 
 class CoreSession;
+class Peer;
 
 class CoreBacklogManager : public BacklogManager
 {
@@ -38,9 +45,56 @@ public:
 public slots:
     virtual QVariantList requestBacklog(BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
     virtual QVariantList requestBacklogAll(MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
+    virtual QVariantList requestBacklogMulti(QVariantList bufferIds, QVariantList first, int limit = -1, int additional = 0);
+    virtual QVariantList requestBacklogByTime(BufferId bufferId, QDateTime start, QDateTime end, int types = 0, int limit = -1);
+    virtual QVariantList requestSearch(QString text, QVariantMap filter, MsgId last = -1, int limit = -1);
+
+private slots:
+    //! Produces the next chunk of each running backlog stream
+    void continueStreams();
 
 private:
+    typedef std::function<MessageList(MsgId, MsgId, int)> FetchFunction;
+    typedef std::function<bool(MessageList &)> StepFunction;
+    typedef std::function<void(const MessageList &, bool)> SendFunction;
+
+    //! State of a streamed backlog reply
+    /** The backlog between first and last is paged through newest messages first, one chunk per
+     *  iteration of the event loop. Whenever a full chunk is followed by more messages, it is sent
+     *  as a part; the last (partial) chunk is sent as the reply and marks the end of the stream.
+     *  Streams that aren't a simple range have a step function instead, which appends the messages
+     *  of the next iteration and tells whether it was the last one.
+     */
+    struct BacklogStream {
+        QPointer<Peer> peer;
+        FetchFunction fetch;
+        StepFunction step;       ///< If set, produces the messages instead of fetch
+        SendFunction send;       ///< Sends a chunk, either as a part or as the final reply
+        MsgId first;
+        MsgId last;
+        int limit{-1};
+        int fetched{0};
+        MsgId oldestMessage;     ///< Oldest MsgId seen in the current phase, -1 if none
+        MsgId requestFirst;      ///< first as given in the request
+        int additional{0};       ///< Messages to fetch below the requested range, 0 once they are being fetched
+        bool seamless{false};    ///< Fetch additional messages only if they continue the requested range
+        MessageList chunk;
+    };
+
+    void startStream(Peer *peer, const FetchFunction &fetch, const SendFunction &send, MsgId first, MsgId last, int limit, int additional, bool seamless);
+    void startStream(Peer *peer, const StepFunction &step, const SendFunction &send);
+    void startStream(const BacklogStream &stream);
+
+    //! Fetches and sends the next chunk of a stream
+    /** \return true if the stream is complete */
+    bool advanceStream(BacklogStream &stream);
+
+    QVariantList requestBacklogStreamed(Peer *peer, BufferId bufferId, MsgId first, MsgId last, int limit, int additional);
+    QVariantList requestBacklogAllStreamed(Peer *peer, MsgId first, MsgId last, int limit, int additional);
+
     CoreSession *_coreSession;
+    QList<BacklogStream> _streams;
+    QTimer _streamTimer;
 };
 
 
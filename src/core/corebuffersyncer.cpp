@@ -34,7 +34,7 @@ public:
 
 INIT_SYNCABLE_OBJECT(CoreBufferSyncer)
 CoreBufferSyncer::CoreBufferSyncer(CoreSession *parent)
-    : BufferSyncer(Core::bufferLastSeenMsgIds(parent->user()), Core::bufferMarkerLineMsgIds(parent->user()), Core::bufferActivities(parent->user()), parent),
+    : BufferSyncer(Core::bufferLastSeenMsgIds(parent->user()), Core::bufferMarkerLineMsgIds(parent->user()), Core::bufferActivities(parent->user()), Core::highlightCounts(parent->user()), parent),
     _coreSession(parent),
     _purgeBuffers(false)
 {
@@ -47,7 +47,9 @@ void CoreBufferSyncer::requestSetLastSeenMsg(BufferId buffer, const MsgId &msgId
     if (setLastSeenMsg(buffer, msgId)) {
         int activity = Core::bufferActivity(buffer, msgId);
         setBufferActivity(buffer, activity);
+        setHighlightCount(buffer, Core::highlightCount(buffer, msgId));
         dirtyLastSeenBuffers << buffer;
+        dirtyHighlightCounts << buffer;
     }
 }
 
@@ -79,9 +81,15 @@ void CoreBufferSyncer::storeDirtyIds()
         Core::setBufferActivity(userId, bufferId, activity(bufferId));
     }
 
+    // after the last seen messages, as storing those may reset the highlight count
+    foreach(BufferId bufferId, dirtyHighlightCounts) {
+        Core::setHighlightCount(userId, bufferId, highlightCount(bufferId));
+    }
+
     dirtyLastSeenBuffers.clear();
     dirtyMarkerLineBuffers.clear();
     dirtyActivities.clear();
+    dirtyHighlightCounts.clear();
 }
 
 
@@ -110,8 +118,11 @@ void CoreBufferSyncer::removeBuffer(BufferId bufferId)
             return;
         }
     }
-    if (Core::removeBuffer(_coreSession->user(), bufferId))
+    if (Core::removeBuffer(_coreSession->user(), bufferId)) {
+        _coreSession->invalidateBufferInfo(bufferId);
+        _coreSession->backlogCache()->invalidate(bufferId);
         BufferSyncer::removeBuffer(bufferId);
+    }
 }
 
 
@@ -128,8 +139,11 @@ void CoreBufferSyncer::renameBuffer(BufferId bufferId, QString newName)
         return;
     }
 
-    if (Core::renameBuffer(_coreSession->user(), bufferId, newName))
+    if (Core::renameBuffer(_coreSession->user(), bufferId, newName)) {
+        _coreSession->invalidateBufferInfo(bufferId);
+        _coreSession->backlogCache()->invalidate(bufferId);
         BufferSyncer::renameBuffer(bufferId, newName);
+    }
 }
 
 
@@ -149,6 +163,9 @@ void CoreBufferSyncer::mergeBuffersPermanently(BufferId bufferId1, BufferId buff
     }
 
     if (Core::mergeBuffersPermanently(_coreSession->user(), bufferId1, bufferId2)) {
+        _coreSession->invalidateBufferInfo(bufferId2);
+        _coreSession->backlogCache()->invalidate(bufferId1);
+        _coreSession->backlogCache()->invalidate(bufferId2);
         BufferSyncer::mergeBuffersPermanently(bufferId1, bufferId2);
     }
 }
@@ -45,6 +45,10 @@ public slots:
         if (!oldActivity.testFlag(message.type())) {
             setBufferActivity(message.bufferId(), (int) (oldActivity | message.type()));
         }
+        // the storage counts stored highlights itself, so this doesn't need to be marked dirty
+        if (message.flags().testFlag(Message::Highlight) && !message.flags().testFlag(Message::Self)) {
+            setHighlightCount(message.bufferId(), highlightCount(message.bufferId()) + 1);
+        }
     }
 
     void setBufferActivity(BufferId buffer, int activity) override;
@@ -60,6 +64,8 @@ public slots:
     inline void requestMarkBufferAsRead(BufferId buffer) override {
         int activity = Message::Types();
         setBufferActivity(buffer, activity);
+        setHighlightCount(buffer, 0);
+        dirtyHighlightCounts << buffer;
         markBufferAsRead(buffer);
     }
 
@@ -75,6 +81,7 @@ private:
     QSet<BufferId> dirtyLastSeenBuffers;
     QSet<BufferId> dirtyMarkerLineBuffers;
     QSet<BufferId> dirtyActivities;
+    QSet<BufferId> dirtyHighlightCounts;
 
     void purgeBufferIds();
 };
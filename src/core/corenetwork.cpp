@@ -18,10 +18,14 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
  ***************************************************************************/
 
+#include <algorithm>
+
 #include <QHostInfo>
+#include <QTextBoundaryFinder>
 
 #include "corenetwork.h"
 
+#include "autowhoscheduler.h"
 #include "core.h"
 #include "coreidentity.h"
 #include "corenetworkconfig.h"
@@ -55,7 +59,6 @@ CoreNetwork::CoreNetwork(const NetworkId &networkid, CoreSession *session)
     setPingInterval(networkConfig()->pingInterval());
     connect(&_pingTimer, SIGNAL(timeout()), this, SLOT(sendPing()));
 
-    setAutoWhoDelay(networkConfig()->autoWhoDelay());
     setAutoWhoInterval(networkConfig()->autoWhoInterval());
 
     QHash<QString, QString> channels = coreSession()->persistentChannels(networkId());
@@ -67,10 +70,8 @@ CoreNetwork::CoreNetwork(const NetworkId &networkid, CoreSession *session)
     connect(networkConfig(), SIGNAL(pingIntervalSet(int)), SLOT(setPingInterval(int)));
     connect(networkConfig(), SIGNAL(autoWhoEnabledSet(bool)), SLOT(setAutoWhoEnabled(bool)));
     connect(networkConfig(), SIGNAL(autoWhoIntervalSet(int)), SLOT(setAutoWhoInterval(int)));
-    connect(networkConfig(), SIGNAL(autoWhoDelaySet(int)), SLOT(setAutoWhoDelay(int)));
 
     connect(&_autoReconnectTimer, SIGNAL(timeout()), this, SLOT(doAutoReconnect()));
-    connect(&_autoWhoTimer, SIGNAL(timeout()), this, SLOT(sendAutoWho()));
     connect(&_autoWhoCycleTimer, SIGNAL(timeout()), this, SLOT(startAutoWhoCycle()));
     connect(&_tokenBucketTimer, SIGNAL(timeout()), this, SLOT(checkTokenBucket()));
 
@@ -275,7 +276,7 @@ void CoreNetwork::disconnectFromIrc(bool requested, const QString &reason, bool
         _autoReconnectCount = 0; // prohibiting auto reconnect
     }
     disablePingTimeout();
-    _msgQueue.clear();
+    _sendQueue.clear();
 
     IrcUser *me_ = me();
     if (me_) {
@@ -315,21 +316,56 @@ void CoreNetwork::userInput(BufferInfo buf, QString msg)
 
 void CoreNetwork::putRawLine(const QByteArray s, const bool prepend)
 {
-    if (_tokenBucket > 0 || (_skipMessageRates && _msgQueue.size() == 0)) {
+    QByteArray target;
+    SendQueue::Priority priority = sendPriority(s, prepend, &target);
+    queueRawLine(s, priority, target, prepend);
+}
+
+
+void CoreNetwork::queueRawLine(const QByteArray &input, SendQueue::Priority priority, const QByteArray &target, bool prepend)
+{
+    if (_tokenBucket > 0 || (_skipMessageRates && _sendQueue.isEmpty())) {
         // If there's tokens remaining, ...
         // Or rate limits don't apply AND no messages are in queue (to prevent out-of-order), ...
         // Send the message now.
-        writeToSocket(s);
+        writeToSocket(input);
     } else {
-        // Otherwise, queue the message for later
-        if (prepend) {
-            // Jump to the start, skipping other messages
-            _msgQueue.prepend(s);
-        } else {
-            // Add to back, waiting in order
-            _msgQueue.append(s);
-        }
+        // Otherwise, queue the message for later.  Control traffic goes first, and interactive
+        // lines are sent round-robin per target, so a long paste can't block everything else.
+        _sendQueue.enqueue(input, priority, target, prepend);
+    }
+}
+
+
+SendQueue::Priority CoreNetwork::sendPriority(const QByteArray &input, bool prepend, QByteArray *target) const
+{
+    // Skip the prefix, if any
+    int start = 0;
+    if (input.startsWith(':')) {
+        start = input.indexOf(' ') + 1;
+        if (start <= 0)
+            return SendQueue::Interactive;
+    }
+    int end = input.indexOf(' ', start);
+    QByteArray cmd = input.mid(start, end < 0 ? -1 : end - start).toUpper();
+
+    if (prepend || cmd == "PING" || cmd == "PONG" || cmd == "CAP" || cmd == "AUTHENTICATE"
+        || cmd == "PASS" || cmd == "NICK" || cmd == "USER")
+        return SendQueue::Control;
+
+    // Unless forced to go out immediately (see above), QUIT waits until everything queued before it
+    // is sent, but nothing queued after it goes first
+    if (cmd == "QUIT")
+        return SendQueue::Barrier;
+
+    if (_sendingPerform)
+        return SendQueue::Bulk;
+
+    if ((cmd == "PRIVMSG" || cmd == "NOTICE") && end >= 0) {
+        int targetEnd = input.indexOf(' ', end + 1);
+        *target = input.mid(end + 1, targetEnd < 0 ? -1 : targetEnd - end - 1).toLower();
     }
+    return SendQueue::Interactive;
 }
 
 
@@ -378,6 +414,7 @@ void CoreNetwork::setChannelParted(const QString &channel)
     removeChannelKey(channel);
     _autoWhoQueue.removeAll(channel.toLower());
     _autoWhoPending.remove(channel.toLower());
+    _autoWhoComplete.remove(channel.toLower());
 
     Core::setChannelPersistent(userId(), networkId(), channel, false);
 }
@@ -480,6 +517,21 @@ bool CoreNetwork::setAutoWhoDone(const QString &channel)
 }
 
 
+int CoreNetwork::queueAutoWhoReply(const AutoWhoReply &reply)
+{
+    _autoWhoReplies << reply;
+    return _autoWhoReplies.count();
+}
+
+
+QList<CoreNetwork::AutoWhoReply> CoreNetwork::takeAutoWhoReplies()
+{
+    QList<AutoWhoReply> replies = _autoWhoReplies;
+    _autoWhoReplies.clear();
+    return replies;
+}
+
+
 void CoreNetwork::setMyNick(const QString &mynick)
 {
     Network::setMyNick(mynick);
@@ -582,13 +634,16 @@ void CoreNetwork::socketInitialized()
 
 void CoreNetwork::socketDisconnected()
 {
+    qDebug() << "Send queue statistics for network" << networkId() << sendQueueStats();
     disablePingTimeout();
-    _msgQueue.clear();
+    _sendQueue.clear();
 
     _autoWhoCycleTimer.stop();
-    _autoWhoTimer.stop();
+    coreSession()->autoWhoScheduler()->setEnabled(this, false);
     _autoWhoQueue.clear();
     _autoWhoPending.clear();
+    _autoWhoComplete.clear();
+    _autoWhoReplies.clear();
 
     _socketCloseTimer.stop();
 
@@ -675,7 +730,7 @@ void CoreNetwork::networkInitialized()
 
     if (networkConfig()->autoWhoEnabled()) {
         _autoWhoCycleTimer.start();
-        _autoWhoTimer.start();
+        coreSession()->autoWhoScheduler()->setEnabled(this, true);
         startAutoWhoCycle(); // FIXME wait for autojoin to be completed
     }
 
@@ -705,7 +760,9 @@ void CoreNetwork::sendPerform()
         }
     }
 
-    // send perform list
+    // send perform list and rejoin, without getting in the way of the user's own input.
+    // Both are queued in the same class, so the rejoin can't overtake the perform lines.
+    _sendingPerform = true;
     foreach(QString line, perform()) {
         if (!line.isEmpty()) userInput(statusBuf, line);
     }
@@ -727,6 +784,7 @@ void CoreNetwork::sendPerform()
         if (!joinString.isEmpty())
             userInputHandler()->handleJoin(statusBuf, joinString);
     }
+    _sendingPerform = false;
 }
 
 
@@ -985,7 +1043,7 @@ void CoreNetwork::updateRateLimiting(const bool forceUnlimited)
         if (_skipMessageRates) {
             // If the message queue already contains messages, they need sent before disabling the
             // timer.  Set the timer to a rapid pace and let it disable itself.
-            if (_msgQueue.size() > 0) {
+            if (!_sendQueue.isEmpty()) {
                 qDebug() << "Outgoing message queue contains messages while disabling rate "
                             "limiting.  Sending remaining queued messages...";
                 // Promptly run the timer again to clear the messages.  Rate limiting is disabled,
@@ -1277,12 +1335,6 @@ void CoreNetwork::queueAutoWhoOneshot(const QString &channelOrNick)
 }
 
 
-void CoreNetwork::setAutoWhoDelay(int delay)
-{
-    _autoWhoTimer.setInterval(delay * 1000);
-}
-
-
 void CoreNetwork::setAutoWhoInterval(int interval)
 {
     _autoWhoCycleTimer.setInterval(interval * 1000);
@@ -1291,26 +1343,28 @@ void CoreNetwork::setAutoWhoInterval(int interval)
 
 void CoreNetwork::setAutoWhoEnabled(bool enabled)
 {
-    if (enabled && isConnected() && !_autoWhoTimer.isActive())
-        _autoWhoTimer.start();
+    if (enabled && isConnected())
+        coreSession()->autoWhoScheduler()->setEnabled(this, true);
     else if (!enabled) {
-        _autoWhoTimer.stop();
+        coreSession()->autoWhoScheduler()->setEnabled(this, false);
         _autoWhoCycleTimer.stop();
     }
 }
 
 
-void CoreNetwork::sendAutoWho()
+int CoreNetwork::sendAutoWho()
 {
     // Don't send autowho if there are still some pending
     if (_autoWhoPending.count())
-        return;
+        return 0;
 
+    int cost = 0;
     while (!_autoWhoQueue.isEmpty()) {
         QString chanOrNick = _autoWhoQueue.takeFirst();
         // Check if it's a known channel or nick
         IrcChannel *ircchan = ircChannel(chanOrNick);
         IrcUser *ircuser = ircUser(chanOrNick);
+        bool allFields = true;
         if (ircchan) {
             // Apply channel limiting rules
             // If using away-notify, don't impose channel size limits in order to capture away
@@ -1319,10 +1373,18 @@ void CoreNetwork::sendAutoWho()
                 && ircchan->ircUsers().count() >= networkConfig()->autoWhoNickLimit()
                 && !capEnabled(IrcCap::AWAY_NOTIFY))
                 continue;
+            // Once we know everyone in the channel, away-notify and account-notify keep us up to
+            // date without polling
+            bool complete = _autoWhoComplete.contains(chanOrNick.toLower());
+            if (complete && capEnabled(IrcCap::AWAY_NOTIFY) && capEnabled(IrcCap::ACCOUNT_NOTIFY))
+                continue;
+            allFields = !complete;
             _autoWhoPending[chanOrNick.toLower()]++;
+            cost = qMax(ircchan->ircUsers().count(), 1);
         } else if (ircuser) {
             // Checking a nick, add it to the pending list
             _autoWhoPending[ircuser->nick().toLower()]++;
+            cost = 1;
         } else {
             // Not a channel or a nick, skip it
             qDebug() << "Skipping who polling of unknown channel or nick" << chanOrNick;
@@ -1332,11 +1394,21 @@ void CoreNetwork::sendAutoWho()
             // Use WHO extended to poll away users and/or user accounts
             // See http://faerion.sourceforge.net/doc/irc/whox.var
             // And https://github.com/hexchat/hexchat/blob/c874a9525c9b66f1d5ddcf6c4107d046eba7e2c5/src/common/proto-irc.c#L750
-            putRawLine(serverEncode(QString("WHO %1 %%chtsunfra,%2")
-                                    .arg(serverEncode(chanOrNick), QString::number(IrcCap::ACCOUNT_NOTIFY_WHOX_NUM))));
+            if (allFields) {
+                queueRawLine(serverEncode(QString("WHO %1 %%chtsunfra,%2")
+                                          .arg(serverEncode(chanOrNick), QString::number(IrcCap::ACCOUNT_NOTIFY_WHOX_NUM))),
+                             SendQueue::Bulk);
+            } else {
+                // Only away state and account change without us seeing it, so only ask for those
+                queueRawLine(serverEncode(QString("WHO %1 %%tcnfa,%2")
+                                          .arg(serverEncode(chanOrNick), QString::number(IrcCap::AUTO_WHOX_MINIMAL_NUM))),
+                             SendQueue::Bulk);
+            }
         } else {
-            putRawLine(serverEncode(QString("WHO %1").arg(chanOrNick)));
+            queueRawLine(serverEncode(QString("WHO %1").arg(chanOrNick)), SendQueue::Bulk);
         }
+        if (ircchan)
+            _autoWhoComplete.insert(chanOrNick.toLower());
         break;
     }
 
@@ -1350,6 +1422,7 @@ void CoreNetwork::sendAutoWho()
         // Don't run another who cycle if away-notify is enabled
         _autoWhoCycleTimer.stop();
     }
+    return cost;
 }
 
 
@@ -1391,7 +1464,7 @@ void CoreNetwork::sslErrors(const QList<QSslError> &sslErrors)
 void CoreNetwork::checkTokenBucket()
 {
     if (_skipMessageRates) {
-        if (_msgQueue.size() == 0) {
+        if (_sendQueue.isEmpty()) {
             // Message queue emptied; stop the timer and bail out
             _tokenBucketTimer.stop();
             return;
@@ -1412,8 +1485,8 @@ void CoreNetwork::fillBucketAndProcessQueue()
     }
 
     // As long as there's tokens available and messages remaining, sending messages from the queue
-    while (_msgQueue.size() > 0 && _tokenBucket > 0) {
-        writeToSocket(_msgQueue.takeFirst());
+    while (!_sendQueue.isEmpty() && _tokenBucket > 0) {
+        writeToSocket(_sendQueue.takeNext());
     }
 }
 
@@ -1480,77 +1553,105 @@ void CoreNetwork::requestSetNetworkInfo(const NetworkInfo &info)
 }
 
 
+namespace {
+
+QList<int> boundaryPositions(QTextBoundaryFinder::BoundaryType type, const QString &string)
+{
+    QList<int> positions;
+    QTextBoundaryFinder finder(type, string);
+    for (int pos = finder.toNextBoundary(); pos > 0; pos = finder.toNextBoundary())
+        positions << pos;
+    return positions;
+}
+
+}
+
+
 QList<QList<QByteArray>> CoreNetwork::splitMessage(const QString &cmd, const QString &message, std::function<QList<QByteArray>(QString &)> cmdGenerator)
 {
-    QString wrkMsg(message);
+    return splitMessage(message, cmdGenerator, [this, &cmd](const QList<QByteArray> &params) {
+        return userInputHandler()->lastParamOverrun(cmd, params);
+    });
+}
+
+
+QList<QList<QByteArray>> CoreNetwork::splitMessage(const QString &message, std::function<QList<QByteArray>(QString &)> cmdGenerator,
+                                                   std::function<int(const QList<QByteArray> &)> overrunFunc)
+{
     QList<QList<QByteArray>> msgsToSend;
 
-    // do while (wrkMsg.size() > 0)
-    do {
-        // First, check to see if the whole message can be sent at once.  The
-        // cmdGenerator function is passed in by the caller and is used to encode
-        // and encrypt (if applicable) the message, since different callers might
-        // want to use different encoding or encode different values.
-        int splitPos = wrkMsg.size();
-        QList<QByteArray> initialSplitMsgEnc = cmdGenerator(wrkMsg);
-        int initialOverrun = userInputHandler()->lastParamOverrun(cmd, initialSplitMsgEnc);
-
-        if (initialOverrun) {
-            // If the message was too long to be sent, first try splitting it along
-            // word boundaries with QTextBoundaryFinder.
-            QString splitMsg(wrkMsg);
-            QTextBoundaryFinder qtbf(QTextBoundaryFinder::Word, splitMsg);
-            qtbf.setPosition(initialSplitMsgEnc[1].size() - initialOverrun);
-            QList<QByteArray> splitMsgEnc;
-            int overrun = initialOverrun;
-
-            while (overrun) {
-                splitPos = qtbf.toPreviousBoundary();
-
-                // splitPos==-1 means the QTBF couldn't find a split point at all and
-                // splitPos==0 means the QTBF could only find a boundary at the beginning of
-                // the string.  Neither one of these works for us.
-                if (splitPos > 0) {
-                    // If a split point could be found, split the message there, calculate the
-                    // overrun, and continue with the loop.
-                    splitMsg = splitMsg.left(splitPos);
-                    splitMsgEnc = cmdGenerator(splitMsg);
-                    overrun = userInputHandler()->lastParamOverrun(cmd, splitMsgEnc);
+    // First, check to see if the whole message can be sent at once.  The
+    // cmdGenerator function is passed in by the caller and is used to encode
+    // and encrypt (if applicable) the message, since different callers might
+    // want to use different encoding or encode different values.
+    QString wrkMsg(message);
+    QList<QByteArray> msgEnc = cmdGenerator(wrkMsg);
+    int overrun = overrunFunc(msgEnc);
+    if (!overrun) {
+        msgsToSend.append(msgEnc);
+        return msgsToSend;
+    }
+
+    // The byte budget for the last parameter is the same for all parts. Encoding (and encryption)
+    // never produces fewer bytes than characters, so a part can't be longer than that in
+    // characters either. This bounds the work per part, rather than re-encoding the whole
+    // remainder of a long paste for every part.
+    int maxChars = msgEnc.last().size() - overrun;
+
+    // Candidate split points, computed once for the whole message. We prefer word boundaries and
+    // only fall back to graphemes if a single word doesn't fit.
+    QList<int> wordBoundaries = boundaryPositions(QTextBoundaryFinder::Word, message);
+    QList<int> graphemeBoundaries;
+
+    int pos = 0;
+    while (pos < message.size()) {
+        int limit = qMin(message.size(), pos + qMax(maxChars, 0));
+
+        // The remainder may well fit as a whole
+        if (limit == message.size()) {
+            wrkMsg = message.mid(pos);
+            msgEnc = cmdGenerator(wrkMsg);
+            if (!overrunFunc(msgEnc)) {
+                msgsToSend.append(msgEnc);
+                break;
+            }
+        }
+
+        // Encoded length grows with the number of characters, so we can binary search for the
+        // last boundary that still fits instead of walking backwards one boundary at a time.
+        int splitPos = -1;
+        QList<QByteArray> splitMsgEnc;
+        for (int pass = 0; pass < 2 && splitPos < 0; pass++) {
+            if (pass == 1 && graphemeBoundaries.isEmpty())
+                graphemeBoundaries = boundaryPositions(QTextBoundaryFinder::Grapheme, message);
+            const QList<int> &boundaries = pass == 0 ? wordBoundaries : graphemeBoundaries;
+
+            QList<int>::const_iterator lo = std::upper_bound(boundaries.constBegin(), boundaries.constEnd(), pos);
+            QList<int>::const_iterator hi = std::upper_bound(lo, boundaries.constEnd(), limit);
+            while (lo != hi) {
+                QList<int>::const_iterator mid = lo + (hi - lo) / 2;
+                wrkMsg = message.mid(pos, *mid - pos);
+                QList<QByteArray> candidateEnc = cmdGenerator(wrkMsg);
+                if (!overrunFunc(candidateEnc)) {
+                    splitPos = *mid;
+                    splitMsgEnc = candidateEnc;
+                    lo = mid + 1;
                 }
                 else {
-                    // If a split point could not be found (the beginning of the message
-                    // is reached without finding a split point short enough to send) and we
-                    // are still in Word mode, switch to Grapheme mode.  We also need to restore
-                    // the full wrkMsg to splitMsg, since splitMsg may have been cut down during
-                    // the previous attempt to find a split point.
-                    if (qtbf.type() == QTextBoundaryFinder::Word) {
-                        splitMsg = wrkMsg;
-                        splitPos = splitMsg.size();
-                        QTextBoundaryFinder graphemeQtbf(QTextBoundaryFinder::Grapheme, splitMsg);
-                        graphemeQtbf.setPosition(initialSplitMsgEnc[1].size() - initialOverrun);
-                        qtbf = graphemeQtbf;
-                    }
-                    else {
-                        // If the QTBF fails to find a split point in Grapheme mode, we give up.
-                        // This should never happen, but it should be handled anyway.
-                        qWarning() << "Unexpected failure to split message!";
-                        return msgsToSend;
-                    }
+                    hi = mid;
                 }
             }
-
-            // Once a message of sendable length has been found, remove it from the wrkMsg and
-            // add it to the list of messages to be sent.
-            wrkMsg.remove(0, splitPos);
-            msgsToSend.append(splitMsgEnc);
         }
-        else{
-            // If the entire remaining message is short enough to be sent all at once, remove
-            // it from the wrkMsg and add it to the list of messages to be sent.
-            wrkMsg.remove(0, splitPos);
-            msgsToSend.append(initialSplitMsgEnc);
+
+        if (splitPos < 0) {
+            // Not even a single grapheme fits. This should never happen, but it should be handled anyway.
+            qWarning() << "Unexpected failure to split message!";
+            return msgsToSend;
         }
-    } while (wrkMsg.size() > 0);
+
+        msgsToSend.append(splitMsgEnc);
+        pos = splitPos;
+    }
 
     return msgsToSend;
 }
@@ -28,6 +28,7 @@
 // IRCv3 capabilities
 #include "irccap.h"
 
+#include <QSet>
 #include <QTimer>
 
 #ifdef HAVE_SSL
@@ -42,6 +43,7 @@
 #endif
 
 #include "coresession.h"
+#include "sendqueue.h"
 
 #include <functional>
 
@@ -56,6 +58,14 @@ class CoreNetwork : public Network
         Q_OBJECT
 
 public:
+    //! A reply to a minimal AutoWho WHOX, see IrcCap::AUTO_WHOX_MINIMAL_NUM
+    struct AutoWhoReply {
+        QString channel;
+        QString nick;
+        QString flags;
+        QString account;
+    };
+
     CoreNetwork(const NetworkId &networkid, CoreSession *session);
     ~CoreNetwork();
     inline virtual const QMetaObject *syncMetaObject() const { return &Network::staticMetaObject; }
@@ -110,8 +120,26 @@ public:
      */
     inline bool disconnectExpected() const { return _disconnectExpected; }
 
+    /**
+     * Gets statistics of the outgoing message queue.
+     *
+     * @return Queue depths and wait times for each class of the send queue
+     */
+    inline QVariantMap sendQueueStats() const { return _sendQueue.statsMap(); }
+
     QList<QList<QByteArray>> splitMessage(const QString &cmd, const QString &message, std::function<QList<QByteArray>(QString &)> cmdGenerator);
 
+    /**
+     * Splits a message into parts that each fit into one line.
+     *
+     * @param message       The message to split
+     * @param cmdGenerator  Builds the encoded (and possibly encrypted) parameters for a part
+     * @param overrunFunc   Returns by how many bytes the parameters exceed the line length, or 0 if they fit
+     * @return The parameters for each part, in order
+     */
+    static QList<QList<QByteArray>> splitMessage(const QString &message, std::function<QList<QByteArray>(QString &)> cmdGenerator,
+                                                 std::function<int(const QList<QByteArray> &)> overrunFunc);
+
     // IRCv3 capability negotiation
 
     /**
@@ -350,7 +378,6 @@ public slots:
 
     void setAutoWhoEnabled(bool enabled);
     void setAutoWhoInterval(int interval);
-    void setAutoWhoDelay(int delay);
 
     /**
      * Appends the given channel/nick to the front of the AutoWho queue.
@@ -364,6 +391,30 @@ public slots:
 
     bool setAutoWhoDone(const QString &channel);
 
+    /**
+     * Queues a minimal WHOX reply received during AutoWho, to be applied in a batch.
+     *
+     * @param[in] reply The parsed reply
+     * @returns Number of replies currently queued
+     */
+    int queueAutoWhoReply(const AutoWhoReply &reply);
+
+    /**
+     * Takes all queued AutoWho replies, for applying them to the IrcUsers.
+     *
+     * @returns Queued replies in the order they were received
+     */
+    QList<AutoWhoReply> takeAutoWhoReplies();
+
+    /**
+     * Sends the next queued AutoWho, unless one is still in progress.
+     *
+     * Called by the session's AutoWhoScheduler.
+     *
+     * @returns Number of users the WHO is expected to return, or 0 if nothing was sent
+     */
+    int sendAutoWho();
+
     void updateIssuedModes(const QString &requestedModes);
     void updatePersistentModes(QString addModes, QString removeModes);
     void resetPersistentModes();
@@ -417,7 +468,6 @@ private slots:
     void sendPing();
     void enablePingTimeout(bool enable = true);
     void disablePingTimeout();
-    void sendAutoWho();
     void startAutoWhoCycle();
 
 #ifdef HAVE_SSL
@@ -446,6 +496,27 @@ private slots:
     void writeToSocket(const QByteArray &data);
 
 private:
+    /**
+     * Sends the raw (encoded) line, or adds it to the given class of the send queue if the token
+     * bucket is empty.
+     *
+     * @param[in] input    QByteArray of encoded characters
+     * @param[in] priority Send queue class of the line
+     * @param[in] target   For interactive lines, the lowercased target used for round-robin
+     * @param[in] prepend  If true, the line jumps to the front of its class
+     */
+    void queueRawLine(const QByteArray &input, SendQueue::Priority priority, const QByteArray &target = QByteArray(), bool prepend = false);
+
+    /**
+     * Determines the send queue class of a raw line from its command.
+     *
+     * @param[in]  input   QByteArray of encoded characters
+     * @param[in]  prepend Whether the line was sent with high priority
+     * @param[out] target  Lowercased target of PRIVMSG and NOTICE lines
+     * @returns The class the line should be queued in
+     */
+    SendQueue::Priority sendPriority(const QByteArray &input, bool prepend, QByteArray *target) const;
+
     CoreSession *_coreSession;
 
 #ifdef HAVE_SSL
@@ -483,7 +554,9 @@ private:
 
     QStringList _autoWhoQueue;
     QHash<QString, int> _autoWhoPending;
-    QTimer _autoWhoTimer, _autoWhoCycleTimer;
+    QSet<QString> _autoWhoComplete;      /// Channels polled with all WHO fields since joining
+    QList<AutoWhoReply> _autoWhoReplies; /// Minimal WHOX replies waiting to be applied
+    QTimer _autoWhoCycleTimer;
 
     // Maintain a list of CAPs that are being checked; if empty, negotiation finished
     // See http://ircv3.net/specs/core/capability-negotiation-3.2.html
@@ -527,8 +600,9 @@ private:
     quint32 _messageDelay;       /// Token refill speed in ms
     quint32 _burstSize;          /// Size of the token bucket
     quint32 _tokenBucket;        /// The virtual bucket that holds the tokens
-    QList<QByteArray> _msgQueue; /// Queue of messages waiting to be sent
+    SendQueue _sendQueue;        /// Queue of messages waiting to be sent
     bool _skipMessageRates;      /// If true, skip all message rate limits
+    bool _sendingPerform{false}; /// If true, lines are queued as bulk traffic
 
     QString _requestedUserModes; // 2 strings separated by a '-' character. first part are requested modes to add, the second to remove
 
@@ -22,6 +22,7 @@
 
 #include <QtScript>
 
+#include "autowhoscheduler.h"
 #include "core.h"
 #include "coreuserinputhandler.h"
 #include "corebuffersyncer.h"
@@ -75,8 +76,10 @@ CoreSession::CoreSession(UserId uid, bool restoreState, QObject *parent)
     _sessionEventProcessor(new CoreSessionEventProcessor(this)),
     _ctcpParser(new CtcpParser(this)),
     _ircParser(new IrcParser(this)),
+    _autoWhoScheduler(new AutoWhoScheduler(this)),
     scriptEngine(new QScriptEngine(this)),
     _processMessages(false),
+    _backlogCache(uid),
     _ignoreListManager(this),
     _highlightRuleManager(this)
 {
@@ -90,7 +93,8 @@ CoreSession::CoreSession(UserId uid, bool restoreState, QObject *parent)
     connect(p, SIGNAL(disconnected()), SLOT(clientsDisconnected()));
 
     p->attachSlot(SIGNAL(sendInput(BufferInfo, QString)), this, SLOT(msgFromClient(BufferInfo, QString)));
-    p->attachSignal(this, SIGNAL(displayMsg(Message)));
+    p->attachSignal(this, SIGNAL(sendDisplayMsg(Message)), SIGNAL(displayMsg(Message)));
+    p->attachSignal(this, SIGNAL(sendDisplayMsgs(QVariantList)), SIGNAL(displayMsgs(QVariantList)));
     p->attachSignal(this, SIGNAL(displayStatusMsg(QString, QString)));
 
     p->attachSignal(this, SIGNAL(identityCreated(const Identity &)));
@@ -144,8 +148,12 @@ CoreSession::CoreSession(UserId uid, bool restoreState, QObject *parent)
 
 CoreSession::~CoreSession()
 {
+    // messages still queued for storage must not be handed back to us anymore
+    Core::cancelStoreMessages(this);
     saveSessionState();
 
+    qDebug() << "Backlog cache statistics for user" << user() << _backlogCache.statsMap();
+
     /* Why partially duplicate CoreNetwork destructor?  When each CoreNetwork quits in the
      * destructor, disconnections are processed in sequence for each object.  For many IRC servers
      * on a slow network, this could significantly delay core shutdown [msecs wait * network count].
@@ -354,6 +362,39 @@ QList<BufferInfo> CoreSession::buffers() const
 }
 
 
+BufferInfo CoreSession::bufferInfo(NetworkId networkId, BufferInfo::Type type, const QString &buffer, bool create)
+{
+    // the storage backends look up buffers case-insensitively by name only, so do we
+    QString cname = buffer.toLower();
+    QHash<QString, BufferInfo> &netCache = _bufferInfoCache[networkId];
+    QHash<QString, BufferInfo>::const_iterator it = netCache.constFind(cname);
+    if (it != netCache.constEnd()) {
+        // like the storage, return the name as requested
+        return BufferInfo(it->bufferId(), it->networkId(), it->type(), it->groupId(), buffer);
+    }
+
+    BufferInfo bufferInfo = Core::bufferInfo(user(), networkId, type, buffer, create);
+    if (bufferInfo.isValid())
+        netCache.insert(cname, bufferInfo);
+    return bufferInfo;
+}
+
+
+void CoreSession::invalidateBufferInfo(BufferId bufferId)
+{
+    QHash<NetworkId, QHash<QString, BufferInfo> >::iterator netIter;
+    for (netIter = _bufferInfoCache.begin(); netIter != _bufferInfoCache.end(); ++netIter) {
+        QHash<QString, BufferInfo>::iterator it = netIter->begin();
+        while (it != netIter->end()) {
+            if (it->bufferId() == bufferId)
+                it = netIter->erase(it);
+            else
+                ++it;
+        }
+    }
+}
+
+
 void CoreSession::customEvent(QEvent *event)
 {
     if (event->type() != QEvent::User)
@@ -369,15 +410,14 @@ void CoreSession::processMessages()
     if (_messageQueue.count() == 1) {
         const RawMessage &rawMsg = _messageQueue.first();
         bool createBuffer = !(rawMsg.flags & Message::Redirected);
-        BufferInfo bufferInfo = Core::bufferInfo(user(), rawMsg.networkId, rawMsg.bufferType, rawMsg.target, createBuffer);
+        BufferInfo bufferInfo = this->bufferInfo(rawMsg.networkId, rawMsg.bufferType, rawMsg.target, createBuffer);
         if (!bufferInfo.isValid()) {
             Q_ASSERT(!createBuffer);
-            bufferInfo = Core::bufferInfo(user(), rawMsg.networkId, BufferInfo::StatusBuffer, "");
+            bufferInfo = this->bufferInfo(rawMsg.networkId, BufferInfo::StatusBuffer, "");
         }
         Message msg(bufferInfo, rawMsg.type, rawMsg.text, rawMsg.sender,
                     senderPrefixes(rawMsg.sender, bufferInfo), rawMsg.flags);
-        if(Core::storeMessage(msg))
-            emit displayMsg(msg);
+        Core::storeMessagesAsync(MessageList() << msg, this, "messagesStored");
     }
     else {
         QHash<NetworkId, QHash<QString, BufferInfo> > bufferInfoCache;
@@ -391,7 +431,7 @@ void CoreSession::processMessages()
             }
             else {
                 bool createBuffer = !(rawMsg.flags & Message::Redirected);
-                bufferInfo = Core::bufferInfo(user(), rawMsg.networkId, rawMsg.bufferType, rawMsg.target, createBuffer);
+                bufferInfo = this->bufferInfo(rawMsg.networkId, rawMsg.bufferType, rawMsg.target, createBuffer);
                 if (!bufferInfo.isValid()) {
                     Q_ASSERT(!createBuffer);
                     redirectedMessages << rawMsg;
@@ -412,7 +452,7 @@ void CoreSession::processMessages()
             }
             else {
                 // no luck -> we store them in the StatusBuffer
-                bufferInfo = Core::bufferInfo(user(), rawMsg.networkId, BufferInfo::StatusBuffer, "");
+                bufferInfo = this->bufferInfo(rawMsg.networkId, BufferInfo::StatusBuffer, "");
                 // add the StatusBuffer to the Cache in case there are more Messages for the original target
                 bufferInfoCache[rawMsg.networkId][rawMsg.target] = bufferInfo;
             }
@@ -421,17 +461,66 @@ void CoreSession::processMessages()
             messages << msg;
         }
 
-        if(Core::storeMessages(messages)) {
-            // FIXME: extend protocol to a displayMessages(MessageList)
-            for (int i = 0; i < messages.count(); i++) {
-                emit displayMsg(messages[i]);
-            }
-        }
+        Core::storeMessagesAsync(messages, this, "messagesStored");
     }
     _processMessages = false;
     _messageQueue.clear();
 }
 
+
+void CoreSession::messagesStored(const MessageList &messages)
+{
+    MessageList stored;
+    for (int i = 0; i < messages.count(); i++) {
+        if (messages.at(i).msgId().isValid()) {
+            stored << messages.at(i);
+            emit displayMsg(messages.at(i));
+        }
+    }
+    if (stored.isEmpty())
+        return;
+
+    _backlogCache.addMessages(stored);
+
+    // Clients supporting batches get all messages in a single call, older ones one call per message
+    QSet<Peer *> batchPeers;
+    QSet<Peer *> singlePeers;
+    for (auto &&peer : signalProxy()->peers()) {
+        if (peer->hasFeature(Quassel::Feature::BatchedDisplayMsgs))
+            batchPeers.insert(peer);
+        else
+            singlePeers.insert(peer);
+    }
+
+    if (!singlePeers.isEmpty()) {
+        signalProxy()->restrictTargetPeers(singlePeers, [&]{
+            foreach(const Message &msg, stored) {
+                emit sendDisplayMsg(msg);
+            }
+        });
+    }
+
+    // The batch is encoded once for all peers sharing the same encoding
+    QSet<Peer *> compactPeers;
+    QSet<Peer *> variantPeers;
+    for (auto &&peer : batchPeers) {
+        if (peer->hasFeature(Quassel::Feature::CompactMessages))
+            compactPeers.insert(peer);
+        else
+            variantPeers.insert(peer);
+    }
+
+    foreach(const QSet<Peer *> &peers, QList<QSet<Peer *> >() << compactPeers << variantPeers) {
+        if (peers.isEmpty())
+            continue;
+        QVariantList batch = messagesToVariantList(stored, *peers.constBegin());
+        signalProxy()->restrictTargetPeers(peers, [&]{
+            emit sendDisplayMsgs(batch);
+        });
+    }
+}
+
+
 QString CoreSession::senderPrefixes(const QString &sender, const BufferInfo &bufferInfo) const
 {
     CoreNetwork *currentNetwork = network(bufferInfo.networkId());
@@ -617,6 +706,10 @@ void CoreSession::destroyNetwork(NetworkId id)
     QList<BufferId> removedBuffers = Core::requestBufferIdsForNetwork(user(), id);
     Network *net = _networks.take(id);
     if (net && Core::removeNetwork(user(), id)) {
+        _bufferInfoCache.remove(id);
+        foreach(BufferId bufferId, removedBuffers) {
+            _backlogCache.invalidate(bufferId);
+        }
         // make sure that all unprocessed RawMessages from this network are removed
         QList<RawMessage>::iterator messageIter = _messageQueue.begin();
         while (messageIter != _messageQueue.end()) {
@@ -639,7 +732,7 @@ void CoreSession::destroyNetwork(NetworkId id)
 
 void CoreSession::renameBuffer(const NetworkId &networkId, const QString &newName, const QString &oldName)
 {
-    BufferInfo bufferInfo = Core::bufferInfo(user(), networkId, BufferInfo::QueryBuffer, oldName, false);
+    BufferInfo bufferInfo = this->bufferInfo(networkId, BufferInfo::QueryBuffer, oldName, false);
     if (bufferInfo.isValid()) {
         _bufferSyncer->renameBuffer(bufferInfo.bufferId(), newName);
     }
@@ -24,6 +24,7 @@
 #include <QString>
 #include <QVariant>
 
+#include "backlogcache.h"
 #include "corecoreinfo.h"
 #include "corealiasmanager.h"
 #include "corehighlightrulemanager.h"
@@ -33,6 +34,7 @@
 #include "message.h"
 #include "storage.h"
 
+class AutoWhoScheduler;
 class CoreBacklogManager;
 class CoreBufferSyncer;
 class CoreBufferViewManager;
@@ -75,6 +77,18 @@ public:
 
     Protocol::SessionState sessionState() const;
 
+    //! Get the BufferInfo for the given buffer, creating the buffer if requested
+    /** Works like Core::bufferInfo(), but buffers that have been looked up before are served from memory.
+     *  \sa Core::bufferInfo()
+     */
+    BufferInfo bufferInfo(NetworkId networkId, BufferInfo::Type type, const QString &buffer = "", bool create = true);
+
+    //! Forget a cached BufferInfo, must be called when a buffer is renamed, merged or removed
+    void invalidateBufferInfo(BufferId bufferId);
+
+    //! In-memory cache of the most recent messages, to be used for backlog requests
+    inline BacklogCache *backlogCache() { return &_backlogCache; }
+
     inline SignalProxy *signalProxy() const { return _signalProxy; }
 
     const AliasManager &aliasManager() const { return _aliasManager; }
@@ -85,6 +99,7 @@ public:
     inline CoreSessionEventProcessor *sessionEventProcessor() const { return _sessionEventProcessor; }
     inline CtcpParser *ctcpParser() const { return _ctcpParser; }
     inline IrcParser *ircParser() const { return _ircParser; }
+    inline AutoWhoScheduler *autoWhoScheduler() const { return _autoWhoScheduler; }
 
     inline CoreIrcListHelper *ircListHelper() const { return _ircListHelper; }
 
@@ -154,6 +169,11 @@ signals:
     void displayMsg(Message message);
     void displayStatusMsg(QString, QString);
 
+    //! Sends a message to clients that don't support batches
+    void sendDisplayMsg(Message message);
+    //! Sends a batch of messages to clients supporting Quassel::Feature::BatchedDisplayMsgs
+    void sendDisplayMsgs(QVariantList messages);
+
     void scriptResult(QString result);
 
     //! Identity has been created.
@@ -196,6 +216,9 @@ private slots:
 
     void saveSessionState() const;
 
+    //! Called by the storage writer once our messages have been stored
+    void messagesStored(const MessageList &messages);
+
 private:
     void processMessages();
 
@@ -228,6 +251,7 @@ private:
     CoreSessionEventProcessor *_sessionEventProcessor;
     CtcpParser *_ctcpParser;
     IrcParser *_ircParser;
+    AutoWhoScheduler *_autoWhoScheduler;
 
     QScriptEngine *scriptEngine;
 
@@ -240,6 +264,12 @@ private:
     QString senderPrefixes(const QString &sender, const BufferInfo &bufferInfo) const;
     QList<RawMessage> _messageQueue;
     bool _processMessages;
+
+    // network -> casefolded buffer name -> BufferInfo
+    QHash<NetworkId, QHash<QString, BufferInfo> > _bufferInfoCache;
+
+    BacklogCache _backlogCache;
+
     CoreIgnoreListManager _ignoreListManager;
     CoreHighlightRuleManager _highlightRuleManager;
 };
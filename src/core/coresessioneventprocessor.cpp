@@ -943,6 +943,7 @@ void CoreSessionEventProcessor::processIrcEvent315(IrcEvent *e)
     if (!checkParamCount(e, 1))
         return;
 
+    applyAutoWhoReplies(coreNetwork(e));
     if (coreNetwork(e)->setAutoWhoDone(e->params()[0]))
         e->setFlag(EventManager::Silent);
 }
@@ -1158,6 +1159,26 @@ void CoreSessionEventProcessor::processIrcEvent354(IrcEvent *e)
     if (!checkParamCount(e, 1))
         return;
 
+    if (e->params()[0].toUInt() == IrcCap::AUTO_WHOX_MINIMAL_NUM) {
+        // Minimal AutoWho refresh: "<token> <channel> <nick> <flags> <account>"
+        if (!checkParamCount(e, 5))
+            return;
+
+        CoreNetwork::AutoWhoReply reply;
+        reply.channel = e->params()[1];
+        reply.nick = e->params()[2];
+        reply.flags = e->params()[3];
+        reply.account = e->params()[4];
+        // Large channels reply with thousands of lines; apply them in batches rather than one by
+        // one, but don't let a batch grow without bounds either
+        if (coreNetwork(e)->queueAutoWhoReply(reply) >= 500)
+            applyAutoWhoReplies(coreNetwork(e));
+
+        // These are only ever requested by AutoWho, so never show them
+        e->setFlag(EventManager::Silent);
+        return;
+    }
+
     if (e->params()[0].toUInt() != IrcCap::ACCOUNT_NOTIFY_WHOX_NUM) {
         // Ignore WHOX replies without expected number for we have no idea what fields are specified
         return;
@@ -1203,6 +1224,21 @@ void CoreSessionEventProcessor::processIrcEvent354(IrcEvent *e)
 }
 
 
+void CoreSessionEventProcessor::applyAutoWhoReplies(CoreNetwork *net)
+{
+    foreach(const CoreNetwork::AutoWhoReply &reply, net->takeAutoWhoReplies()) {
+        // Don't create an IRC user here, see processIrcEvent352()
+        IrcUser *ircuser = net->ircUser(reply.nick);
+        if (!ircuser)
+            continue;
+
+        processWhoFlags(net, reply.channel, ircuser, reply.flags);
+        // WHOX uses '0' to indicate logged-out, account-notify and extended-join uses '*'.
+        ircuser->setAccount(reply.account != "0" ? reply.account : "*");
+    }
+}
+
+
 void CoreSessionEventProcessor::processWhoInformation (Network *net, const QString &targetChannel, IrcUser *ircUser,
                             const QString &server, const QString &user, const QString &host,
                             const QString &awayStateAndModes, const QString &realname)
@@ -1212,6 +1248,13 @@ void CoreSessionEventProcessor::processWhoInformation (Network *net, const QStri
     ircUser->setServer(server);
     ircUser->setRealName(realname);
 
+    processWhoFlags(net, targetChannel, ircUser, awayStateAndModes);
+}
+
+
+void CoreSessionEventProcessor::processWhoFlags(Network *net, const QString &targetChannel, IrcUser *ircUser,
+                                                const QString &awayStateAndModes)
+{
     bool away = awayStateAndModes.contains("G", Qt::CaseInsensitive);
     ircUser->setAway(away);
 
@@ -180,6 +180,24 @@ private:
     void processWhoInformation (Network *net, const QString &targetChannel, IrcUser *ircUser,
                                 const QString &server, const QString &user, const QString &host,
                                 const QString &awayStateAndModes, const QString &realname);
+
+    /**
+     * Process the away state and channel modes of a WHO reply
+     *
+     * @param[in] net                 Network object for the IRC server
+     * @param[in] targetChannel       Target channel, or * if unspecified
+     * @param[in] ircUser             IrcUser representing the desired nick
+     * @param[in] awayStateAndModes   Nick away-state and modes (e.g. G@)
+     */
+    void processWhoFlags(Network *net, const QString &targetChannel, IrcUser *ircUser,
+                         const QString &awayStateAndModes);
+
+    /**
+     * Apply the minimal WHOX replies queued by the network during AutoWho
+     *
+     * @param[in] net Network object for the IRC server
+     */
+    void applyAutoWhoReplies(CoreNetwork *net);
 };
 
 
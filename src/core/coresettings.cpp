@@ -55,6 +55,41 @@ void CoreSettings::setAuthSettings(const QVariant &data)
     setLocalValue("AuthSettings", data);
 }
 
+void CoreSettings::setStorageWriterSettings(const QVariant &data)
+{
+    setLocalValue("StorageWriterSettings", data);
+}
+
+
+QVariant CoreSettings::storageWriterSettings(const QVariant &def)
+{
+    return localValue("StorageWriterSettings", def);
+}
+
+
+void CoreSettings::setConnectionSettings(const QVariant &data)
+{
+    setLocalValue("ConnectionSettings", data);
+}
+
+
+QVariant CoreSettings::connectionSettings(const QVariant &def)
+{
+    return localValue("ConnectionSettings", def);
+}
+
+
+void CoreSettings::setStorageCacheSettings(const QVariant &data)
+{
+    setLocalValue("StorageCacheSettings", data);
+}
+
+
+QVariant CoreSettings::storageCacheSettings(const QVariant &def)
+{
+    return localValue("StorageCacheSettings", def);
+}
+
 // FIXME remove
 QVariant CoreSettings::oldDbSettings()
 {
@@ -35,6 +35,15 @@ public:
     void setAuthSettings(const QVariant &data);
     QVariant authSettings(const QVariant &def = QVariant());
 
+    void setStorageWriterSettings(const QVariant &data);
+    QVariant storageWriterSettings(const QVariant &def = QVariant());
+
+    void setStorageCacheSettings(const QVariant &data);
+    QVariant storageCacheSettings(const QVariant &def = QVariant());
+
+    void setConnectionSettings(const QVariant &data);
+    QVariant connectionSettings(const QVariant &def = QVariant());
+
     QVariant oldDbSettings();  // FIXME remove
 
     void setCoreState(const QVariant &data);
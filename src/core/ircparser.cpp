@@ -23,6 +23,7 @@
 #include "corenetwork.h"
 #include "eventmanager.h"
 #include "ircevent.h"
+#include "irctokenizer.h"
 #include "messageevent.h"
 #include "networkevent.h"
 
@@ -72,6 +73,50 @@ QByteArray IrcParser::decrypt(Network *network, const QString &bufferName, const
 }
 
 
+namespace {
+
+typedef QHash<QByteArray, EventManager::EventType> CommandTable;
+
+// Maps upper-cased IRC commands to their event types, e.g. "PRIVMSG" to IrcEventPrivmsg.
+// Only types named like IrcEventCommand are considered, which is what the parser has always accepted.
+CommandTable buildCommandTable()
+{
+    CommandTable table;
+    const QMetaObject &meta = EventManager::staticMetaObject;
+    QMetaEnum eventEnum = meta.enumerator(meta.indexOfEnumerator("EventType"));
+    for (int i = 0; i < eventEnum.keyCount(); i++) {
+        QByteArray key(eventEnum.key(i));
+        if (!key.startsWith("IrcEvent") || key.length() <= 8)
+            continue;
+        QByteArray name = key.mid(8);
+        if (name != name.left(1).toUpper() + name.mid(1).toLower())
+            continue;
+        table.insert(name.toUpper(), static_cast<EventManager::EventType>(eventEnum.value(i)));
+    }
+    return table;
+}
+
+}
+
+
+EventManager::EventType IrcParser::eventTypeByCommand(const char *cmd, int length)
+{
+    static const CommandTable commandTable = buildCommandTable(); // thread-safe initialization
+
+    // upper-case the command on the stack, so the lookup doesn't allocate
+    char buffer[32];
+    if (length <= 0 || length > (int)sizeof(buffer))
+        return EventManager::IrcEventUnknown;
+
+    for (int i = 0; i < length; i++) {
+        char c = cmd[i];
+        buffer[i] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+    }
+
+    return commandTable.value(QByteArray::fromRawData(buffer, length), EventManager::IrcEventUnknown);
+}
+
+
 /* parse the raw server string and generate an appropriate event */
 /* used to be handleServerMsg()                                  */
 void IrcParser::processNetworkIncoming(NetworkDataEvent *e)
@@ -92,79 +137,47 @@ void IrcParser::processNetworkIncoming(NetworkDataEvent *e)
     }
 
     // Now we split the raw message into its various parts...
-    QString prefix;
-    QByteArray trailing;
-    QString cmd, target;
-
-    // First, check for a trailing parameter introduced by " :", since this might screw up splitting the msg
-    // NOTE: This assumes that this is true in raw encoding, but well, hopefully there are no servers running in japanese on protocol level...
-    int idx = msg.indexOf(" :");
-    if (idx >= 0) {
-        if (msg.length() > idx + 2)
-            trailing = msg.mid(idx + 2);
-        msg = msg.left(idx);
-    }
-    // OK, now it is safe to split...
-    QList<QByteArray> params = msg.split(' ');
-
-    // This could still contain empty elements due to (faulty?) ircds sending multiple spaces in a row
-    // Also, QByteArray is not nearly as convenient to work with as QString for such things :)
-    QList<QByteArray>::iterator iter = params.begin();
-    while (iter != params.end()) {
-        if (iter->isEmpty())
-            iter = params.erase(iter);
-        else
-            ++iter;
-    }
-
-    if (!trailing.isEmpty())
-        params << trailing;
-    if (params.count() < 1) {
+    IrcTokenizer tokens;
+    if (!tokens.tokenize(msg)) {
         qWarning() << "Received invalid string from server!";
         return;
     }
 
-    QString foo = net->serverDecode(params.takeFirst());
-
-    // a colon as the first chars indicates the existence of a prefix
-    if (foo[0] == ':') {
-        foo.remove(0, 1);
-        prefix = foo;
-        if (params.count() < 1) {
-            qWarning() << "Received invalid string from server!";
-            return;
-        }
-        foo = net->serverDecode(params.takeFirst());
-    }
+    QString prefix;
+    if (tokens.hasPrefix())
+        prefix = net->serverDecode(tokens.toByteArray(tokens.prefix()));
 
-    // next string without a whitespace is the command
-    cmd = foo.trimmed();
+    // commands are plain ASCII, no need to go through the codec
+    IrcTokenizer::Range cmdRange = tokens.command();
+    QString cmd = QString::fromLatin1(tokens.data(cmdRange), cmdRange.length);
+    QString target;
 
     QList<Event *> events;
     EventManager::EventType type = EventManager::Invalid;
 
-    uint num = cmd.toUInt();
+    int firstParam = 0;
+    uint num = tokens.numeric();
     if (num > 0) {
         // numeric reply
-        if (params.count() == 0) {
+        if (tokens.paramCount() == 0) {
             qWarning() << "Message received from server violates RFC and is ignored!" << msg;
             return;
         }
         // numeric replies have the target as first param (RFC 2812 - 2.4). this is usually our own nick. Remove this!
-        target = net->serverDecode(params.takeFirst());
+        target = net->serverDecode(tokens.toByteArray(tokens.param(0)));
+        firstParam = 1;
         type = EventManager::IrcEventNumeric;
     }
     else {
         // any other irc command
-        QString typeName = QLatin1String("IrcEvent") + cmd.at(0).toUpper() + cmd.mid(1).toLower();
-        type = eventManager()->eventTypeByName(typeName);
-        if (type == EventManager::Invalid) {
-            type = eventManager()->eventTypeByName("IrcEventUnknown");
-            Q_ASSERT(type != EventManager::Invalid);
-        }
-        target = QString();
+        type = eventTypeByCommand(tokens.data(cmdRange), cmdRange.length);
     }
 
+    QList<QByteArray> params;
+    params.reserve(tokens.paramCount() - firstParam);
+    for (int i = firstParam; i < tokens.paramCount(); i++)
+        params << tokens.toByteArray(tokens.param(i));
+
     // Almost always, all params are server-encoded. There's a few exceptions, let's catch them here!
     // Possibly not the best option, we might want something more generic? Maybe yet another layer of
     // unencoded events with event handlers for the exceptions...
@@ -22,9 +22,9 @@
 #define IRCPARSER_H
 
 #include "coresession.h"
+#include "eventmanager.h"
 
 class Event;
-class EventManager;
 class IrcEvent;
 class NetworkDataEvent;
 
@@ -46,6 +46,9 @@ protected:
 
     bool checkParamCount(const QString &cmd, const QList<QByteArray> &params, int minParams);
 
+    //! Look up the event type for a non-numeric command, without allocating memory
+    static EventManager::EventType eventTypeByCommand(const char *cmd, int length);
+
     // no-op if we don't have crypto support!
     QByteArray decrypt(Network *network, const QString &target, const QByteArray &message, bool isTopic = false);
 
@@ -0,0 +1,142 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "irctokenizer.h"
+
+namespace {
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+}
+
+
+bool IrcTokenizer::tokenize(const char *data, int length)
+{
+    _data = data;
+    _hasPrefix = false;
+    _prefix = Range();
+    _command = Range();
+    _paramCount = 0;
+
+    // Find the trailing parameter first, since it may contain spaces.
+    // NOTE: This assumes that " :" is the same in every encoding a server might use...
+    int end = length;
+    Range trailing;
+    for (int i = 0; i + 1 < length; i++) {
+        if (data[i] == ' ' && data[i+1] == ':') {
+            end = i;
+            trailing.begin = i + 2;
+            trailing.length = length - trailing.begin;
+            break;
+        }
+    }
+
+    // Split the rest at spaces, skipping empty tokens (due to ircds sending multiple spaces in a row)
+    bool haveCommand = false;
+    int pos = 0;
+    while (pos < end) {
+        if (data[pos] == ' ') {
+            ++pos;
+            continue;
+        }
+        int tokenEnd = pos;
+        while (tokenEnd < end && data[tokenEnd] != ' ')
+            ++tokenEnd;
+
+        Range token;
+        token.begin = pos;
+        token.length = tokenEnd - pos;
+
+        if (!haveCommand) {
+            // a colon as the first char of the first token indicates the existence of a prefix
+            if (!_hasPrefix && data[pos] == ':') {
+                _hasPrefix = true;
+                _prefix.begin = pos + 1;
+                _prefix.length = token.length - 1;
+            }
+            else {
+                _command = token;
+                haveCommand = true;
+            }
+        }
+        else if (_paramCount < maxParams) {
+            _params[_paramCount++] = token;
+        }
+        else {
+            // extend the last parameter up to the end of this token
+            Range &last = _params[maxParams - 1];
+            last.length = tokenEnd - last.begin;
+        }
+        pos = tokenEnd;
+    }
+
+    if (trailing.length > 0) {
+        if (!haveCommand) {
+            // the trailing parameter takes the place of the missing token, as it always did;
+            // if that is the prefix, there is no command left
+            if (!_hasPrefix && data[trailing.begin] == ':') {
+                _hasPrefix = true;
+                _prefix.begin = trailing.begin + 1;
+                _prefix.length = trailing.length - 1;
+            }
+            else {
+                _command = trailing;
+                haveCommand = true;
+            }
+        }
+        else if (_paramCount < maxParams) {
+            _params[_paramCount++] = trailing;
+        }
+        else {
+            Range &last = _params[maxParams - 1];
+            last.length = length - last.begin;
+        }
+    }
+
+    // the parser has always trimmed the command, which matters if it came from the trailing parameter
+    // or carries stray control characters
+    while (_command.length > 0 && isSpace(data[_command.begin])) {
+        ++_command.begin;
+        --_command.length;
+    }
+    while (_command.length > 0 && isSpace(data[_command.begin + _command.length - 1]))
+        --_command.length;
+
+    return haveCommand;
+}
+
+
+uint IrcTokenizer::numeric() const
+{
+    if (_command.length == 0 || _command.length > 9)
+        return 0;
+
+    uint value = 0;
+    for (int i = 0; i < _command.length; i++) {
+        char c = _data[_command.begin + i];
+        if (c < '0' || c > '9')
+            return 0;
+        value = value * 10 + (c - '0');
+    }
+    return value;
+}
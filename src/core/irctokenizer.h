@@ -0,0 +1,69 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+
+/**
+ * Splits a raw IRC line into prefix, command and parameters without allocating any memory.
+ *
+ * Tokens are kept as byte ranges into the line, which hence must stay alive as long as the tokens are used.
+ * The splitting rules are the ones IrcParser always used: the first occurrence of " :" starts the trailing
+ * parameter (which is dropped if empty), runs of spaces don't produce empty parameters, and the command is
+ * trimmed of (ASCII) whitespace.
+ */
+class IrcTokenizer
+{
+public:
+    struct Range {
+        int begin{0};
+        int length{0};
+    };
+
+    //! More parameters than this are merged into the last one, including the separating spaces
+    static const int maxParams = 64;
+
+    //! Split the given line
+    /** \return false if the line does not contain a command
+     */
+    bool tokenize(const char *data, int length);
+    inline bool tokenize(const QByteArray &line) { return tokenize(line.constData(), line.size()); }
+
+    inline bool hasPrefix() const { return _hasPrefix; }
+    inline Range prefix() const { return _prefix; } ///< without the leading colon
+    inline Range command() const { return _command; }
+    inline int paramCount() const { return _paramCount; }
+    inline Range param(int index) const { return _params[index]; }
+
+    inline const char *data(Range range) const { return _data + range.begin; }
+    inline QByteArray toByteArray(Range range) const { return QByteArray(_data + range.begin, range.length); }
+
+    //! The value of a numeric command, or 0 if the command is not a (valid) numeric
+    uint numeric() const;
+
+private:
+    const char *_data{nullptr};
+    bool _hasPrefix{false};
+    Range _prefix;
+    Range _command;
+    Range _params[maxParams];
+    int _paramCount{0};
+};
@@ -20,6 +20,8 @@
 
 #include "postgresqlstorage.h"
 
+#include <limits>
+
 #include <QtSql>
 
 #include "logger.h"
@@ -143,6 +145,11 @@ bool PostgreSqlStorage::initDbSession(QSqlDatabase &db)
         return false;
     }
 
+    // some queries need features of newer servers, see isMultiBacklogAvailable()
+    QSqlQuery versionQuery = db.exec("SHOW server_version_num");
+    if (versionQuery.first())
+        _serverVersion = versionQuery.value(0).toInt();
+
     return true;
 }
 
@@ -1440,6 +1447,60 @@ Message::Types PostgreSqlStorage::bufferActivity(BufferId bufferId, MsgId lastSe
     return result;
 }
 
+void PostgreSqlStorage::setHighlightCount(UserId user, BufferId bufferId, int count)
+{
+    QSqlQuery query(logDb());
+    query.prepare(queryString("update_buffer_highlightcount"));
+
+    query.bindValue(":userid", user.toInt());
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":highlightcount", count);
+    safeExec(query);
+    watchQuery(query);
+}
+
+QHash<BufferId, int> PostgreSqlStorage::highlightCounts(UserId user)
+{
+    QHash<BufferId, int> highlightCountHash;
+
+    QSqlDatabase db = logDb();
+    if (!beginReadOnlyTransaction(db)) {
+        qWarning() << "PostgreSqlStorage::highlightCounts(): cannot start read only transaction!";
+        qWarning() << " -" << qPrintable(db.lastError().text());
+        return highlightCountHash;
+    }
+
+    QSqlQuery query(db);
+    query.prepare(queryString("select_buffer_highlightcounts"));
+    query.bindValue(":userid", user.toInt());
+    safeExec(query);
+    if (!watchQuery(query)) {
+        db.rollback();
+        return highlightCountHash;
+    }
+
+    while (query.next()) {
+        highlightCountHash[query.value(0).toInt()] = query.value(1).toInt();
+    }
+
+    db.commit();
+    return highlightCountHash;
+}
+
+int PostgreSqlStorage::highlightCount(BufferId bufferId, MsgId lastSeenMsgId)
+{
+    QSqlQuery query(logDb());
+    query.prepare(queryString("select_buffer_highlightcount"));
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":lastseenmsgid", lastSeenMsgId.toInt());
+    safeExec(query);
+    watchQuery(query);
+    int result = 0;
+    if (query.first())
+        result = query.value(0).toInt();
+    return result;
+}
+
 bool PostgreSqlStorage::logMessage(Message &msg)
 {
     QSqlDatabase db = logDb();
@@ -1449,29 +1510,33 @@ bool PostgreSqlStorage::logMessage(Message &msg)
         return false;
     }
 
-    QSqlQuery getSenderIdQuery = executePreparedQuery("select_senderid", msg.sender(), db);
-    int senderId;
-    if (getSenderIdQuery.first()) {
-        senderId = getSenderIdQuery.value(0).toInt();
-    }
-    else {
-        // it's possible that the sender was already added by another thread
-        // since the insert might fail we're setting a savepoint
-        savePoint("sender_sp1", db);
-        QSqlQuery addSenderQuery = executePreparedQuery("insert_sender", msg.sender(), db);
-
-        if (addSenderQuery.lastError().isValid()) {
-            rollbackSavePoint("sender_sp1", db);
-            getSenderIdQuery = executePreparedQuery("select_senderid", msg.sender(), db);
-            watchQuery(getSenderIdQuery);
-            getSenderIdQuery.first();
+    QHash<QString, int> newSenders;
+    int senderId = cachedSenderId(msg.sender());
+    if (senderId == -1) {
+        QSqlQuery getSenderIdQuery = executePreparedQuery("select_senderid", msg.sender(), db);
+        if (getSenderIdQuery.first()) {
             senderId = getSenderIdQuery.value(0).toInt();
         }
         else {
-            releaseSavePoint("sender_sp1", db);
-            addSenderQuery.first();
-            senderId = addSenderQuery.value(0).toInt();
+            // it's possible that the sender was already added by another thread
+            // since the insert might fail we're setting a savepoint
+            savePoint("sender_sp1", db);
+            QSqlQuery addSenderQuery = executePreparedQuery("insert_sender", msg.sender(), db);
+
+            if (addSenderQuery.lastError().isValid()) {
+                rollbackSavePoint("sender_sp1", db);
+                getSenderIdQuery = executePreparedQuery("select_senderid", msg.sender(), db);
+                watchQuery(getSenderIdQuery);
+                getSenderIdQuery.first();
+                senderId = getSenderIdQuery.value(0).toInt();
+            }
+            else {
+                releaseSavePoint("sender_sp1", db);
+                addSenderQuery.first();
+                senderId = addSenderQuery.value(0).toInt();
+            }
         }
+        newSenders[msg.sender()] = senderId;
     }
 
     QVariantList params;
@@ -1492,6 +1557,7 @@ bool PostgreSqlStorage::logMessage(Message &msg)
     logMessageQuery.first();
     MsgId msgId = logMessageQuery.value(0).toInt();
     db.commit();
+    cacheSenderIds(newSenders);
     if (msgId.isValid()) {
         msg.setMsgId(msgId);
         return true;
@@ -1522,6 +1588,12 @@ bool PostgreSqlStorage::logMessages(MessageList &msgs)
             continue;
         }
 
+        int cachedId = cachedSenderId(sender);
+        if (cachedId != -1) {
+            senderIdList << cachedId;
+            continue;
+        }
+
         selectSenderQuery = executePreparedQuery("select_senderid", sender, db);
         if (selectSenderQuery.first()) {
             senderIdList << selectSenderQuery.value(0).toInt();
@@ -1581,6 +1653,7 @@ bool PostgreSqlStorage::logMessages(MessageList &msgs)
     }
 
     db.commit();
+    cacheSenderIds(senderIds);
     return true;
 }
 
@@ -1650,6 +1723,132 @@ QList<Message> PostgreSqlStorage::requestMsgs(UserId user, BufferId bufferId, Ms
 }
 
 
+// Each buffer's messages are fetched through its own index range scan (LATERAL ... LIMIT), so a
+// single statement serves all buffers without walking the rest of their backlog.
+QList<Message> PostgreSqlStorage::requestMsgsMulti(UserId user, const QList<BufferId> &bufferIds, const QList<MsgId> &first, const QList<MsgId> &last, int limit)
+{
+    QList<Message> messagelist;
+    if (bufferIds.isEmpty())
+        return messagelist;
+
+    QStringList bufferIdList, firstList, lastList;
+    for (int i = 0; i < bufferIds.count(); i++) {
+        MsgId lastMsg = last.value(i, -1);
+        bufferIdList << QString::number(bufferIds.at(i).toInt());
+        firstList << QString::number(first.value(i, -1).toInt());
+        lastList << QString::number(lastMsg == -1 ? std::numeric_limits<int>::max() : lastMsg.toInt());
+    }
+
+    QSqlDatabase db = logDb();
+    if (!beginReadOnlyTransaction(db)) {
+        qWarning() << "PostgreSqlStorage::requestMsgsMulti(): cannot start read only transaction!";
+        qWarning() << " -" << qPrintable(db.lastError().text());
+        return messagelist;
+    }
+
+    QVariantList params;
+    params << user.toInt();
+    params << QString("{%1}").arg(bufferIdList.join(","));
+    params << QString("{%1}").arg(firstList.join(","));
+    params << QString("{%1}").arg(lastList.join(","));
+    if (limit != -1)
+        params << limit;
+    else
+        params << QVariant(QVariant::Int);
+
+    QSqlQuery query = executePreparedQuery("select_messagesMulti", params, db);
+    if (!watchQuery(query)) {
+        qDebug() << "select_messagesMulti failed";
+        db.rollback();
+        return messagelist;
+    }
+
+    BufferInfo bufferInfo;
+    QDateTime timestamp;
+    while (query.next()) {
+        if (bufferInfo.bufferId() != query.value(7).toInt())
+            bufferInfo = BufferInfo(query.value(7).toInt(), query.value(8).toInt(), (BufferInfo::Type)query.value(9).toInt(), 0, query.value(10).toString());
+
+        timestamp = query.value(1).toDateTime();
+        timestamp.setTimeSpec(Qt::UTC);
+        Message msg(timestamp,
+            bufferInfo,
+            (Message::Type)query.value(2).toUInt(),
+            query.value(6).toString(),
+            query.value(4).toString(),
+            query.value(5).toString(),
+            (Message::Flags)query.value(3).toUInt());
+        msg.setMsgId(query.value(0).toInt());
+        messagelist << msg;
+    }
+
+    db.commit();
+    return messagelist;
+}
+
+
+// select_messagesMulti uses LATERAL and a multi-argument unnest() WITH ORDINALITY, both added in PostgreSQL 9.4
+bool PostgreSqlStorage::isMultiBacklogAvailable()
+{
+    return _serverVersion >= 90400;
+}
+
+
+QList<Message> PostgreSqlStorage::requestMsgsByTime(UserId user, BufferId bufferId, const QDateTime &start, const QDateTime &end, Message::Types types, int limit)
+{
+    QList<Message> messagelist;
+
+    QSqlDatabase db = logDb();
+    if (!beginReadOnlyTransaction(db)) {
+        qWarning() << "PostgreSqlStorage::requestMsgsByTime(): cannot start read only transaction!";
+        qWarning() << " -" << qPrintable(db.lastError().text());
+        return messagelist;
+    }
+
+    BufferInfo bufferInfo = getBufferInfo(user, bufferId);
+    if (!bufferInfo.isValid()) {
+        db.rollback();
+        return messagelist;
+    }
+
+    QVariantList params;
+    params << bufferId.toInt();
+    params << (start.isValid() ? start.toUTC() : QDateTime::fromMSecsSinceEpoch(0, Qt::UTC));
+    params << (end.isValid() ? end.toUTC() : QDateTime(QDate(9999, 12, 31), QTime(23, 59, 59), Qt::UTC));
+    params << (int)types;
+    // LIMIT rejects negative values, NULL means no limit
+    if (limit >= 0)
+        params << limit;
+    else
+        params << QVariant(QVariant::Int);
+
+    QSqlQuery query = executePreparedQuery("select_messagesByTime", params, db);
+    if (!watchQuery(query)) {
+        qDebug() << "select_messagesByTime failed";
+        db.rollback();
+        return messagelist;
+    }
+
+    QDateTime timestamp;
+    while (query.next()) {
+        timestamp = query.value(1).toDateTime();
+        timestamp.setTimeSpec(Qt::UTC);
+        Message msg(timestamp,
+            bufferInfo,
+            (Message::Type)query.value(2).toUInt(),
+            query.value(6).toString(),
+            query.value(4).toString(),
+            query.value(5).toString(),
+            (Message::Flags)query.value(3).toUInt());
+        msg.setMsgId(query.value(0).toInt());
+        messagelist << msg;
+    }
+
+    db.commit();
+    return messagelist;
+}
+
+
 QList<Message> PostgreSqlStorage::requestAllMsgs(UserId user, MsgId first, MsgId last, int limit)
 {
     QList<Message> messagelist;
@@ -1703,6 +1902,65 @@ QList<Message> PostgreSqlStorage::requestAllMsgs(UserId user, MsgId first, MsgId
 }
 
 
+QList<Message> PostgreSqlStorage::searchMsgs(UserId user, const QString &text, BufferId bufferId, NetworkId networkId, const QString &sender, const QDateTime &from, const QDateTime &to, MsgId last, int limit)
+{
+    QList<Message> messagelist;
+    if (text.trimmed().isEmpty())
+        return messagelist;
+
+    // requestBuffers uses it's own transaction.
+    QHash<BufferId, BufferInfo> bufferInfoHash;
+    foreach(BufferInfo bufferInfo, requestBuffers(user)) {
+        bufferInfoHash[bufferInfo.bufferId()] = bufferInfo;
+    }
+
+    QSqlDatabase db = logDb();
+    if (!beginReadOnlyTransaction(db)) {
+        qWarning() << "PostgreSqlStorage::searchMsgs(): cannot start read only transaction!";
+        qWarning() << " -" << qPrintable(db.lastError().text());
+        return messagelist;
+    }
+
+    QSqlQuery query(db);
+    query.prepare(queryString("select_messagesSearch"));
+    query.bindValue(":userid", user.toInt());
+    query.bindValue(":query", text);
+    query.bindValue(":bufferid", bufferId.isValid() ? bufferId.toInt() : -1);
+    query.bindValue(":networkid", networkId.isValid() ? networkId.toInt() : -1);
+    query.bindValue(":sender", sender.toLower());
+    query.bindValue(":fromtime", from.isValid() ? from.toUTC() : QDateTime::fromMSecsSinceEpoch(0, Qt::UTC));
+    query.bindValue(":totime", to.isValid() ? to.toUTC() : QDateTime(QDate(9999, 12, 31), QTime(23, 59, 59), Qt::UTC));
+    query.bindValue(":lastmsg", last == -1 ? std::numeric_limits<int>::max() : last.toInt());
+    if (limit != -1)
+        query.bindValue(":limit", limit);
+    else
+        query.bindValue(":limit", QVariant(QVariant::Int));
+    safeExec(query);
+    if (!watchQuery(query)) {
+        db.rollback();
+        return messagelist;
+    }
+
+    QDateTime timestamp;
+    while (query.next()) {
+        timestamp = query.value(2).toDateTime();
+        timestamp.setTimeSpec(Qt::UTC);
+        Message msg(timestamp,
+            bufferInfoHash[query.value(1).toInt()],
+            (Message::Type)query.value(3).toUInt(),
+            query.value(7).toString(),
+            query.value(5).toString(),
+            query.value(6).toString(),
+            (Message::Flags)query.value(4).toUInt());
+        msg.setMsgId(query.value(0).toInt());
+        messagelist << msg;
+    }
+
+    db.commit();
+    return messagelist;
+}
+
+
 QMap<UserId, QString> PostgreSqlStorage::getAllAuthUserNames()
 {
     QMap<UserId, QString> authusernames;
@@ -2064,8 +2322,9 @@ bool PostgreSqlMigrationWriter::writeMo(const BufferMO &buffer)
     bindValue(8, buffer.lastseenmsgid);
     bindValue(9, buffer.markerlinemsgid);
     bindValue(10, buffer.bufferactivity);
-    bindValue(11, buffer.key);
-    bindValue(12, buffer.joined);
+    bindValue(11, buffer.highlightcount);
+    bindValue(12, buffer.key);
+    bindValue(13, buffer.joined);
     return exec();
 }
 
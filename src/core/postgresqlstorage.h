@@ -98,12 +98,19 @@ public slots:
     void setBufferActivity(UserId id, BufferId bufferId, Message::Types type) override;
     QHash<BufferId, Message::Types> bufferActivities(UserId id) override;
     Message::Types bufferActivity(BufferId bufferId, MsgId lastSeenMsgId) override;
+    void setHighlightCount(UserId id, BufferId bufferId, int count) override;
+    QHash<BufferId, int> highlightCounts(UserId id) override;
+    int highlightCount(BufferId bufferId, MsgId lastSeenMsgId) override;
 
     /* Message handling */
     bool logMessage(Message &msg) override;
     bool logMessages(MessageList &msgs) override;
     QList<Message> requestMsgs(UserId user, BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1) override;
+    QList<Message> requestMsgsMulti(UserId user, const QList<BufferId> &bufferIds, const QList<MsgId> &first, const QList<MsgId> &last, int limit = -1) override;
+    bool isMultiBacklogAvailable() override;
+    QList<Message> requestMsgsByTime(UserId user, BufferId bufferId, const QDateTime &start, const QDateTime &end, Message::Types types = 0, int limit = -1) override;
     QList<Message> requestAllMsgs(UserId user, MsgId first = -1, MsgId last = -1, int limit = -1) override;
+    QList<Message> searchMsgs(UserId user, const QString &text, BufferId bufferId, NetworkId networkId, const QString &sender, const QDateTime &from, const QDateTime &to, MsgId last = -1, int limit = -1) override;
 
     /* Sysident handling */
     QMap<UserId, QString> getAllAuthUserNames() override;
@@ -145,6 +152,7 @@ private:
     QString _databaseName;
     QString _userName;
     QString _password;
+    int _serverVersion{0};  ///< as in server_version_num, e.g. 90400 for 9.4.0
 };
 
 
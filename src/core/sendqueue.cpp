@@ -0,0 +1,180 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "sendqueue.h"
+
+SendQueue::SendQueue()
+{
+    _clock.start();
+}
+
+
+void SendQueue::enqueue(const QByteArray &line, Priority priority, const QByteArray &target, bool prepend)
+{
+    Entry entry;
+    entry.line = line;
+    entry.queuedAt = _clock.elapsed();
+    insert(entry, priority, target, prepend);
+
+    _size++;
+    Stats &stats = _stats[priority];
+    stats.depth++;
+    if (stats.depth > stats.maxDepth)
+        stats.maxDepth = stats.depth;
+}
+
+
+void SendQueue::insert(const Entry &entry, Priority priority, const QByteArray &target, bool prepend)
+{
+    // everything but lines that are meant to go out right away waits for a pending barrier
+    if (_hasBarrier && !prepend) {
+        HeldEntry held;
+        held.entry = entry;
+        held.priority = priority;
+        held.target = target;
+        _held << held;
+        return;
+    }
+
+    QList<Entry> *queue;
+    switch (priority) {
+    case Control:
+        queue = &_control;
+        break;
+    case Bulk:
+        queue = &_bulk;
+        break;
+    case Barrier:
+        _hasBarrier = true;
+        _barrier = entry;
+        return;
+    default:
+        queue = &_interactive[target];
+        if (queue->isEmpty()) {
+            if (prepend)
+                _targets.prepend(target);
+            else
+                _targets.append(target);
+        }
+        else if (prepend) {
+            _targets.removeOne(target);
+            _targets.prepend(target);
+        }
+        break;
+    }
+
+    if (prepend)
+        queue->prepend(entry);
+    else
+        queue->append(entry);
+}
+
+
+QByteArray SendQueue::takeNext()
+{
+    if (!_control.isEmpty()) {
+        Entry entry = _control.takeFirst();
+        taken(Control, entry);
+        return entry.line;
+    }
+
+    if (!_targets.isEmpty()) {
+        QByteArray target = _targets.takeFirst();
+        QList<Entry> &queue = _interactive[target];
+        Entry entry = queue.takeFirst();
+        if (queue.isEmpty())
+            _interactive.remove(target);
+        else
+            _targets.append(target); // back of the line for the next round
+        taken(Interactive, entry);
+        return entry.line;
+    }
+
+    if (!_bulk.isEmpty()) {
+        Entry entry = _bulk.takeFirst();
+        taken(Bulk, entry);
+        return entry.line;
+    }
+
+    if (_hasBarrier) {
+        Entry entry = _barrier;
+        _hasBarrier = false;
+
+        // the lines held back may contain the next barrier, which holds back the rest again
+        QList<HeldEntry> held;
+        held.swap(_held);
+        foreach(const HeldEntry &heldEntry, held) {
+            insert(heldEntry.entry, heldEntry.priority, heldEntry.target, false);
+        }
+        taken(Barrier, entry);
+        return entry.line;
+    }
+
+    return QByteArray();
+}
+
+
+void SendQueue::clear()
+{
+    _control.clear();
+    _bulk.clear();
+    _interactive.clear();
+    _targets.clear();
+    _hasBarrier = false;
+    _held.clear();
+    _size = 0;
+    for (int i = Control; i <= Barrier; i++)
+        _stats[i].depth = 0;
+}
+
+
+QVariantMap SendQueue::statsMap() const
+{
+    static const char *names[] = { "Control", "Interactive", "Bulk", "Barrier" };
+
+    QVariantMap map;
+    for (int i = Control; i <= Barrier; i++) {
+        const Stats &s = _stats[i];
+        QVariantMap classMap;
+        classMap["Depth"] = s.depth;
+        classMap["MaxDepth"] = s.maxDepth;
+        classMap["Sent"] = s.sent;
+        classMap["LastWait"] = s.lastWait;
+        classMap["MaxWait"] = s.maxWait;
+        classMap["AverageWait"] = s.sent ? s.totalWait / (qint64)s.sent : 0;
+        map[names[i]] = classMap;
+    }
+    return map;
+}
+
+
+void SendQueue::taken(Priority priority, const Entry &entry)
+{
+    qint64 wait = _clock.elapsed() - entry.queuedAt;
+
+    _size--;
+    Stats &stats = _stats[priority];
+    stats.depth--;
+    stats.sent++;
+    stats.lastWait = wait;
+    stats.totalWait += wait;
+    if (wait > stats.maxWait)
+        stats.maxWait = wait;
+}
@@ -0,0 +1,115 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QVariantMap>
+
+/**
+ * Outgoing line queue of a network, used while the token bucket is empty.
+ *
+ * Lines are queued in one of three classes, which are served in strict priority order:
+ * control traffic (PING/PONG, capability negotiation and registration) first, then interactive
+ * user input, and bulk traffic (auto-WHO, perform lists) only when nothing else is waiting.
+ * Interactive lines are queued per target and served round-robin, so a long paste to one
+ * channel or query doesn't hold back messages to other targets.
+ *
+ * A barrier line (QUIT) keeps its place in the overall order instead: it is sent once everything
+ * queued before it is out, and lines queued after it wait until it has been sent.
+ *
+ * The queue only decides the order of lines; rate limiting is still up to the token bucket of
+ * CoreNetwork.
+ */
+class SendQueue
+{
+public:
+    enum Priority {
+        Control,
+        Interactive,
+        Bulk,
+        Barrier
+    };
+
+    struct Stats {
+        int depth{0};          ///< Lines currently queued
+        int maxDepth{0};       ///< Highest queue depth seen so far
+        quint64 sent{0};       ///< Lines taken from the queue
+        qint64 lastWait{0};    ///< Time the last line spent in the queue, in ms
+        qint64 maxWait{0};     ///< Longest time a line spent in the queue, in ms
+        qint64 totalWait{0};   ///< Sum of all wait times, in ms
+    };
+
+    SendQueue();
+
+    /**
+     * Queue a line for sending.
+     *
+     * @param line     The encoded line, without CRLF
+     * @param priority The class to queue the line in
+     * @param target   For interactive lines, the (lowercased) target to queue the line for
+     * @param prepend  If true, the line jumps to the front of its class (and target), and ahead
+     *                 of a pending barrier
+     */
+    void enqueue(const QByteArray &line, Priority priority, const QByteArray &target = QByteArray(), bool prepend = false);
+
+    //! Remove and return the next line to send, or a null QByteArray if the queue is empty
+    QByteArray takeNext();
+
+    inline bool isEmpty() const { return _size == 0; }
+    inline int size() const { return _size; }
+
+    //! Drop all queued lines, e.g. on disconnect. Statistics are kept.
+    void clear();
+
+    inline const Stats &stats(Priority priority) const { return _stats[priority]; }
+    QVariantMap statsMap() const;
+
+private:
+    struct Entry {
+        QByteArray line;
+        qint64 queuedAt;
+    };
+
+    struct HeldEntry {
+        Entry entry;
+        Priority priority;
+        QByteArray target;
+    };
+
+    void insert(const Entry &entry, Priority priority, const QByteArray &target, bool prepend);
+    void taken(Priority priority, const Entry &entry);
+
+    QList<Entry> _control;
+    QList<Entry> _bulk;
+    QHash<QByteArray, QList<Entry> > _interactive;
+    QList<QByteArray> _targets;  ///< Round-robin order of targets with queued lines
+
+    bool _hasBarrier{false};
+    Entry _barrier;
+    QList<HeldEntry> _held;      ///< Lines queued after the barrier, in order
+
+    int _size{0};
+    Stats _stats[Barrier + 1];
+    QElapsedTimer _clock;
+};
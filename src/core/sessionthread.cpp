@@ -20,6 +20,7 @@
 
 #include "core.h"
 #include "coresession.h"
+#include "event.h"
 #include "internalpeer.h"
 #include "remotepeer.h"
 #include "sessionthread.h"
@@ -127,4 +128,8 @@ void SessionThread::run()
     emit initialized();
     exec();
     delete _session;
+
+    Event::PoolStats stats = Event::poolStats();
+    qDebug() << "Event pool statistics for user" << user().toInt() << "- allocations:" << stats.allocations
+             << "reused:" << stats.reused << "releases:" << stats.releases << "pooled:" << stats.pooled;
 }
@@ -20,6 +20,8 @@
 
 #include "sqlitestorage.h"
 
+#include <limits>
+
 #include <QtSql>
 
 #include "logger.h"
@@ -29,7 +31,12 @@
 int SqliteStorage::_maxRetryCount = 150;
 
 SqliteStorage::SqliteStorage(QObject *parent)
-    : AbstractSqlStorage(parent)
+    : AbstractSqlStorage(parent),
+    _useWal(true),
+    _walMode(false),
+    _journalModeChecked(false),
+    _fts5Available(false),
+    _busyTimeout(10000)
 {
 }
 
@@ -70,6 +77,83 @@ QString SqliteStorage::description() const
 }
 
 
+void SqliteStorage::setConnectionProperties(const QVariantMap &properties)
+{
+    // not part of setupData(), but can be set in the core config for tuning
+    _useWal = properties.value("WalMode", true).toBool();
+    _busyTimeout = properties.value("BusyTimeout", 10000).toInt();
+}
+
+
+bool SqliteStorage::initDbSession(QSqlDatabase &db)
+{
+    // let SQLite wait for locks itself instead of failing right away with SQLITE_BUSY
+    db.exec(QString("PRAGMA busy_timeout = %1").arg(_busyTimeout));
+
+    // the journal mode is persistent, so this only changes something for the first connection
+    QSqlQuery query = db.exec(QString("PRAGMA journal_mode = %1").arg(_useWal ? "WAL" : "DELETE"));
+
+    // The locking scheme is decided once by the first connection, which is opened during storage
+    // initialization before any session threads exist. Later connections must not change it while
+    // other threads are inside lockForRead()/unlock().
+    if (_journalModeChecked)
+        return true;
+
+    _journalModeChecked = true;
+    if (query.first()) {
+        bool walMode = query.value(0).toString().toLower() == "wal";
+        if (_useWal && !walMode)
+            quWarning() << "Unable to enable WAL mode for" << displayName() << "(journal mode is" << query.value(0).toString() << "), falling back to exclusive locking";
+        _walMode = walMode;
+    }
+
+    // the full-text index is optional, as not every build of SQLite includes FTS5
+    query = db.exec("SELECT sqlite_compileoption_used('ENABLE_FTS5')");
+    _fts5Available = query.first() && query.value(0).toInt() == 1;
+    if (!_fts5Available)
+        quWarning() << "SQLite was built without FTS5, backlog search is not available";
+    return true;
+}
+
+
+bool SqliteStorage::initOptionalSchema()
+{
+    // only used when there is a singlethread (during startup)
+    // so we don't need locking here
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    QStringList queryNames;
+    if (_fts5Available) {
+        // the index falls behind whenever the database was used by a build without FTS5
+        QSqlQuery query = db.exec(queryString("select_backlog_fts_objects"));
+        bool complete = query.first() && query.value(0).toInt() == 3;
+        query.finish();
+
+        queryNames << "create_backlog_fts" << "create_trigger_backlog_fts_insert" << "create_trigger_backlog_fts_delete";
+        if (!complete) {
+            quInfo() << "Building the backlog search index, this may take a while...";
+            queryNames << "rebuild_backlog_fts";
+        }
+    }
+    else {
+        // a database indexed by a build with FTS5 still has the triggers, without FTS5 they make every insert fail
+        queryNames << "drop_trigger_backlog_fts_insert" << "drop_trigger_backlog_fts_delete";
+    }
+
+    foreach(const QString &queryName, queryNames) {
+        QSqlQuery query = db.exec(queryString(queryName));
+        if (!watchQuery(query)) {
+            qCritical() << "SqliteStorage::initOptionalSchema(): Unable to set up the backlog search index!";
+            db.rollback();
+            return false;
+        }
+    }
+    db.commit();
+    return true;
+}
+
+
 int SqliteStorage::installedSchemaVersion()
 {
     // only used when there is a singlethread (during startup)
@@ -452,7 +536,8 @@ bool SqliteStorage::updateIdentity(UserId user, const CoreIdentity &identity)
         checkQuery.prepare(queryString("select_checkidentity"));
         checkQuery.bindValue(":identityid", identity.id().toInt());
         checkQuery.bindValue(":userid", user.toInt());
-        lockForRead();
+        // we're going to write, and a read transaction can't be upgraded safely in WAL mode
+        lockForWrite();
         safeExec(checkQuery);
 
         // there should be exactly one identity for the given id and user
@@ -526,7 +611,8 @@ void SqliteStorage::removeIdentity(UserId user, IdentityId identityId)
         checkQuery.prepare(queryString("select_checkidentity"));
         checkQuery.bindValue(":identityid", identityId.toInt());
         checkQuery.bindValue(":userid", user.toInt());
-        lockForRead();
+        // we're going to write, and a read transaction can't be upgraded safely in WAL mode
+        lockForWrite();
         safeExec(checkQuery);
 
         // there should be exactly one identity for the given id and user
@@ -1142,8 +1228,7 @@ BufferInfo SqliteStorage::bufferInfo(UserId user, const NetworkId &networkId, Bu
 
     BufferInfo bufferInfo;
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("select_bufferByName"));
+        QSqlQuery query = cachedQuery("select_bufferByName", db);
         query.bindValue(":networkid", networkId.toInt());
         query.bindValue(":userid", user.toInt());
         query.bindValue(":buffercname", buffer.toLower());
@@ -1165,21 +1250,33 @@ BufferInfo SqliteStorage::bufferInfo(UserId user, const NetworkId &networkId, Bu
         }
         else if (create) {
             // let's create the buffer
-            QSqlQuery createQuery(db);
-            createQuery.prepare(queryString("insert_buffer"));
-            createQuery.bindValue(":userid", user.toInt());
-            createQuery.bindValue(":networkid", networkId.toInt());
-            createQuery.bindValue(":buffertype", (int)type);
-            createQuery.bindValue(":buffername", buffer);
-            createQuery.bindValue(":buffercname", buffer.toLower());
-            createQuery.bindValue(":joined", type & BufferInfo::ChannelBuffer ? 1 : 0);
-
+            // in WAL mode our read snapshot might be outdated by now, so we have to start over
+            // with a write transaction and check again
+            query.finish();
+            db.commit();
             unlock();
             lockForWrite();
-            safeExec(createQuery);
-            watchQuery(createQuery);
-            bufferInfo = BufferInfo(createQuery.lastInsertId().toInt(), networkId, type, 0, buffer);
+            db.transaction();
+            safeExec(query);
+            if (query.first()) {
+                bufferInfo = BufferInfo(query.value(0).toInt(), networkId, (BufferInfo::Type)query.value(1).toInt(), 0, buffer);
+            }
+            else {
+                QSqlQuery createQuery = cachedQuery("insert_buffer", db);
+                createQuery.bindValue(":userid", user.toInt());
+                createQuery.bindValue(":networkid", networkId.toInt());
+                createQuery.bindValue(":buffertype", (int)type);
+                createQuery.bindValue(":buffername", buffer);
+                createQuery.bindValue(":buffercname", buffer.toLower());
+                createQuery.bindValue(":joined", type & BufferInfo::ChannelBuffer ? 1 : 0);
+
+                safeExec(createQuery);
+                watchQuery(createQuery);
+                bufferInfo = BufferInfo(createQuery.lastInsertId().toInt(), networkId, type, 0, buffer);
+            }
         }
+        // the statement is cached, so release its read lock explicitly
+        query.finish();
     }
     db.commit();
     unlock();
@@ -1360,7 +1457,8 @@ bool SqliteStorage::mergeBuffersPermanently(const UserId &user, const BufferId &
         checkQuery.bindValue(":newbufferid", bufferId1.toInt());
         checkQuery.bindValue(":userid", user.toInt());
 
-        lockForRead();
+        // we're going to write, and a read transaction can't be upgraded safely in WAL mode
+        lockForWrite();
         safeExec(checkQuery);
         error = (!checkQuery.first() || checkQuery.value(0).toInt() != 2);
     }
@@ -1410,8 +1508,7 @@ void SqliteStorage::setBufferLastSeenMsg(UserId user, const BufferId &bufferId,
     db.transaction();
 
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("update_buffer_lastseen"));
+        QSqlQuery query = cachedQuery("update_buffer_lastseen", db);
         query.bindValue(":userid", user.toInt());
         query.bindValue(":bufferid", bufferId.toInt());
         query.bindValue(":lastseenmsgid", msgId.toInt());
@@ -1460,8 +1557,7 @@ void SqliteStorage::setBufferMarkerLineMsg(UserId user, const BufferId &bufferId
     db.transaction();
 
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("update_buffer_markerlinemsgid"));
+        QSqlQuery query = cachedQuery("update_buffer_markerlinemsgid", db);
         query.bindValue(":userid", user.toInt());
         query.bindValue(":bufferid", bufferId.toInt());
         query.bindValue(":markerlinemsgid", msgId.toInt());
@@ -1509,8 +1605,7 @@ void SqliteStorage::setBufferActivity(UserId user, BufferId bufferId, Message::T
     db.transaction();
 
     {
-        QSqlQuery query(db);
-        query.prepare(queryString("update_buffer_bufferactivity"));
+        QSqlQuery query = cachedQuery("update_buffer_bufferactivity", db);
         query.bindValue(":userid", user.toInt());
         query.bindValue(":bufferid", bufferId.toInt());
         query.bindValue(":bufferactivity", (int) bufferActivity);
@@ -1576,40 +1671,103 @@ Message::Types SqliteStorage::bufferActivity(BufferId bufferId, MsgId lastSeenMs
     return result;
 }
 
+
+void SqliteStorage::setHighlightCount(UserId user, BufferId bufferId, int count)
+{
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    {
+        QSqlQuery query = cachedQuery("update_buffer_highlightcount", db);
+        query.bindValue(":userid", user.toInt());
+        query.bindValue(":bufferid", bufferId.toInt());
+        query.bindValue(":highlightcount", count);
+
+        lockForWrite();
+        safeExec(query);
+        watchQuery(query);
+    }
+    db.commit();
+    unlock();
+}
+
+
+QHash<BufferId, int> SqliteStorage::highlightCounts(UserId user)
+{
+    QHash<BufferId, int> highlightCountHash;
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    bool error = false;
+    {
+        QSqlQuery query(db);
+        query.prepare(queryString("select_buffer_highlightcounts"));
+        query.bindValue(":userid", user.toInt());
+
+        lockForRead();
+        safeExec(query);
+        error = !watchQuery(query);
+        if (!error) {
+            while (query.next()) {
+                highlightCountHash[query.value(0).toInt()] = query.value(1).toInt();
+            }
+        }
+    }
+
+    db.commit();
+    unlock();
+    return highlightCountHash;
+}
+
+
+int SqliteStorage::highlightCount(BufferId bufferId, MsgId lastSeenMsgId)
+{
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    int result = 0;
+    {
+        QSqlQuery query(db);
+        query.prepare(queryString("select_buffer_highlightcount"));
+        query.bindValue(":bufferid", bufferId.toInt());
+        query.bindValue(":lastseenmsgid", lastSeenMsgId.toInt());
+
+        lockForRead();
+        safeExec(query);
+        if (query.first())
+            result = query.value(0).toInt();
+    }
+
+    db.commit();
+    unlock();
+    return result;
+}
+
 bool SqliteStorage::logMessage(Message &msg)
 {
     QSqlDatabase db = logDb();
     db.transaction();
 
     bool error = false;
+    QHash<QString, int> newSenders;
     {
-        QSqlQuery logMessageQuery(db);
-        logMessageQuery.prepare(queryString("insert_message"));
+        QSqlQuery logMessageQuery = cachedQuery("insert_message", db);
 
         logMessageQuery.bindValue(":time", msg.timestamp().toTime_t());
         logMessageQuery.bindValue(":bufferid", msg.bufferInfo().bufferId().toInt());
         logMessageQuery.bindValue(":type", msg.type());
         logMessageQuery.bindValue(":flags", (int)msg.flags());
-        logMessageQuery.bindValue(":sender", msg.sender());
         logMessageQuery.bindValue(":senderprefixes", msg.senderPrefixes());
         logMessageQuery.bindValue(":message", msg.contents());
 
         lockForWrite();
-        safeExec(logMessageQuery);
-
-        if (logMessageQuery.lastError().isValid()) {
-            // constraint violation - must be NOT NULL constraint - probably the sender is missing...
-            if (logMessageQuery.lastError().number() == 19) {
-                QSqlQuery addSenderQuery(db);
-                addSenderQuery.prepare(queryString("insert_sender"));
-                addSenderQuery.bindValue(":sender", msg.sender());
-                safeExec(addSenderQuery);
-                safeExec(logMessageQuery);
-                error = !watchQuery(logMessageQuery);
-            }
-            else {
-                watchQuery(logMessageQuery);
-            }
+        int senderId = resolveSenderId(db, msg.sender(), newSenders);
+        error = senderId == -1;
+        if (!error) {
+            logMessageQuery.bindValue(":senderid", senderId);
+            safeExec(logMessageQuery);
+            error = !watchQuery(logMessageQuery);
         }
         if (!error) {
             MsgId msgId = logMessageQuery.lastInsertId().toInt();
@@ -1627,6 +1785,7 @@ bool SqliteStorage::logMessage(Message &msg)
     }
     else {
         db.commit();
+        cacheSenderIds(newSenders);
     }
 
     unlock();
@@ -1639,26 +1798,22 @@ bool SqliteStorage::logMessages(MessageList &msgs)
     QSqlDatabase db = logDb();
     db.transaction();
 
-    {
-        QSet<QString> senders;
-        QSqlQuery addSenderQuery(db);
-        addSenderQuery.prepare(queryString("insert_sender"));
-        lockForWrite();
-        for (int i = 0; i < msgs.count(); i++) {
-            const QString &sender = msgs.at(i).sender();
-            if (senders.contains(sender))
-                continue;
-            senders << sender;
-
-            addSenderQuery.bindValue(":sender", sender);
-            safeExec(addSenderQuery);
+    QList<int> senderIdList;
+    QHash<QString, int> newSenders;
+    bool error = false;
+    lockForWrite();
+    for (int i = 0; i < msgs.count(); i++) {
+        int senderId = resolveSenderId(db, msgs.at(i).sender(), newSenders);
+        if (senderId == -1) {
+            error = true;
+            break;
         }
+        senderIdList << senderId;
     }
 
-    bool error = false;
-    {
-        QSqlQuery logMessageQuery(db);
-        logMessageQuery.prepare(queryString("insert_message"));
+    // yes we loop twice over the same list. This avoids alternating queries.
+    if (!error) {
+        QSqlQuery logMessageQuery = cachedQuery("insert_message", db);
         for (int i = 0; i < msgs.count(); i++) {
             Message &msg = msgs[i];
 
@@ -1666,7 +1821,7 @@ bool SqliteStorage::logMessages(MessageList &msgs)
             logMessageQuery.bindValue(":bufferid", msg.bufferInfo().bufferId().toInt());
             logMessageQuery.bindValue(":type", msg.type());
             logMessageQuery.bindValue(":flags", (int)msg.flags());
-            logMessageQuery.bindValue(":sender", msg.sender());
+            logMessageQuery.bindValue(":senderid", senderIdList.at(i));
             logMessageQuery.bindValue(":senderprefixes", msg.senderPrefixes());
             logMessageQuery.bindValue(":message", msg.contents());
 
@@ -1692,11 +1847,49 @@ bool SqliteStorage::logMessages(MessageList &msgs)
     else {
         db.commit();
         unlock();
+        cacheSenderIds(newSenders);
     }
     return !error;
 }
 
 
+// must be called with the write lock held and a transaction opened on db
+int SqliteStorage::resolveSenderId(QSqlDatabase &db, const QString &sender, QHash<QString, int> &newSenders)
+{
+    // senders of the current transaction can't be in the shared cache yet
+    QHash<QString, int>::const_iterator iter = newSenders.constFind(sender);
+    if (iter != newSenders.constEnd())
+        return iter.value();
+
+    int senderId = cachedSenderId(sender);
+    if (senderId != -1)
+        return senderId;
+
+    QSqlQuery selectSenderQuery = cachedQuery("select_senderid", db);
+    selectSenderQuery.bindValue(":sender", sender);
+    safeExec(selectSenderQuery);
+    if (!watchQuery(selectSenderQuery))
+        return -1;
+
+    bool found = selectSenderQuery.first();
+    if (found)
+        senderId = selectSenderQuery.value(0).toInt();
+    selectSenderQuery.finish();
+
+    if (!found) {
+        QSqlQuery addSenderQuery = cachedQuery("insert_sender", db);
+        addSenderQuery.bindValue(":sender", sender);
+        safeExec(addSenderQuery);
+        if (!watchQuery(addSenderQuery))
+            return -1;
+        senderId = addSenderQuery.lastInsertId().toInt();
+    }
+
+    newSenders[sender] = senderId;
+    return senderId;
+}
+
+
 QList<Message> SqliteStorage::requestMsgs(UserId user, BufferId bufferId, MsgId first, MsgId last, int limit)
 {
     QList<Message> messagelist;
@@ -1704,72 +1897,213 @@ QList<Message> SqliteStorage::requestMsgs(UserId user, BufferId bufferId, MsgId
     QSqlDatabase db = logDb();
     db.transaction();
 
-    bool error = false;
+    lockForRead();
+    if (!fetchMsgs(db, user, bufferId, first, last, limit, messagelist)) {
+        db.rollback();
+        unlock();
+        return messagelist;
+    }
+    db.commit();
+    unlock();
+
+    return messagelist;
+}
+
+
+// SQLite runs in-process, so there is no round trip to save by merging the buffers into one
+// statement; we just answer them all within one transaction using the cached per-buffer queries.
+QList<Message> SqliteStorage::requestMsgsMulti(UserId user, const QList<BufferId> &bufferIds, const QList<MsgId> &first, const QList<MsgId> &last, int limit)
+{
+    QList<Message> messagelist;
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    lockForRead();
+    for (int i = 0; i < bufferIds.count(); i++) {
+        // buffers that don't exist (anymore) are simply skipped
+        fetchMsgs(db, user, bufferIds.at(i), first.value(i, -1), last.value(i, -1), limit, messagelist);
+    }
+    db.commit();
+    unlock();
+
+    return messagelist;
+}
+
+
+// must be called within a transaction, with the lock held for reading
+bool SqliteStorage::fetchMsgs(QSqlDatabase &db, UserId user, BufferId bufferId, MsgId first, MsgId last, int limit, QList<Message> &messagelist)
+{
+    BufferInfo bufferInfo = selectBufferInfo(db, user, bufferId);
+    if (!bufferInfo.isValid())
+        return false;
+
+    QSqlQuery query(db);
+    if (last == -1 && first == -1) {
+        query = cachedQuery("select_messagesNewestK", db);
+    }
+    else if (last == -1) {
+        query = cachedQuery("select_messagesNewerThan", db);
+        query.bindValue(":firstmsg", first.toInt());
+    }
+    else {
+        query = cachedQuery("select_messagesRange", db);
+        query.bindValue(":lastmsg", last.toInt());
+        query.bindValue(":firstmsg", first.toInt());
+    }
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":limit", limit);
+
+    safeExec(query);
+    watchQuery(query);
+    readMessages(query, bufferInfo, messagelist);
+    return true;
+}
+
+
+// must be called within a transaction, with the lock held for reading
+BufferInfo SqliteStorage::selectBufferInfo(QSqlDatabase &db, UserId user, BufferId bufferId)
+{
+    // code dupication from getBufferInfo:
+    // this is due to the impossibility of nesting transactions and recursive locking
     BufferInfo bufferInfo;
-    {
-        // code dupication from getBufferInfo:
-        // this is due to the impossibility of nesting transactions and recursive locking
-        QSqlQuery bufferInfoQuery(db);
-        bufferInfoQuery.prepare(queryString("select_buffer_by_id"));
-        bufferInfoQuery.bindValue(":userid", user.toInt());
-        bufferInfoQuery.bindValue(":bufferid", bufferId.toInt());
+    QSqlQuery bufferInfoQuery = cachedQuery("select_buffer_by_id", db);
+    bufferInfoQuery.bindValue(":userid", user.toInt());
+    bufferInfoQuery.bindValue(":bufferid", bufferId.toInt());
 
-        lockForRead();
-        safeExec(bufferInfoQuery);
-        error = !watchQuery(bufferInfoQuery) || !bufferInfoQuery.first();
-        if (!error) {
-            bufferInfo = BufferInfo(bufferInfoQuery.value(0).toInt(), bufferInfoQuery.value(1).toInt(), (BufferInfo::Type)bufferInfoQuery.value(2).toInt(), 0, bufferInfoQuery.value(4).toString());
-            error = !bufferInfo.isValid();
-        }
+    safeExec(bufferInfoQuery);
+    if (watchQuery(bufferInfoQuery) && bufferInfoQuery.first()) {
+        bufferInfo = BufferInfo(bufferInfoQuery.value(0).toInt(), bufferInfoQuery.value(1).toInt(), (BufferInfo::Type)bufferInfoQuery.value(2).toInt(), 0, bufferInfoQuery.value(4).toString());
     }
-    if (error) {
+    bufferInfoQuery.finish();
+    return bufferInfo;
+}
+
+
+// reads the result of one of the per-buffer message queries
+void SqliteStorage::readMessages(QSqlQuery &query, const BufferInfo &bufferInfo, QList<Message> &messagelist)
+{
+    while (query.next()) {
+        Message msg(QDateTime::fromTime_t(query.value(1).toInt()),
+            bufferInfo,
+            (Message::Type)query.value(2).toUInt(),
+            query.value(6).toString(),
+            query.value(4).toString(),
+            query.value(5).toString(),
+            (Message::Flags)query.value(3).toUInt());
+        msg.setMsgId(query.value(0).toInt());
+        messagelist << msg;
+    }
+}
+
+
+QList<Message> SqliteStorage::requestMsgsByTime(UserId user, BufferId bufferId, const QDateTime &start, const QDateTime &end, Message::Types types, int limit)
+{
+    QList<Message> messagelist;
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    lockForRead();
+    BufferInfo bufferInfo = selectBufferInfo(db, user, bufferId);
+    if (!bufferInfo.isValid()) {
         db.rollback();
         unlock();
         return messagelist;
     }
 
+    QSqlQuery query = cachedQuery("select_messagesByTime", db);
+    query.bindValue(":bufferid", bufferId.toInt());
+    query.bindValue(":starttime", start.isValid() ? (qint64)start.toTime_t() : 0);
+    query.bindValue(":endtime", end.isValid() ? (qint64)end.toTime_t() : std::numeric_limits<qint64>::max());
+    query.bindValue(":types", (int)types);
+    query.bindValue(":limit", limit);
+
+    safeExec(query);
+    watchQuery(query);
+    readMessages(query, bufferInfo, messagelist);
+
+    db.commit();
+    unlock();
+
+    return messagelist;
+}
+
+
+QList<Message> SqliteStorage::requestAllMsgs(UserId user, MsgId first, MsgId last, int limit)
+{
+    QList<Message> messagelist;
+
+    QSqlDatabase db = logDb();
+    db.transaction();
+
+    QHash<BufferId, BufferInfo> bufferInfoHash;
     {
-        QSqlQuery query(db);
-        if (last == -1 && first == -1) {
-            query.prepare(queryString("select_messagesNewestK"));
+        QSqlQuery bufferInfoQuery(db);
+        bufferInfoQuery.prepare(queryString("select_buffers"));
+        bufferInfoQuery.bindValue(":userid", user.toInt());
+
+        lockForRead();
+        safeExec(bufferInfoQuery);
+        watchQuery(bufferInfoQuery);
+        while (bufferInfoQuery.next()) {
+            BufferInfo bufferInfo = BufferInfo(bufferInfoQuery.value(0).toInt(), bufferInfoQuery.value(1).toInt(), (BufferInfo::Type)bufferInfoQuery.value(2).toInt(), bufferInfoQuery.value(3).toInt(), bufferInfoQuery.value(4).toString());
+            bufferInfoHash[bufferInfo.bufferId()] = bufferInfo;
         }
-        else if (last == -1) {
-            query.prepare(queryString("select_messagesNewerThan"));
-            query.bindValue(":firstmsg", first.toInt());
+
+        QSqlQuery query(db);
+        if (last == -1) {
+            query.prepare(queryString("select_messagesAllNew"));
         }
         else {
-            query.prepare(queryString("select_messagesRange"));
+            query.prepare(queryString("select_messagesAll"));
             query.bindValue(":lastmsg", last.toInt());
-            query.bindValue(":firstmsg", first.toInt());
         }
-        query.bindValue(":bufferid", bufferId.toInt());
+        query.bindValue(":userid", user.toInt());
+        query.bindValue(":firstmsg", first.toInt());
         query.bindValue(":limit", limit);
-
         safeExec(query);
+
         watchQuery(query);
 
         while (query.next()) {
-            Message msg(QDateTime::fromTime_t(query.value(1).toInt()),
-                bufferInfo,
-                (Message::Type)query.value(2).toUInt(),
-                query.value(6).toString(),
-                query.value(4).toString(),
+            Message msg(QDateTime::fromTime_t(query.value(2).toInt()),
+                bufferInfoHash[query.value(1).toInt()],
+                (Message::Type)query.value(3).toUInt(),
+                query.value(7).toString(),
                 query.value(5).toString(),
-                (Message::Flags)query.value(3).toUInt());
+                query.value(6).toString(),
+                (Message::Flags)query.value(4).toUInt());
             msg.setMsgId(query.value(0).toInt());
             messagelist << msg;
         }
     }
     db.commit();
     unlock();
-
     return messagelist;
 }
 
 
-QList<Message> SqliteStorage::requestAllMsgs(UserId user, MsgId first, MsgId last, int limit)
+bool SqliteStorage::isSearchAvailable()
+{
+    // initOptionalSchema() keeps the index in place whenever FTS5 is available
+    return _fts5Available;
+}
+
+
+QList<Message> SqliteStorage::searchMsgs(UserId user, const QString &text, BufferId bufferId, NetworkId networkId, const QString &sender, const QDateTime &from, const QDateTime &to, MsgId last, int limit)
 {
     QList<Message> messagelist;
+    if (!_fts5Available)
+        return messagelist;
+
+    // quote every word, so the user's input is never taken for FTS5 query syntax
+    QStringList terms;
+    foreach(QString term, text.split(QRegExp("\\s+"), QString::SkipEmptyParts)) {
+        terms << QString("\"%1\"").arg(term.replace('"', "\"\""));
+    }
+    if (terms.isEmpty())
+        return messagelist;
 
     QSqlDatabase db = logDb();
     db.transaction();
@@ -1789,15 +2123,15 @@ QList<Message> SqliteStorage::requestAllMsgs(UserId user, MsgId first, MsgId las
         }
 
         QSqlQuery query(db);
-        if (last == -1) {
-            query.prepare(queryString("select_messagesAllNew"));
-        }
-        else {
-            query.prepare(queryString("select_messagesAll"));
-            query.bindValue(":lastmsg", last.toInt());
-        }
+        query.prepare(queryString("select_messagesSearch"));
         query.bindValue(":userid", user.toInt());
-        query.bindValue(":firstmsg", first.toInt());
+        query.bindValue(":query", terms.join(" "));
+        query.bindValue(":bufferid", bufferId.isValid() ? bufferId.toInt() : -1);
+        query.bindValue(":networkid", networkId.isValid() ? networkId.toInt() : -1);
+        query.bindValue(":sender", sender.toLower());
+        query.bindValue(":fromtime", from.isValid() ? (qint64)from.toTime_t() : 0);
+        query.bindValue(":totime", to.isValid() ? (qint64)to.toTime_t() : std::numeric_limits<qint64>::max());
+        query.bindValue(":lastmsg", last == -1 ? std::numeric_limits<int>::max() : last.toInt());
         query.bindValue(":limit", limit);
         safeExec(query);
 
@@ -1878,10 +2212,14 @@ bool SqliteStorage::safeExec(QSqlQuery &query, int retryCount)
 
     switch (query.lastError().number()) {
     case 5: // SQLITE_BUSY         5   /* The database file is locked */
-        [[clang::fallthrough]];
+        // SQLite already waited for the busy timeout, so the database is really stuck
+        quWarning() << "SqliteStorage::safeExec(): database is still locked after" << _busyTimeout << "ms, giving up";
+        break;
     case 6: // SQLITE_LOCKED       6   /* A table in the database is locked */
+        // the busy timeout doesn't apply to conflicts within the same process, so retry those ourselves
         if (retryCount < _maxRetryCount)
             return safeExec(query, retryCount + 1);
+        quWarning() << "SqliteStorage::safeExec(): table is still locked after" << _maxRetryCount << "retries, giving up";
         break;
     default:
         ;
@@ -2072,8 +2410,9 @@ bool SqliteMigrationReader::readMo(BufferMO &buffer)
     buffer.lastseenmsgid = value(8).toInt();
     buffer.markerlinemsgid = value(9).toInt();
     buffer.bufferactivity = value(10).toInt();
-    buffer.key = value(11).toString();
-    buffer.joined = value(12).toInt() == 1 ? true : false;
+    buffer.highlightcount = value(11).toInt();
+    buffer.key = value(12).toString();
+    buffer.joined = value(13).toInt() == 1 ? true : false;
     return true;
 }
 
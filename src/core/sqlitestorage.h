@@ -23,6 +23,7 @@
 #include "abstractsqlstorage.h"
 
 #include <QSqlDatabase>
+#include <QThreadStorage>
 
 class QSqlQuery;
 
@@ -99,21 +100,30 @@ public slots:
     void setBufferActivity(UserId id, BufferId bufferId, Message::Types type) override;
     QHash<BufferId, Message::Types> bufferActivities(UserId id) override;
     Message::Types bufferActivity(BufferId bufferId, MsgId lastSeenMsgId) override;
+    void setHighlightCount(UserId id, BufferId bufferId, int count) override;
+    QHash<BufferId, int> highlightCounts(UserId id) override;
+    int highlightCount(BufferId bufferId, MsgId lastSeenMsgId) override;
 
     /* Message handling */
     bool logMessage(Message &msg) override;
     bool logMessages(MessageList &msgs) override;
     QList<Message> requestMsgs(UserId user, BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1) override;
+    QList<Message> requestMsgsMulti(UserId user, const QList<BufferId> &bufferIds, const QList<MsgId> &first, const QList<MsgId> &last, int limit = -1) override;
+    QList<Message> requestMsgsByTime(UserId user, BufferId bufferId, const QDateTime &start, const QDateTime &end, Message::Types types = 0, int limit = -1) override;
     QList<Message> requestAllMsgs(UserId user, MsgId first = -1, MsgId last = -1, int limit = -1) override;
+    bool isSearchAvailable() override;
+    QList<Message> searchMsgs(UserId user, const QString &text, BufferId bufferId, NetworkId networkId, const QString &sender, const QDateTime &from, const QDateTime &to, MsgId last = -1, int limit = -1) override;
 
     /* Sysident handling */
     QMap<UserId, QString> getAllAuthUserNames() override;
     QString getAuthUserName(UserId user) override;
 
 protected:
-    void setConnectionProperties(const QVariantMap & /* properties */)  override {}
+    void setConnectionProperties(const QVariantMap &properties)  override;
     QString driverName()  override { return "QSQLITE"; }
     QString databaseName()  override { return backlogFile(); }
+    bool initDbSession(QSqlDatabase &db) override;
+    bool initOptionalSchema() override;
     int installedSchemaVersion() override;
     bool updateSchemaVersion(int newVersion) override;
     bool setupSchemaVersion(int version) override;
@@ -123,12 +133,30 @@ private:
     static QString backlogFile();
     void bindNetworkInfo(QSqlQuery &query, const NetworkInfo &info);
     void bindServerInfo(QSqlQuery &query, const Network::Server &server);
-
-    inline void lockForRead() { _dbLock.lockForRead(); }
-    inline void lockForWrite() { _dbLock.lockForWrite(); }
-    inline void unlock() { _dbLock.unlock(); }
+    int resolveSenderId(QSqlDatabase &db, const QString &sender, QHash<QString, int> &newSenders);
+    bool fetchMsgs(QSqlDatabase &db, UserId user, BufferId bufferId, MsgId first, MsgId last, int limit, QList<Message> &messagelist);
+    BufferInfo selectBufferInfo(QSqlDatabase &db, UserId user, BufferId bufferId);
+    void readMessages(QSqlQuery &query, const BufferInfo &bufferInfo, QList<Message> &messagelist);
+
+    // In WAL mode, readers work on a snapshot of their own connection and don't need the lock;
+    // only writers are serialized, so they don't run into each other's transactions.
+    inline void lockForRead() { if (!_walMode) _dbLock.lockForRead(); }
+    inline void lockForWrite() { _dbLock.lockForWrite(); _writeLocked.setLocalData(true); }
+    inline void unlock() {
+        if (!_walMode || _writeLocked.localData()) {
+            _writeLocked.setLocalData(false);
+            _dbLock.unlock();
+        }
+    }
     QReadWriteLock _dbLock;
+    QThreadStorage<bool> _writeLocked;
     static int _maxRetryCount;
+
+    bool _useWal;     ///< WAL mode requested through the connection properties
+    bool _walMode;    ///< WAL mode actually active on the database, fixed once the first connection is set up
+    bool _journalModeChecked; ///< Whether _walMode has been decided yet
+    bool _fts5Available; ///< Whether SQLite was built with FTS5, needed for backlog search
+    int _busyTimeout; ///< Time in ms SQLite waits for a locked database before giving up
 };
 
 
@@ -100,6 +100,12 @@ public slots:
      */
     virtual void sync() = 0;
 
+    //! Returns runtime statistics of the storage backend
+    /** Used for diagnostics only, e.g. hit rates of internal caches.
+     *  \return A map of named counters, empty if the backend doesn't collect any
+     */
+    virtual QVariantMap statistics() { return QVariantMap(); }
+
     // TODO: Add functions for configuring the backlog handling, i.e. defining auto-cleanup settings etc
 
     /* User handling */
@@ -395,7 +401,9 @@ public slots:
     virtual void setBufferActivity(UserId id, BufferId bufferId, Message::Types type) = 0;
 
     //! Get a Hash of all buffer activity states
-    /** This Method is called when the Quassel Core is started to restore the BufferActivities
+    /** This Method is called when the Quassel Core is started to restore the BufferActivities.
+     *  The activity (and the highlight count) of a buffer is updated whenever a message is stored and
+     *  reset by setBufferLastSeenMsg(), so this doesn't need to look at the backlog.
      *  \note This method is threadsafe.
      *
      * \param user      The Owner of the buffers
@@ -404,6 +412,7 @@ public slots:
 
     //! Get the bitset of buffer activity states for a buffer
     /** This method is used to load the activity state of a buffer when its last seen message changes.
+     *  The backlog is only scanned if lastSeenMsgId isn't the newest message of the buffer.
      *  \note This method is threadsafe.
      *
      * \param bufferId The buffer
@@ -411,6 +420,35 @@ public slots:
      */
     virtual Message::Types bufferActivity(BufferId bufferId, MsgId lastSeenMsgId) = 0;
 
+    //! Update the highlight count for a Buffer
+    /** This Method is used to make the number of unread highlights of a Buffer persistent
+     *  \note This method is threadsafe.
+     *
+     * \param user      The Owner of that Buffer
+     * \param bufferId  The buffer id
+     * \param count     The number of unread highlights
+     */
+    virtual void setHighlightCount(UserId id, BufferId bufferId, int count) = 0;
+
+    //! Get a Hash of all highlight counts
+    /** This Method is called when the Quassel Core is started to restore the highlight counts.
+     *  Like the activities, they are kept current by the storage, so the backlog isn't scanned.
+     *  \note This method is threadsafe.
+     *
+     * \param user      The Owner of the buffers
+     */
+    virtual QHash<BufferId, int> highlightCounts(UserId id) = 0;
+
+    //! Get the number of unread highlights for a buffer
+    /** This method is used to load the highlight count of a buffer when its last seen message changes.
+     *  The backlog is only scanned if lastSeenMsgId isn't the newest message of the buffer.
+     *  \note This method is threadsafe.
+     *
+     * \param bufferId The buffer
+     * \param lastSeenMsgId     The last seen message
+     */
+    virtual int highlightCount(BufferId bufferId, MsgId lastSeenMsgId) = 0;
+
     /* Message handling */
 
     //! Store a Message in the storage backend and set its unique Id.
@@ -434,6 +472,34 @@ public slots:
      */
     virtual QList<Message> requestMsgs(UserId user, BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1) = 0;
 
+    //! Request messages stored in several buffers at once.
+    /** Works like calling requestMsgs() for each of the buffers, but lets the backend answer all
+     *  of them in a single query.
+     *  \param bufferIds The buffers we request messages from
+     *  \param first     The first MsgId for each buffer, as in requestMsgs()
+     *  \param last      The last MsgId for each buffer, as in requestMsgs()
+     *  \param limit     if != -1 limit the returned list to a max of \limit entries per buffer
+     *  \return The requested messages, grouped by buffer and newest first within each buffer
+     */
+    virtual QList<Message> requestMsgsMulti(UserId user, const QList<BufferId> &bufferIds, const QList<MsgId> &first, const QList<MsgId> &last, int limit = -1) = 0;
+
+    //! Whether requestMsgsMulti() is supported
+    /** The multi-buffer query may depend on the version of the database server.
+     *  \return true if the backend can answer requestMsgsMulti()
+     */
+    virtual bool isMultiBacklogAvailable() { return true; }
+
+    //! Request the messages of a buffer sent in a given time range
+    /** Uses the (bufferid, time) index, so jumping to a point in time doesn't need the MsgIds around it.
+     *  \param bufferId The buffer we request messages from
+     *  \param start    if valid return only messages sent at or after start
+     *  \param end      if valid return only messages sent before end
+     *  \param types    if != 0 return only messages of these types
+     *  \param limit    if != -1 limit the returned list to a max of \limit entries
+     *  \return The requested messages, oldest first; if limited, the ones closest to start
+     */
+    virtual QList<Message> requestMsgsByTime(UserId user, BufferId bufferId, const QDateTime &start, const QDateTime &end, Message::Types types = 0, int limit = -1) = 0;
+
     //! Request a certain number of messages across all buffers
     /** \param first    if != -1 return only messages with a MsgId >= first
      *  \param last     if != -1 return only messages with a MsgId < last
@@ -442,6 +508,26 @@ public slots:
      */
     virtual QList<Message> requestAllMsgs(UserId user, MsgId first = -1, MsgId last = -1, int limit = -1) = 0;
 
+    //! Whether searchMsgs() is supported
+    /** The full-text index may depend on optional features of the database.
+     *  \return true if the backend can search the backlog
+     */
+    virtual bool isSearchAvailable() { return true; }
+
+    //! Search all messages of a user
+    /** Uses the full-text index of the backend, so the backlog isn't scanned.
+     *  \param text      The text to search for, all of its words have to appear in a message
+     *  \param bufferId  if valid, only search this buffer
+     *  \param networkId if valid, only search the buffers of this network
+     *  \param sender    if not empty, only return messages sent by this nick
+     *  \param from      if valid, only return messages sent at or after this time
+     *  \param to        if valid, only return messages sent before this time
+     *  \param last      if != -1 return only messages with a MsgId < last, to page through the results
+     *  \param limit     if != -1 limit the returned list to a max of \limit entries
+     *  \return The matching messages, newest first
+     */
+    virtual QList<Message> searchMsgs(UserId user, const QString &text, BufferId bufferId, NetworkId networkId, const QString &sender, const QDateTime &from, const QDateTime &to, MsgId last = -1, int limit = -1) = 0;
+
     //! Fetch all authusernames
     /** \return      Map of all current UserIds to permitted idents
      */
@@ -0,0 +1,222 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "storagewriter.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+#include "storage.h"
+
+StorageWriter::StorageWriter(Storage *storage, int flushInterval, int maxBatchSize, int maxQueueSize, QObject *parent)
+    : QThread(parent),
+    _storage(storage),
+    _flushInterval(qMax(flushInterval, 0)),
+    _maxBatchSize(qMax(maxBatchSize, 1)),
+    _maxQueueSize(qMax(maxQueueSize, maxBatchSize))
+{
+    qRegisterMetaType<MessageList>("MessageList");
+}
+
+
+StorageWriter::~StorageWriter()
+{
+    stop();
+}
+
+
+void StorageWriter::enqueue(const MessageList &messages, QObject *receiver, const char *member)
+{
+    if (messages.isEmpty())
+        return;
+
+    QMutexLocker locker(&_mutex);
+    if (_stopping || !isRunning()) {
+        // nobody is going to process the queue, so we store the messages ourselves
+        locker.unlock();
+        MessageList msgs = messages;
+        _storage->logMessages(msgs);
+        QMetaObject::invokeMethod(receiver, member, Qt::QueuedConnection, Q_ARG(MessageList, msgs));
+        return;
+    }
+
+    // an oversized batch is accepted as soon as the queue is empty, so we can't deadlock here
+    while (!_stopping && _queuedMessages > 0 && _queuedMessages + messages.count() > _maxQueueSize)
+        _queueNotFull.wait(&_mutex);
+
+    Request request;
+    request.messages = messages;
+    request.receiver = receiver;
+    request.member = member;
+    _queue << request;
+
+    _queuedMessages += messages.count();
+    _stats.queueDepth = _queuedMessages;
+    if (_queuedMessages > _stats.maxQueueDepth)
+        _stats.maxQueueDepth = _queuedMessages;
+
+    _queueNotEmpty.wakeOne();
+}
+
+
+void StorageWriter::dropReceiver(QObject *receiver)
+{
+    QMutexLocker locker(&_mutex);
+    for (int i = 0; i < _queue.count(); i++) {
+        if (_queue.at(i).receiver == receiver)
+            _queue[i].receiver = 0;
+    }
+    for (int i = 0; i < _inFlight.count(); i++) {
+        if (_inFlight.at(i).receiver == receiver)
+            _inFlight[i].receiver = 0;
+    }
+}
+
+
+void StorageWriter::stop()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _stopping = true;
+        _queueNotEmpty.wakeAll();
+        _queueNotFull.wakeAll();
+    }
+    wait();
+}
+
+
+StorageWriter::Stats StorageWriter::stats() const
+{
+    QMutexLocker locker(&_mutex);
+    return _stats;
+}
+
+
+QVariantMap StorageWriter::statsMap() const
+{
+    Stats s = stats();
+    QVariantMap map;
+    map["QueueDepth"] = s.queueDepth;
+    map["MaxQueueDepth"] = s.maxQueueDepth;
+    map["StoredMessages"] = s.storedMessages;
+    map["FailedMessages"] = s.failedMessages;
+    map["Commits"] = s.commits;
+    map["LastCommitLatency"] = s.lastCommitLatency;
+    map["MaxCommitLatency"] = s.maxCommitLatency;
+    map["AverageCommitLatency"] = s.commits ? s.totalCommitLatency / (qint64)s.commits : 0;
+    return map;
+}
+
+
+void StorageWriter::run()
+{
+    QMutexLocker locker(&_mutex);
+    forever {
+        while (_queue.isEmpty() && !_stopping)
+            _queueNotEmpty.wait(&_mutex);
+
+        if (_queue.isEmpty())
+            break; // stopping and nothing left to write
+
+        // give the other sessions a chance to join this transaction
+        if (_flushInterval > 0) {
+            QElapsedTimer timer;
+            timer.start();
+            qint64 remaining = _flushInterval;
+            while (!_stopping && _queuedMessages < _maxBatchSize && remaining > 0) {
+                _queueNotEmpty.wait(&_mutex, remaining);
+                remaining = _flushInterval - timer.elapsed();
+            }
+        }
+
+        // requests are never split, but we take at least one of them
+        int batchSize = 0;
+        while (!_queue.isEmpty() && (batchSize == 0 || batchSize + _queue.first().messages.count() <= _maxBatchSize)) {
+            batchSize += _queue.first().messages.count();
+            _inFlight << _queue.takeFirst();
+        }
+        _queuedMessages -= batchSize;
+        _stats.queueDepth = _queuedMessages;
+        _queueNotFull.wakeAll();
+
+        writeBatch(_inFlight);
+        dispatchResults();
+    }
+}
+
+
+// called with _mutex locked
+void StorageWriter::writeBatch(QList<Request> &batch)
+{
+    MessageList messages;
+    QList<int> requestSizes;
+    foreach(const Request &request, batch) {
+        messages += request.messages;
+        requestSizes << request.messages.count();
+    }
+
+    _mutex.unlock();
+    QElapsedTimer timer;
+    timer.start();
+    bool success = _storage->logMessages(messages);
+    if (!success && requestSizes.count() > 1) {
+        // don't let a single broken request take down the whole batch
+        int offset = 0;
+        foreach(int size, requestSizes) {
+            MessageList part = messages.mid(offset, size);
+            _storage->logMessages(part);
+            for (int i = 0; i < size; i++)
+                messages[offset + i] = part.at(i);
+            offset += size;
+        }
+    }
+    qint64 latency = timer.elapsed();
+    _mutex.lock();
+
+    int offset = 0;
+    for (int i = 0; i < batch.count(); i++) {
+        MessageList &stored = batch[i].messages;
+        for (int j = 0; j < stored.count(); j++) {
+            stored[j] = messages.at(offset + j);
+            if (stored.at(j).msgId().isValid())
+                _stats.storedMessages++;
+            else
+                _stats.failedMessages++;
+        }
+        offset += stored.count();
+    }
+
+    _stats.commits++;
+    _stats.lastCommitLatency = latency;
+    _stats.totalCommitLatency += latency;
+    if (latency > _stats.maxCommitLatency)
+        _stats.maxCommitLatency = latency;
+}
+
+
+// called with _mutex locked, so dropReceiver() can't race with the invocation
+void StorageWriter::dispatchResults()
+{
+    foreach(const Request &request, _inFlight) {
+        if (request.receiver)
+            QMetaObject::invokeMethod(request.receiver, request.member.constData(), Qt::QueuedConnection, Q_ARG(MessageList, request.messages));
+    }
+    _inFlight.clear();
+}
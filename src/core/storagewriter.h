@@ -0,0 +1,114 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QVariantMap>
+#include <QWaitCondition>
+
+#include "message.h"
+
+class Storage;
+
+/**
+ * Dedicated writer thread for incoming messages.
+ *
+ * Sessions hand their message batches to the writer instead of calling Storage::logMessages()
+ * on their own thread. The writer collects the batches of all sessions and stores them in one
+ * transaction every flushInterval milliseconds, or as soon as maxBatchSize messages are pending.
+ * The stored messages (now carrying valid MsgIds) are handed back to the submitting object
+ * through a queued invocation of the given slot, which receives a MessageList.
+ *
+ * The queue is bounded by maxQueueSize messages; enqueue() blocks while it is full, so a slow
+ * database throttles the sessions instead of growing the queue without limit.
+ */
+class StorageWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        int queueDepth{0};            ///< Messages currently waiting to be written
+        int maxQueueDepth{0};         ///< Highest queue depth seen so far
+        quint64 storedMessages{0};    ///< Messages written successfully
+        quint64 failedMessages{0};    ///< Messages that could not be written
+        quint64 commits{0};           ///< Number of transactions committed
+        qint64 lastCommitLatency{0};  ///< Duration of the last commit in ms
+        qint64 maxCommitLatency{0};   ///< Longest commit in ms
+        qint64 totalCommitLatency{0}; ///< Sum of all commit durations in ms
+    };
+
+    StorageWriter(Storage *storage, int flushInterval, int maxBatchSize, int maxQueueSize, QObject *parent = 0);
+    ~StorageWriter() override;
+
+    //! Queue messages for storage
+    /** \note This method is threadsafe.
+     *
+     *  \param messages  The messages to be stored
+     *  \param receiver  The object to hand the stored messages back to
+     *  \param member    Name of the receiver's slot taking a MessageList
+     */
+    void enqueue(const MessageList &messages, QObject *receiver, const char *member);
+
+    //! Forget all pending results for the given receiver
+    /** The messages are still stored, but the receiver won't be invoked anymore. Must be called
+     *  before the receiver is destroyed.
+     *  \note This method is threadsafe.
+     */
+    void dropReceiver(QObject *receiver);
+
+    //! Flush all pending messages and stop the writer thread
+    void stop();
+
+    Stats stats() const;
+    QVariantMap statsMap() const;
+
+protected:
+    void run() override;
+
+private:
+    struct Request {
+        MessageList messages;
+        QObject *receiver;
+        QByteArray member;
+    };
+
+    void writeBatch(QList<Request> &batch);
+    void dispatchResults();
+
+    Storage *_storage;
+    int _flushInterval;
+    int _maxBatchSize;
+    int _maxQueueSize;
+
+    mutable QMutex _mutex;
+    QWaitCondition _queueNotEmpty;
+    QWaitCondition _queueNotFull;
+    QList<Request> _queue;
+    QList<Request> _inFlight;
+    int _queuedMessages{0};
+    bool _stopping{false};
+
+    Stats _stats;
+};
@@ -128,44 +128,10 @@ void QtUiMessageProcessor::checkForHighlight(Message &msg)
             if (!nickList.contains(net->myNick()))
                 nickList.prepend(net->myNick());
         }
-        foreach(QString nickname, nickList) {
-            QRegExp nickRegExp("(^|\\W)" + QRegExp::escape(nickname) + "(\\W|$)", _nicksCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            if (nickRegExp.indexIn(stripFormatCodes(msg.contents())) >= 0) {
-                msg.setFlags(msg.flags() | Message::Highlight);
-                return;
-            }
-        }
-
-        for (int i = 0; i < _highlightRules.count(); i++) {
-            const HighlightRule &rule = _highlightRules.at(i);
-            if (!rule.isEnabled)
-                continue;
-
-            if (rule.chanName.size() > 0 && rule.chanName.compare(".*") != 0) {
-                if (rule.chanName.startsWith("!")) {
-                    QRegExp rx(rule.chanName.mid(1), Qt::CaseInsensitive);
-                    if (rx.exactMatch(msg.bufferInfo().bufferName()))
-                        continue;
-                }
-                else {
-                    QRegExp rx(rule.chanName, Qt::CaseInsensitive);
-                    if (!rx.exactMatch(msg.bufferInfo().bufferName()))
-                        continue;
-                }
-            }
-
-            QRegExp rx;
-            if (rule.isRegExp) {
-                rx = QRegExp(rule.name, rule.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            }
-            else {
-                rx = QRegExp("(^|\\W)" + QRegExp::escape(rule.name) + "(\\W|$)", rule.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            }
-            bool match = (rx.indexIn(stripFormatCodes(msg.contents())) >= 0);
-            if (match) {
-                msg.setFlags(msg.flags() | Message::Highlight);
-                return;
-            }
+        QString contents = stripFormatCodes(msg.contents());
+        if (_highlightMatcher.matchNicks(contents, nickList, _nicksCaseSensitive)
+            || _highlightMatcher.matchRules(contents, msg.sender(), msg.bufferInfo().bufferName())) {
+            msg.setFlags(msg.flags() | Message::Highlight);
         }
     }
 }
@@ -181,17 +147,20 @@ void QtUiMessageProcessor::highlightListChanged(const QVariant &variant)
 {
     QVariantList varList = variant.toList();
 
-    _highlightRules.clear();
+    HighlightMatcher::RuleList rules;
     QVariantList::const_iterator iter = varList.constBegin();
     while (iter != varList.constEnd()) {
         QVariantMap rule = iter->toMap();
-        _highlightRules << HighlightRule(rule["Name"].toString(),
-            rule["Enable"].toBool(),
-            rule["CS"].toBool() ? Qt::CaseSensitive : Qt::CaseInsensitive,
+        rules << HighlightMatcher::Rule(rule["Name"].toString(),
             rule["RegEx"].toBool(),
+            rule["CS"].toBool(),
+            rule["Enable"].toBool(),
+            false,
+            QString(),
             rule["Channel"].toString());
         ++iter;
     }
+    _highlightMatcher.setRules(rules);
 }
 
 
@@ -24,6 +24,7 @@
 #include <QTimer>
 
 #include "abstractmessageprocessor.h"
+#include "highlightmatcher.h"
 
 class QtUiMessageProcessor : public AbstractMessageProcessor
 {
@@ -62,17 +63,7 @@ private:
     bool _processing;
     Mode _processMode;
 
-    struct HighlightRule {
-        QString name;
-        bool isEnabled;
-        Qt::CaseSensitivity caseSensitive;
-        bool isRegExp;
-        QString chanName;
-        inline HighlightRule(const QString &name, bool enabled, Qt::CaseSensitivity cs, bool regExp, const QString &chanName)
-            : name(name), isEnabled(enabled), caseSensitive(cs), isRegExp(regExp), chanName(chanName) {}
-    };
-
-    QList<HighlightRule> _highlightRules;
+    HighlightMatcher _highlightMatcher;
     NotificationSettings::HighlightNickType _highlightNick;
     bool _nicksCaseSensitive;
 };
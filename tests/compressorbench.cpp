@@ -0,0 +1,236 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+// Compares the compression methods: sends a message stream through a pair of Compressors connected over the
+// loopback interface, once per method, and reports the bytes on the wire and the CPU time spent per message.
+// The stream is either a capture of an uncompressed connection or built from a file of IRC lines.
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtEndian>
+
+#include <cstdio>
+
+#include "compressor.h"
+
+namespace {
+
+void printUsage()
+{
+    printf("Usage: compressorbench [--repeat N] [--capture FILE | --lines FILE]\n"
+           "  --repeat N      Send the stream N times per method (default 20)\n"
+           "  --capture FILE  Use the messages of an uncompressed connection, captured after the handshake\n"
+           "  --lines FILE    Send each line of FILE as a displayed message (default: the bundled sample)\n");
+}
+
+
+// A capture is a sequence of messages, each preceded by its size as a big-endian quint32
+bool readCapture(const QString &fileName, QList<QByteArray> *messages)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Could not open %s\n", qPrintable(fileName));
+        return false;
+    }
+
+    QByteArray data = file.readAll();
+    int pos = 0;
+    while (pos + 4 <= data.size()) {
+        quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(data.constData() + pos));
+        if (size > static_cast<quint32>(data.size() - pos - 4))
+            break;
+        messages->append(data.mid(pos + 4, size));
+        pos += 4 + size;
+    }
+    if (pos != data.size()) {
+        fprintf(stderr, "%s is not a valid capture (stray data at offset %d)\n", qPrintable(fileName), pos);
+        return false;
+    }
+    return true;
+}
+
+
+// Wraps each line into a DataStream protocol RpcCall, roughly like the core does for displayed messages
+bool readLines(const QString &fileName, QList<QByteArray> *messages)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Could not open %s\n", qPrintable(fileName));
+        return false;
+    }
+
+    QDateTime timestamp = QDateTime::fromTime_t(1530000000);
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+
+        QByteArray sender;
+        if (line.startsWith(':'))
+            sender = line.mid(1, line.indexOf(' ') - 1);
+
+        QVariantList rpcCall;
+        rpcCall << QVariant(qint16(2)) << QVariant(QByteArray("2displayMsg(Message)")) << QVariant(timestamp)
+                << QVariant(QString::fromUtf8(sender)) << QVariant(QString::fromUtf8(line));
+        timestamp = timestamp.addSecs(7);
+
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_4_2);
+        stream << rpcCall;
+        messages->append(data);
+    }
+    return true;
+}
+
+
+// Reads everything the receiver has decompressed and checks it against what was sent
+bool drain(Compressor *receiver, QByteArray *expected)
+{
+    QByteArray data;
+    data.resize(receiver->bytesAvailable());
+    receiver->read(data.data(), data.size());
+    if (!expected->startsWith(data))
+        return false;
+
+    expected->remove(0, data.size());
+    return true;
+}
+
+
+bool run(Compressor::CompressionMethod method, const QList<QByteArray> &messages, int repeat)
+{
+    QTcpServer server;
+    QTcpSocket client;
+    if (!server.listen(QHostAddress::LocalHost)) {
+        fprintf(stderr, "Could not listen on the loopback interface: %s\n", qPrintable(server.errorString()));
+        return false;
+    }
+    client.connectToHost(server.serverAddress(), server.serverPort());
+    if (!client.waitForConnected(5000) || !server.waitForNewConnection(5000)) {
+        fprintf(stderr, "Could not connect to ourselves\n");
+        return false;
+    }
+    QTcpSocket *peer = server.nextPendingConnection();
+
+    // both ends of a connection use the best compression, see CoreAuthHandler and ClientAuthHandler
+    Compressor sender(&client, Compressor::BestCompression, method);
+    Compressor receiver(peer, Compressor::BestCompression, method);
+
+    // send in batches, so neither the socket buffers nor the expected data grow without bounds
+    const int batchSize = 64;
+    quint64 count = 0;
+    for (int i = 0; i < repeat; i++) {
+        for (int first = 0; first < messages.count(); first += batchSize) {
+            QByteArray expected;
+            for (int j = first; j < qMin(first + batchSize, messages.count()); j++) {
+                // the same writes RemotePeer::writeMessage() does
+                const QByteArray &msg = messages.at(j);
+                quint32 size = qToBigEndian<quint32>(msg.size());
+                sender.write(reinterpret_cast<const char *>(&size), 4, Compressor::NoFlush);
+                sender.write(msg.constData(), msg.size());
+                expected.append(reinterpret_cast<const char *>(&size), 4).append(msg);
+                count++;
+            }
+
+            while (!expected.isEmpty()) {
+                client.flush();
+                if (peer->bytesAvailable())
+                    QMetaObject::invokeMethod(&receiver, "readData");
+                else if (!receiver.bytesAvailable() && !peer->waitForReadyRead(5000)) {
+                    fprintf(stderr, "%s: timed out waiting for data\n", qPrintable(Compressor::methodName(method)));
+                    return false;
+                }
+                if (!drain(&receiver, &expected)) {
+                    fprintf(stderr, "%s: received data differs from what was sent\n", qPrintable(Compressor::methodName(method)));
+                    return false;
+                }
+            }
+        }
+    }
+
+    const Compressor::Stats &out = sender.stats();
+    const Compressor::Stats &in = receiver.stats();
+    printf("%-8s %10llu %12llu %12llu %7.3f %12.0f %12.0f %10.1f\n",
+           qPrintable(Compressor::methodName(method)),
+           static_cast<unsigned long long>(count),
+           static_cast<unsigned long long>(out.bytesWritten),
+           static_cast<unsigned long long>(out.bytesSent),
+           out.bytesWritten ? double(out.bytesSent) / out.bytesWritten : 0.0,
+           count ? double(out.compressNsecs) / count : 0.0,
+           count ? double(in.decompressNsecs) / count : 0.0,
+           out.compressNsecs ? out.bytesWritten * 1000.0 / out.compressNsecs : 0.0);
+    return true;
+}
+
+}
+
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    int repeat = 20;
+    QString captureFile;
+    QString linesFile = TEST_DATA_DIR "/irc-traffic.txt";
+
+    QStringList args = app.arguments().mid(1);
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "--repeat" && !args.isEmpty())
+            repeat = args.takeFirst().toInt();
+        else if (arg == "--capture" && !args.isEmpty())
+            captureFile = args.takeFirst();
+        else if (arg == "--lines" && !args.isEmpty())
+            linesFile = args.takeFirst();
+        else {
+            printUsage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    QList<QByteArray> messages;
+    if (!(captureFile.isEmpty() ? readLines(linesFile, &messages) : readCapture(captureFile, &messages)))
+        return 1;
+    if (messages.isEmpty() || repeat < 1) {
+        fprintf(stderr, "Nothing to send\n");
+        return 1;
+    }
+
+    printf("%-8s %10s %12s %12s %7s %12s %12s %10s\n",
+           "method", "messages", "bytes", "wire bytes", "ratio", "comp ns/msg", "decomp ns/msg", "comp MB/s");
+
+    bool ok = true;
+    QList<Compressor::CompressionMethod> methods;
+    methods << Compressor::Deflate << Compressor::Lz4 << Compressor::Zstd;
+    foreach(Compressor::CompressionMethod method, methods) {
+        if (!Compressor::isMethodSupported(method)) {
+            printf("%-8s not supported by this build\n", qPrintable(Compressor::methodName(method)));
+            continue;
+        }
+        ok &= run(method, messages, repeat);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+// Checks HighlightMatcher against the per-rule matching HighlightRuleManager::match() did before it, and measures
+// how many messages per second both handle with a large rule list.
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRegExp>
+#include <QStringList>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "highlightmatcher.h"
+#include "util.h"
+
+namespace {
+
+struct TestMessage
+{
+    QString contents;
+    QString sender;
+    QString bufferName;
+};
+
+
+// The matching HighlightRuleManager::match() did before HighlightMatcher, for plain messages
+bool oldMatch(const HighlightMatcher::RuleList &rules, const QStringList &nicks, bool nicksCaseSensitive, const TestMessage &msg)
+{
+    bool matches = false;
+
+    for (int i = 0; i < rules.count(); i++) {
+        const HighlightMatcher::Rule &rule = rules.at(i);
+        if (!rule.isEnabled)
+            continue;
+
+        if (rule.chanName.size() > 0 && rule.chanName.compare(".*") != 0) {
+            if (rule.chanName.startsWith("!")) {
+                QRegExp rx(rule.chanName.mid(1), Qt::CaseInsensitive);
+                if (rx.exactMatch(msg.bufferName))
+                    continue;
+            }
+            else {
+                QRegExp rx(rule.chanName, Qt::CaseInsensitive);
+                if (!rx.exactMatch(msg.bufferName))
+                    continue;
+            }
+        }
+
+        QRegExp rx;
+        if (rule.isRegEx) {
+            rx = QRegExp(rule.name, rule.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        } else {
+            rx = QRegExp("(^|\\W)" + QRegExp::escape(rule.name) + "(\\W|$)", rule.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        }
+        bool nameMatch = (rx.indexIn(stripFormatCodes(msg.contents)) >= 0);
+
+        bool senderMatch;
+        if (rule.sender.isEmpty()) {
+            senderMatch = true;
+        } else {
+            if (rule.isRegEx) {
+                rx = QRegExp(rule.sender, rule.isCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+            } else {
+                rx = QRegExp(rule.sender, Qt::CaseInsensitive, QRegExp::Wildcard);
+            }
+            senderMatch = rx.exactMatch(msg.sender);
+        }
+
+        if (nameMatch && senderMatch) {
+            // If an inverse rule matches, then we know that we never want to return a highlight.
+            if (rule.isInverse) {
+                return false;
+            } else {
+                matches = true;
+            }
+        }
+    }
+
+    if (matches)
+        return true;
+
+    foreach(const QString &nickname, nicks) {
+        QRegExp nickRegExp("(^|\\W)" + QRegExp::escape(nickname) + "(\\W|$)", nicksCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        if (nickRegExp.indexIn(stripFormatCodes(msg.contents)) >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// What HighlightRuleManager::match() does now, once the matcher is compiled
+bool newMatch(const HighlightMatcher &matcher, const QStringList &nicks, bool nicksCaseSensitive, const TestMessage &msg)
+{
+    QString contents = stripFormatCodes(msg.contents);
+    if (matcher.matchRules(contents, msg.sender, msg.bufferName))
+        return true;
+    return matcher.matchNicks(contents, nicks, nicksCaseSensitive);
+}
+
+
+QString randomWord(int minLength, int maxLength)
+{
+    QString word;
+    int length = minLength + rand() % (maxLength - minLength + 1);
+    for (int i = 0; i < length; i++)
+        word += QChar('a' + rand() % 26);
+    return word;
+}
+
+
+// Mostly plain keywords, as people tend to have them, and some rules of every other kind
+HighlightMatcher::RuleList makeRules(int count, const QStringList &vocabulary)
+{
+    HighlightMatcher::RuleList rules;
+    for (int i = 0; i < count; i++) {
+        QString word = (i % 10 == 0 && !vocabulary.isEmpty()) ? vocabulary.at(rand() % vocabulary.count()) : randomWord(4, 10);
+        bool caseSensitive = i % 7 == 0;
+        switch (i % 20) {
+        case 3:
+            rules << HighlightMatcher::Rule(QRegExp::escape(word.left(3)) + "\\w*" + randomWord(2, 3), true, caseSensitive, true, false, QString(), QString());
+            break;
+        case 6:
+            rules << HighlightMatcher::Rule(word, false, caseSensitive, true, false, QString(), "#python");
+            break;
+        case 9:
+            rules << HighlightMatcher::Rule(word, false, caseSensitive, true, false, QString(), "!#linux");
+            break;
+        case 12:
+            rules << HighlightMatcher::Rule(word, false, caseSensitive, true, false, "*!*@kde/*", QString());
+            break;
+        case 15:
+            rules << HighlightMatcher::Rule(randomWord(4, 10), false, caseSensitive, true, true, QString(), QString());
+            break;
+        case 18:
+            rules << HighlightMatcher::Rule(word, false, caseSensitive, false, false, QString(), QString());
+            break;
+        default:
+            rules << HighlightMatcher::Rule(word, false, caseSensitive, true, false, QString(), QString());
+        }
+    }
+    return rules;
+}
+
+
+void printUsage()
+{
+    printf("Usage: highlightbench [--rules N] [--repeat N] [--lines FILE]\n"
+           "  --rules N     Number of highlight rules (default 100)\n"
+           "  --repeat N    Match the messages N times per method (default 20)\n"
+           "  --lines FILE  Raw server lines, one per line; the PRIVMSGs are used (default: the bundled sample)\n");
+}
+
+}
+
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    int ruleCount = 100;
+    int repeat = 20;
+    QString linesFile = TEST_DATA_DIR "/irc-traffic.txt";
+
+    QStringList args = app.arguments().mid(1);
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "--rules" && !args.isEmpty())
+            ruleCount = args.takeFirst().toInt();
+        else if (arg == "--repeat" && !args.isEmpty())
+            repeat = args.takeFirst().toInt();
+        else if (arg == "--lines" && !args.isEmpty())
+            linesFile = args.takeFirst();
+        else {
+            printUsage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    QFile file(linesFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Could not open %s\n", qPrintable(linesFile));
+        return 1;
+    }
+
+    QList<TestMessage> messages;
+    QStringList vocabulary;
+    QRegExp privmsg("^:(\\S+) PRIVMSG (\\S+) :(.*)$");
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (!privmsg.exactMatch(line))
+            continue;
+
+        TestMessage msg;
+        msg.sender = privmsg.cap(1);
+        msg.bufferName = privmsg.cap(2);
+        msg.contents = privmsg.cap(3);
+        messages << msg;
+        if (vocabulary.count() < 1000)
+            vocabulary << msg.contents.split(' ', QString::SkipEmptyParts);
+    }
+    if (messages.isEmpty()) {
+        fprintf(stderr, "No PRIVMSG lines in %s\n", qPrintable(linesFile));
+        return 1;
+    }
+
+    srand(42);
+    HighlightMatcher::RuleList rules = makeRules(ruleCount, vocabulary);
+    QStringList nicks = QStringList() << "quasseluser" << "quasseluser_";
+
+    // mention the user or one of the rule words in some of the messages, so there is something to find
+    for (int i = 0; i < messages.count(); i += 5) {
+        if (i % 3 == 0)
+            messages[i].contents += " " + nicks.at(rand() % nicks.count()).toUpper();
+        else if (!rules.isEmpty())
+            messages[i].contents.prepend(rules.at(rand() % rules.count()).name + ": ");
+    }
+
+    HighlightMatcher matcher;
+    matcher.setRules(rules);
+
+    int mismatches = 0;
+    int highlights = 0;
+    foreach(const TestMessage &msg, messages) {
+        bool oldResult = oldMatch(rules, nicks, false, msg);
+        if (oldResult != newMatch(matcher, nicks, false, msg)) {
+            if (mismatches < 5)
+                fprintf(stderr, "Result differs for \"%s\" in %s\n", qPrintable(msg.contents), qPrintable(msg.bufferName));
+            mismatches++;
+        }
+        if (oldResult)
+            highlights++;
+    }
+    printf("%d messages checked against %d rules, %d highlights, %d mismatches\n", messages.count(), rules.count(), highlights, mismatches);
+    if (mismatches)
+        return 1;
+    if (repeat <= 0)
+        return 0;
+
+    QElapsedTimer timer;
+    qint64 count = qint64(messages.count()) * repeat;
+    int checksum = 0;
+
+    timer.start();
+    for (int i = 0; i < repeat; i++) {
+        foreach(const TestMessage &msg, messages)
+            checksum += oldMatch(rules, nicks, false, msg);
+    }
+    qint64 oldNsecs = timer.nsecsElapsed();
+
+    // compiling is part of the cost, the rule manager does it whenever the rules change
+    timer.restart();
+    HighlightMatcher benchMatcher;
+    benchMatcher.setRules(rules);
+    for (int i = 0; i < repeat; i++) {
+        foreach(const TestMessage &msg, messages)
+            checksum -= newMatch(benchMatcher, nicks, false, msg);
+    }
+    qint64 newNsecs = timer.nsecsElapsed();
+
+    printf("matching %lld messages against %d rules:\n", count, rules.count());
+    printf("  before: %10.0f messages/s (%.0f ns/message)\n", count * 1e9 / qMax(oldNsecs, qint64(1)), double(oldNsecs) / count);
+    printf("  now:    %10.0f messages/s (%.0f ns/message)\n", count * 1e9 / qMax(newNsecs, qint64(1)), double(newNsecs) / count);
+    if (checksum != 0)
+        printf("  (results differ, checksum %d)\n", checksum);
+    return 0;
+}
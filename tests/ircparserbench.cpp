@@ -0,0 +1,321 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+// Checks IrcTokenizer and the command table against what IrcParser::processNetworkIncoming() did before them, on
+// random lines and on a corpus of server traffic, and then measures how many lines per second both ways handle.
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMetaEnum>
+#include <QStringList>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "eventmanager.h"
+#include "ircparser.h"
+#include "irctokenizer.h"
+
+namespace {
+
+struct SplitLine
+{
+    bool valid{false};
+    bool hasPrefix{false};
+    QByteArray prefix;
+    QByteArray command;
+    QList<QByteArray> params;
+
+    bool operator==(const SplitLine &other) const
+    {
+        if (valid != other.valid)
+            return false;
+        return !valid || (hasPrefix == other.hasPrefix && prefix == other.prefix && command == other.command && params == other.params);
+    }
+};
+
+
+// The splitting processNetworkIncoming() did before IrcTokenizer, minus the decoding
+SplitLine oldSplit(QByteArray msg)
+{
+    SplitLine result;
+
+    QByteArray trailing;
+    int idx = msg.indexOf(" :");
+    if (idx >= 0) {
+        if (msg.length() > idx + 2)
+            trailing = msg.mid(idx + 2);
+        msg = msg.left(idx);
+    }
+    QList<QByteArray> params = msg.split(' ');
+
+    QList<QByteArray>::iterator iter = params.begin();
+    while (iter != params.end()) {
+        if (iter->isEmpty())
+            iter = params.erase(iter);
+        else
+            ++iter;
+    }
+
+    if (!trailing.isEmpty())
+        params << trailing;
+    if (params.count() < 1)
+        return result;
+
+    QByteArray foo = params.takeFirst();
+    if (foo.startsWith(':')) {
+        result.hasPrefix = true;
+        result.prefix = foo.mid(1);
+        if (params.count() < 1)
+            return result;
+        foo = params.takeFirst();
+    }
+
+    result.valid = true;
+    result.command = foo.trimmed();
+    result.params = params;
+    return result;
+}
+
+
+SplitLine newSplit(const QByteArray &msg, IrcTokenizer *tokens)
+{
+    SplitLine result;
+    if (!tokens->tokenize(msg))
+        return result;
+
+    result.valid = true;
+    result.hasPrefix = tokens->hasPrefix();
+    if (result.hasPrefix)
+        result.prefix = tokens->toByteArray(tokens->prefix());
+    result.command = tokens->toByteArray(tokens->command());
+    for (int i = 0; i < tokens->paramCount(); i++)
+        result.params << tokens->toByteArray(tokens->param(i));
+    return result;
+}
+
+
+// The event type lookup processNetworkIncoming() did before the command table
+EventManager::EventType oldEventType(const QString &cmd)
+{
+    if (cmd.toUInt() > 0)
+        return EventManager::IrcEventNumeric;
+    if (cmd.isEmpty())
+        return EventManager::IrcEventUnknown;
+
+    QString typeName = QLatin1String("IrcEvent") + cmd.at(0).toUpper() + cmd.mid(1).toLower();
+    EventManager::EventType type = EventManager::eventTypeByName(typeName);
+    if (type == EventManager::Invalid)
+        type = EventManager::eventTypeByName("IrcEventUnknown");
+    return type;
+}
+
+
+// eventTypeByCommand() is only meant for the parser itself
+class ParserAccess : public IrcParser
+{
+public:
+    using IrcParser::eventTypeByCommand;
+};
+
+
+EventManager::EventType newEventType(const IrcTokenizer &tokens)
+{
+    if (tokens.numeric() > 0)
+        return EventManager::IrcEventNumeric;
+
+    IrcTokenizer::Range command = tokens.command();
+    return ParserAccess::eventTypeByCommand(tokens.data(command), command.length);
+}
+
+
+void printUsage()
+{
+    printf("Usage: ircparserbench [--repeat N] [--random N] [--lines FILE]\n"
+           "  --repeat N    Parse the corpus N times per method (default 200)\n"
+           "  --random N    Compare the splitting on N random lines first (default 2000000)\n"
+           "  --lines FILE  Raw server lines, one per line (default: the bundled sample)\n");
+}
+
+
+bool checkRandomLines(int count)
+{
+    // few distinct bytes, so spaces, colons and empty tokens come up in every possible arrangement
+    const char alphabet[] = "  ::ab1\t";
+    IrcTokenizer tokens;
+    int mismatches = 0;
+    srand(42);
+    for (int n = 0; n < count; n++) {
+        QByteArray line;
+        int length = rand() % 24;
+        for (int i = 0; i < length; i++)
+            line += alphabet[rand() % (sizeof(alphabet) - 1)];
+
+        if (!(oldSplit(line) == newSplit(line, &tokens))) {
+            if (mismatches < 5)
+                fprintf(stderr, "Split differs for \"%s\"\n", line.constData());
+            mismatches++;
+        }
+    }
+
+    // every event type name in random case, and some names that aren't
+    QMetaEnum eventEnum = EventManager::staticMetaObject.enumerator(EventManager::staticMetaObject.indexOfEnumerator("EventType"));
+    QList<QByteArray> commands;
+    for (int i = 0; i < eventEnum.keyCount(); i++) {
+        QByteArray key(eventEnum.key(i));
+        if (key.startsWith("IrcEvent"))
+            commands << key.mid(8) << key.mid(8, 3) << key.mid(8) + "x";
+    }
+    commands << "001" << "353" << "0" << "999999999" << "PRIVMSG\t";
+    foreach(QByteArray command, commands) {
+        for (int i = 0; i < command.length(); i++) {
+            if (rand() % 2)
+                command[i] = QChar::fromLatin1(command.at(i)).toUpper().toLatin1();
+            else
+                command[i] = QChar::fromLatin1(command.at(i)).toLower().toLatin1();
+        }
+        QByteArray line = ":nick!user@host " + command + " #chan :text";
+        tokens.tokenize(line);
+        IrcTokenizer::Range range = tokens.command();
+        if (oldEventType(QString::fromLatin1(tokens.data(range), range.length)) != newEventType(tokens)) {
+            if (mismatches < 5)
+                fprintf(stderr, "Event type differs for \"%s\"\n", command.constData());
+            mismatches++;
+        }
+    }
+
+    printf("%d random lines and %d commands checked, %d mismatches\n", count, commands.count(), mismatches);
+    return mismatches == 0;
+}
+
+
+bool checkCorpus(const QList<QByteArray> &lines)
+{
+    IrcTokenizer tokens;
+    int mismatches = 0;
+    foreach(const QByteArray &line, lines) {
+        SplitLine split = oldSplit(line);
+        if (!(split == newSplit(line, &tokens))
+            || (split.valid && oldEventType(QString::fromLatin1(split.command)) != newEventType(tokens))) {
+            if (mismatches < 5)
+                fprintf(stderr, "Corpus line differs: \"%s\"\n", line.constData());
+            mismatches++;
+        }
+    }
+    printf("%d corpus lines checked, %d mismatches\n", lines.count(), mismatches);
+    return mismatches == 0;
+}
+
+
+// Splits, decodes the prefix and looks up the event type like processNetworkIncoming() does now and did before
+void benchmark(const QList<QByteArray> &lines, int repeat)
+{
+    QElapsedTimer timer;
+    qint64 checksum = 0;
+    qint64 count = qint64(lines.count()) * repeat;
+
+    timer.start();
+    for (int i = 0; i < repeat; i++) {
+        foreach(const QByteArray &line, lines) {
+            SplitLine split = oldSplit(line);
+            if (!split.valid)
+                continue;
+            QString prefix = QString::fromUtf8(split.prefix);
+            checksum += prefix.length() + split.params.count() + oldEventType(QString::fromUtf8(split.command));
+        }
+    }
+    qint64 oldNsecs = timer.nsecsElapsed();
+
+    IrcTokenizer tokens;
+    timer.restart();
+    for (int i = 0; i < repeat; i++) {
+        foreach(const QByteArray &line, lines) {
+            if (!tokens.tokenize(line))
+                continue;
+            QString prefix;
+            if (tokens.hasPrefix())
+                prefix = QString::fromUtf8(tokens.data(tokens.prefix()), tokens.prefix().length);
+            QList<QByteArray> params;
+            params.reserve(tokens.paramCount());
+            for (int p = 0; p < tokens.paramCount(); p++)
+                params << tokens.toByteArray(tokens.param(p));
+            checksum -= prefix.length() + params.count() + newEventType(tokens);
+        }
+    }
+    qint64 newNsecs = timer.nsecsElapsed();
+
+    printf("split and split+lookup of %lld lines:\n", count);
+    printf("  before: %10.0f lines/s (%.0f ns/line)\n", count * 1e9 / qMax(oldNsecs, qint64(1)), double(oldNsecs) / count);
+    printf("  now:    %10.0f lines/s (%.0f ns/line)\n", count * 1e9 / qMax(newNsecs, qint64(1)), double(newNsecs) / count);
+    if (checksum != 0)
+        printf("  (results differ, checksum %lld)\n", checksum);
+}
+
+}
+
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    int repeat = 200;
+    int randomLines = 2000000;
+    QString linesFile = TEST_DATA_DIR "/irc-traffic.txt";
+
+    QStringList args = app.arguments().mid(1);
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "--repeat" && !args.isEmpty())
+            repeat = args.takeFirst().toInt();
+        else if (arg == "--random" && !args.isEmpty())
+            randomLines = args.takeFirst().toInt();
+        else if (arg == "--lines" && !args.isEmpty())
+            linesFile = args.takeFirst();
+        else {
+            printUsage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    QFile file(linesFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Could not open %s\n", qPrintable(linesFile));
+        return 1;
+    }
+    QList<QByteArray> lines;
+    while (!file.atEnd()) {
+        // CoreNetwork strips the line ending before handing the line to the parser
+        QByteArray line = file.readLine();
+        while (line.endsWith('\n') || line.endsWith('\r'))
+            line.chop(1);
+        if (!line.isEmpty())
+            lines << line;
+    }
+
+    bool ok = checkRandomLines(randomLines);
+    ok &= checkCorpus(lines);
+    if (!ok)
+        return 1;
+
+    if (repeat > 0)
+        benchmark(lines, repeat);
+    return 0;
+}
@@ -0,0 +1,308 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2018 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+// Checks that CoreNetwork::splitMessage() cuts a long paste into parts that fit into a line and add up to the
+// paste again, for a plain and a FiSH encrypted target, and measures it against the splitter it replaced.
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QRegExp>
+#include <QStringList>
+#include <QTextBoundaryFinder>
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+#include "corenetwork.h"
+
+#ifdef HAVE_QCA2
+#  include "cipher.h"
+#endif
+
+namespace {
+
+typedef std::function<QList<QByteArray>(QString &)> CmdGenerator;
+typedef std::function<int(const QList<QByteArray> &)> OverrunFunc;
+
+// What CoreUserInputHandler::lastParamOverrun() computes once we know our own prefix
+OverrunFunc makeOverrunFunc(const QByteArray &nick, const QByteArray &user, const QByteArray &host, const QByteArray &cmd)
+{
+    int lineLen = 512 - nick.count() - user.count() - host.count() - cmd.count() - 6;
+    return [lineLen](const QList<QByteArray> &params) -> int {
+        if (params.isEmpty())
+            return 0;
+        int maxLen = lineLen;
+        for (int i = 0; i < params.count() - 1; i++)
+            maxLen -= params[i].count() + 1;
+        maxLen -= 2;
+        return params.last().count() > maxLen ? params.last().count() - maxLen : 0;
+    };
+}
+
+
+// The splitting CoreNetwork::splitMessage() did before, walking back from the end of the remainder for every part
+QList<QList<QByteArray>> oldSplit(const QString &message, CmdGenerator cmdGenerator, OverrunFunc overrunFunc)
+{
+    QString wrkMsg(message);
+    QList<QList<QByteArray>> msgsToSend;
+
+    do {
+        int splitPos = wrkMsg.size();
+        QList<QByteArray> initialSplitMsgEnc = cmdGenerator(wrkMsg);
+        int initialOverrun = overrunFunc(initialSplitMsgEnc);
+
+        if (initialOverrun) {
+            QString splitMsg(wrkMsg);
+            QTextBoundaryFinder qtbf(QTextBoundaryFinder::Word, splitMsg);
+            qtbf.setPosition(initialSplitMsgEnc[1].size() - initialOverrun);
+            QList<QByteArray> splitMsgEnc;
+            int overrun = initialOverrun;
+
+            while (overrun) {
+                splitPos = qtbf.toPreviousBoundary();
+                if (splitPos > 0) {
+                    splitMsg = splitMsg.left(splitPos);
+                    splitMsgEnc = cmdGenerator(splitMsg);
+                    overrun = overrunFunc(splitMsgEnc);
+                }
+                else {
+                    if (qtbf.type() == QTextBoundaryFinder::Word) {
+                        splitMsg = wrkMsg;
+                        splitPos = splitMsg.size();
+                        QTextBoundaryFinder graphemeQtbf(QTextBoundaryFinder::Grapheme, splitMsg);
+                        graphemeQtbf.setPosition(initialSplitMsgEnc[1].size() - initialOverrun);
+                        qtbf = graphemeQtbf;
+                    }
+                    else {
+                        return msgsToSend;
+                    }
+                }
+            }
+
+            wrkMsg.remove(0, splitPos);
+            msgsToSend.append(splitMsgEnc);
+        }
+        else {
+            wrkMsg.remove(0, splitPos);
+            msgsToSend.append(initialSplitMsgEnc);
+        }
+    } while (wrkMsg.size() > 0);
+
+    return msgsToSend;
+}
+
+
+// A paste of at least size bytes made of the chat lines, with some non-ASCII text and a token too long for one line
+QString makePaste(const QStringList &lines, int size)
+{
+    QString paste;
+    int bytes = 0;
+    for (int i = 0; bytes < size; i++) {
+        QString piece;
+        if (i % 50 == 25) {
+            static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            for (int j = 0; j < 700; j++)
+                piece += QLatin1Char(alphabet[j % 64]);
+        }
+        else if (i % 7 == 3) {
+            piece = QString::fromUtf8("Größenordnung über naïve Ansätze, 日本語のテキスト, ёжик");
+        }
+        else {
+            piece = lines.at(i % lines.count());
+        }
+        if (!paste.isEmpty())
+            piece.prepend(' ');
+        paste += piece;
+        bytes += piece.toUtf8().size();
+    }
+    return paste;
+}
+
+
+struct Target
+{
+    QString name;
+    CmdGenerator cmdGenerator;
+};
+
+
+// Returns the number of problems with the parts: ones that don't fit, and whether they add up to the paste again
+int checkParts(const char *splitter, const QList<QList<QByteArray>> &parts, const QString &paste, OverrunFunc overrunFunc,
+               const QHash<QByteArray, QString> &plainText)
+{
+    int problems = 0;
+    QString joined;
+    for (int i = 0; i < parts.count(); i++) {
+        if (overrunFunc(parts.at(i))) {
+            fprintf(stderr, "  %s: part %d is %d bytes too long\n", splitter, i, overrunFunc(parts.at(i)));
+            problems++;
+        }
+        joined += plainText.value(parts.at(i).last());
+    }
+    if (joined != paste) {
+        fprintf(stderr, "  %s: the parts don't add up to the paste\n", splitter);
+        problems++;
+    }
+    return problems;
+}
+
+
+void printUsage()
+{
+    printf("Usage: splitbench [--size N] [--repeat N] [--lines FILE]\n"
+           "  --size N      Size of the paste in bytes (default 10240)\n"
+           "  --repeat N    Split the paste N times per method and target (default 20)\n"
+           "  --lines FILE  Raw server lines, one per line; the PRIVMSG texts make up the paste (default: the bundled sample)\n");
+}
+
+}
+
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    int size = 10240;
+    int repeat = 20;
+    QString linesFile = TEST_DATA_DIR "/irc-traffic.txt";
+
+    QStringList args = app.arguments().mid(1);
+    while (!args.isEmpty()) {
+        QString arg = args.takeFirst();
+        if (arg == "--size" && !args.isEmpty())
+            size = args.takeFirst().toInt();
+        else if (arg == "--repeat" && !args.isEmpty())
+            repeat = args.takeFirst().toInt();
+        else if (arg == "--lines" && !args.isEmpty())
+            linesFile = args.takeFirst();
+        else {
+            printUsage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    QFile file(linesFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "Could not open %s\n", qPrintable(linesFile));
+        return 1;
+    }
+
+    QStringList lines;
+    QRegExp privmsg("^:\\S+ PRIVMSG \\S+ :(.*)$");
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (privmsg.exactMatch(line) && !privmsg.cap(1).isEmpty())
+            lines << privmsg.cap(1);
+    }
+    if (lines.isEmpty()) {
+        fprintf(stderr, "No PRIVMSG lines in %s\n", qPrintable(linesFile));
+        return 1;
+    }
+
+    QString paste = makePaste(lines, size);
+    QByteArray targetEnc("#quassel");
+    OverrunFunc overrunFunc = makeOverrunFunc("quasseluser", "~quassel", "user/quasseluser", "PRIVMSG");
+
+    // remembers what each last parameter was made from, so the parts can be put together again even if encrypted
+    QHash<QByteArray, QString> plainText;
+    bool recordPlainText = true;
+
+    QList<Target> targets;
+    Target plain;
+    plain.name = "plain";
+    plain.cmdGenerator = [&](QString &splitMsg) -> QList<QByteArray> {
+        QByteArray splitMsgEnc = splitMsg.toUtf8();
+        if (recordPlainText)
+            plainText.insert(splitMsgEnc, splitMsg);
+        return QList<QByteArray>() << targetEnc << splitMsgEnc;
+    };
+    targets << plain;
+
+#ifdef HAVE_QCA2
+    Cipher cipher;
+    if (Cipher::neededFeaturesAvailable() && cipher.setKey("splitbench-key")) {
+        Target encrypted;
+        encrypted.name = "encrypted";
+        encrypted.cmdGenerator = [&](QString &splitMsg) -> QList<QByteArray> {
+            QByteArray splitMsgEnc = splitMsg.toUtf8();
+            if (!splitMsg.isEmpty())
+                cipher.encrypt(splitMsgEnc);
+            if (recordPlainText)
+                plainText.insert(splitMsgEnc, splitMsg);
+            return QList<QByteArray>() << targetEnc << splitMsgEnc;
+        };
+        targets << encrypted;
+    }
+    else {
+        printf("Blowfish is not available through QCA, only checking the plain target\n");
+    }
+#else
+    printf("Built without QCA, only checking the plain target\n");
+#endif
+
+    printf("splitting a paste of %d characters (%d bytes)\n", paste.size(), paste.toUtf8().size());
+
+    int problems = 0;
+    foreach(const Target &target, targets) {
+        plainText.clear();
+        QList<QList<QByteArray>> oldParts = oldSplit(paste, target.cmdGenerator, overrunFunc);
+        QList<QList<QByteArray>> newParts = CoreNetwork::splitMessage(paste, target.cmdGenerator, overrunFunc);
+        printf("  %-9s target: %d parts before, %d parts now\n", qPrintable(target.name), oldParts.count(), newParts.count());
+
+        problems += checkParts("before", oldParts, paste, overrunFunc, plainText);
+        problems += checkParts("now", newParts, paste, overrunFunc, plainText);
+        // the new split points are never earlier than the old ones, so there can't be more parts
+        if (newParts.count() > oldParts.count()) {
+            fprintf(stderr, "  now: more parts than before\n");
+            problems++;
+        }
+    }
+    printf("%d problems\n", problems);
+    if (problems)
+        return 1;
+    if (repeat <= 0)
+        return 0;
+
+    recordPlainText = false;
+    foreach(const Target &target, targets) {
+        QElapsedTimer timer;
+        int checksum = 0;
+
+        timer.start();
+        for (int i = 0; i < repeat; i++)
+            checksum += oldSplit(paste, target.cmdGenerator, overrunFunc).count();
+        qint64 oldNsecs = timer.nsecsElapsed();
+
+        timer.restart();
+        for (int i = 0; i < repeat; i++)
+            checksum -= CoreNetwork::splitMessage(paste, target.cmdGenerator, overrunFunc).count();
+        qint64 newNsecs = timer.nsecsElapsed();
+
+        printf("splitting the paste %d times for a %s target:\n", repeat, qPrintable(target.name));
+        printf("  before: %10.1f pastes/s (%.0f ns/paste)\n", repeat * 1e9 / qMax(oldNsecs, qint64(1)), double(oldNsecs) / repeat);
+        printf("  now:    %10.1f pastes/s (%.0f ns/paste)\n", repeat * 1e9 / qMax(newNsecs, qint64(1)), double(newNsecs) / repeat);
+        if (checksum > 0)
+            printf("  (fewer parts now, %d over all runs)\n", checksum);
+    }
+    return 0;
+}